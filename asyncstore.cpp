@@ -0,0 +1,304 @@
+// asyncstore.cpp
+#include "asyncstore.h"
+#include "database.h"
+#include "metrics.h"
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QTimer>
+#include <QDebug>
+
+AsyncVendingStore::AsyncVendingStore(const QString &databasePath, QObject *parent)
+    : QObject(parent), context(new QObject) {
+    connectionName = QString("storage_%1").arg(quintptr(this));
+    thread.setObjectName("storage");
+    context->moveToThread(&thread);
+    thread.start();
+
+    // Connections belong to the thread that opened them, so open it there
+    QMetaObject::invokeMethod(context, [this, databasePath]() {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databasePath);
+        if (!db.open() || !Database::prepare(db)) {
+            setError("Failed to open storage connection: " + db.lastError().text());
+        }
+        store = new SqliteVendingStore(db);
+    }, Qt::BlockingQueuedConnection);
+}
+
+AsyncVendingStore::~AsyncVendingStore() {
+    flush().waitForFinished();
+
+    QMetaObject::invokeMethod(context, [this]() {
+        delete store;
+        store = nullptr;
+        QSqlDatabase::database(connectionName, false).close();
+        QSqlDatabase::removeDatabase(connectionName);
+    }, Qt::BlockingQueuedConnection);
+
+    thread.quit();
+    thread.wait();
+    delete context;
+}
+
+QFuture<bool> AsyncVendingStore::submit(const Operation &operation) {
+    return submitOperation(operation, false);
+}
+
+QFuture<bool> AsyncVendingStore::submitOperation(const Operation &operation, bool mayHold) {
+    PendingOperation entry;
+    entry.operation = operation;
+    entry.promise.reportStarted();
+    // Only writes that may be held are fire-and-forget
+    entry.awaited = !mayHold;
+    QFuture<bool> future = entry.promise.future();
+
+    bool schedule;
+    {
+        QMutexLocker locker(&mutex);
+        pending.append(entry);
+        schedule = !drainScheduled && !(mayHold && holds > 0);
+        drainScheduled = drainScheduled || schedule;
+    }
+
+    // One drain per burst: later submissions join the queue it will take
+    if (schedule) {
+        scheduleDrain();
+    }
+    return future;
+}
+
+void AsyncVendingStore::scheduleDrain() {
+    // With a group-commit window the drain waits so the burst can grow
+    QMetaObject::invokeMethod(context, [this]() {
+        int window = windowMsecs;
+        if (window > 0) {
+            QTimer::singleShot(window, context, [this]() { drain(); });
+        } else {
+            drain();
+        }
+    }, Qt::QueuedConnection);
+}
+
+void AsyncVendingStore::enqueue(const Operation &operation) {
+    submitOperation(operation, true);
+}
+
+void AsyncVendingStore::holdWrites() {
+    QMutexLocker locker(&mutex);
+    holds++;
+}
+
+void AsyncVendingStore::releaseWrites() {
+    bool schedule;
+    {
+        QMutexLocker locker(&mutex);
+        holds = qMax(0, holds - 1);
+        schedule = holds == 0 && !drainScheduled && !pending.isEmpty();
+        drainScheduled = drainScheduled || schedule;
+    }
+    if (schedule) {
+        scheduleDrain();
+    }
+}
+
+QFuture<bool> AsyncVendingStore::flush() {
+    return submit([](SqliteVendingStore &) { return true; });
+}
+
+void AsyncVendingStore::drain() {
+    // Nothing retries a fire-and-forget write, so each one the store fails to
+    // apply leaves the tables behind memory until the next checkpoint
+    static Counter *const lostWrites =
+        Metrics::counter("vending_lost_writes", "Unawaited writes the store failed to apply.");
+    QVector<PendingOperation> batch;
+    {
+        QMutexLocker locker(&mutex);
+        batch.swap(pending);
+        drainScheduled = false;
+    }
+    if (batch.isEmpty()) {
+        return;
+    }
+
+    int latency = injectedLatency;
+    if (latency > 0) {
+        QThread::msleep(latency);
+    }
+
+    // Each operation is its own savepoint inside the batch transaction
+    QVector<bool> results(batch.size(), false);
+    bool committed = store->beginBatch();
+    if (committed) {
+        for (int i = 0; i < batch.size(); ++i) {
+            results[i] = batch[i].operation(*store);
+            if (results[i]) {
+                continue;
+            }
+            if (!batch[i].awaited) {
+                setError(store->lastError());
+                store->markNeedsCheckpoint();
+                lostWrites->increment();
+            } else if (!store->conflicted()) {
+                // The engine that awaits a lost race retries it; report the rest
+                setError(store->lastError());
+            }
+        }
+        committed = store->flush();
+    } else {
+        for (const PendingOperation &entry : batch) {
+            if (!entry.awaited) {
+                store->markNeedsCheckpoint();
+                lostWrites->increment();
+            }
+        }
+    }
+    if (!committed) {
+        setError(store->lastError());
+    }
+    checkpointNeeded = store->needsCheckpoint();
+
+    for (int i = 0; i < batch.size(); ++i) {
+        batch[i].promise.reportResult(committed && results[i]);
+        batch[i].promise.reportFinished();
+    }
+    emit batchCommitted(batch.size());
+}
+
+void AsyncVendingStore::setError(const QString &message) {
+    {
+        QMutexLocker locker(&mutex);
+        errorText = message;
+    }
+    qWarning() << "Storage error:" << message;
+    emit storageError(message);
+}
+
+QString AsyncVendingStore::lastError() const {
+    QMutexLocker locker(&mutex);
+    return errorText;
+}
+
+void AsyncVendingStore::setGroupCommitWindow(int msecs) {
+    windowMsecs = qMax(0, msecs);
+}
+
+void AsyncVendingStore::setMultiTerminal(bool enabled) {
+    // Queued behind earlier writes, which keep the mode they were made in
+    multiTerminal = enabled;
+    enqueue([enabled](SqliteVendingStore &store) {
+        store.setMultiTerminal(enabled);
+        return true;
+    });
+}
+
+bool AsyncVendingStore::load(VendingSnapshot &snapshot) {
+    // Commit everything queued first, including writes still held or
+    // waiting out a group-commit window, so the read sees them
+    bool ok = false;
+    QString error;
+    QMetaObject::invokeMethod(context, [&]() {
+        drain();
+        ok = store->load(snapshot);
+        error = store->lastError();
+        checkpointNeeded = store->needsCheckpoint();
+    }, Qt::BlockingQueuedConnection);
+
+    if (!ok) {
+        QMutexLocker locker(&mutex);
+        errorText = error;
+    }
+    return ok;
+}
+
+bool AsyncVendingStore::commitPurchase(const SaleRecord &sale) {
+    return commitCart(QVector<SaleRecord>{sale});
+}
+
+bool AsyncVendingStore::commitCart(const QVector<SaleRecord> &sales) {
+    if (!multiTerminal) {
+        enqueue([sales](SqliteVendingStore &store) { return store.commitCart(sales); });
+        return true;
+    }
+
+    QString error;
+    bool conflict = false;
+    QFuture<bool> done = submit([&](SqliteVendingStore &store) {
+        bool ok = store.commitCart(sales);
+        if (!ok) {
+            error = store.lastError();
+            conflict = store.conflicted();
+        }
+        return ok;
+    });
+    done.waitForFinished();
+
+    lastConflict = conflict;
+    if (!done.result()) {
+        QMutexLocker locker(&mutex);
+        errorText = error.isEmpty() ? QString("Sale was not committed") : error;
+        return false;
+    }
+    return true;
+}
+
+bool AsyncVendingStore::addItem(const StockItem &item) {
+    enqueue([item](SqliteVendingStore &store) { return store.addItem(item); });
+    return true;
+}
+
+bool AsyncVendingStore::deleteItem(const QString &itemName) {
+    enqueue([itemName](SqliteVendingStore &store) { return store.deleteItem(itemName); });
+    return true;
+}
+
+bool AsyncVendingStore::restockItem(const QString &itemName, int amount) {
+    enqueue([itemName, amount](SqliteVendingStore &store) { return store.restockItem(itemName, amount); });
+    return true;
+}
+
+bool AsyncVendingStore::restockItems(const QMap<QString, int> &amounts) {
+    enqueue([amounts](SqliteVendingStore &store) { return store.restockItems(amounts); });
+    return true;
+}
+
+bool AsyncVendingStore::deleteItems(const QStringList &itemNames) {
+    enqueue([itemNames](SqliteVendingStore &store) { return store.deleteItems(itemNames); });
+    return true;
+}
+
+bool AsyncVendingStore::restockToPar(int level) {
+    enqueue([level](SqliteVendingStore &store) { return store.restockToPar(level); });
+    return true;
+}
+
+bool AsyncVendingStore::refillChange(const CoinCounts &amounts) {
+    enqueue([amounts](SqliteVendingStore &store) { return store.refillChange(amounts); });
+    return true;
+}
+
+bool AsyncVendingStore::collectMoney() {
+    enqueue([](SqliteVendingStore &store) { return store.collectMoney(); });
+    return true;
+}
+
+bool AsyncVendingStore::saveCheckpoint(const VendingSnapshot &snapshot) {
+    enqueue([snapshot](SqliteVendingStore &store) { return store.saveCheckpoint(snapshot); });
+    return true;
+}
+
+void AsyncVendingStore::markNeedsCheckpoint() {
+    checkpointNeeded = true;
+    enqueue([](SqliteVendingStore &store) {
+        store.markNeedsCheckpoint();
+        return true;
+    });
+}
+
+void AsyncVendingStore::setJournalSequence(quint64 sequence) {
+    // Queued in order, so it lands with the mutation that follows it
+    enqueue([sequence](SqliteVendingStore &store) {
+        store.setJournalSequence(sequence);
+        return true;
+    });
+}
@@ -0,0 +1,119 @@
+// asyncstore.h
+#ifndef ASYNCSTORE_H
+#define ASYNCSTORE_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QVector>
+#include <QFuture>
+#include <QFutureInterface>
+#include <atomic>
+#include <functional>
+#include "sqlitestore.h"
+
+// VendingStore that runs every SQL statement on a dedicated storage thread
+// with its own connection, so the GUI thread never waits on the disk.
+//
+// Mutations are queued and return immediately; the engine's in-memory state
+// (and the journal, when set) already reflect them. The storage thread drains
+// everything queued since its last pass in one transaction, so a burst of
+// sales costs one commit. Failures are reported through storageError(); a
+// queued write that fails also raises needsCheckpoint(), since its caller
+// was already told it had succeeded.
+class AsyncVendingStore : public QObject, public VendingStore {
+    Q_OBJECT
+
+public:
+    typedef std::function<bool(SqliteVendingStore &)> Operation;
+
+    explicit AsyncVendingStore(const QString &databasePath, QObject *parent = nullptr);
+    ~AsyncVendingStore() override;
+
+    // Queue an operation for the storage thread; the future resolves once
+    // the batch holding it has committed
+    QFuture<bool> submit(const Operation &operation);
+
+    // Resolves once everything queued before it has committed
+    QFuture<bool> flush();
+
+    // Writes queued between holdWrites() and releaseWrites() reach the
+    // storage thread as one batch, e.g. all the requests in one read from a
+    // client. submit() and flush() still drain at once, so nothing that
+    // waits on its write can stall behind a hold.
+    void holdWrites();
+    void releaseWrites();
+
+    // Hold each batch open this long so more writes can join it
+    void setGroupCommitWindow(int msecs);
+    int groupCommitWindow() const { return windowMsecs; }
+
+    // Test hook: sleep this long before each batch to simulate a slow disk
+    void setInjectedLatency(int msecs) { injectedLatency = msecs; }
+
+    // Share the database with other terminals. Sales then wait for their
+    // commit, since one refused for lack of stock or coins must not be
+    // handed over; other writes stay queued.
+    void setMultiTerminal(bool enabled);
+    bool isMultiTerminal() const override { return multiTerminal; }
+
+    // Blocks until the storage thread has committed what is queued and read
+    // the tables. Called at startup and, in multi-terminal mode, on entering
+    // user mode and after a lost race; bench_storage times the stall.
+    bool load(VendingSnapshot &snapshot) override;
+
+    bool commitPurchase(const SaleRecord &sale) override;
+    bool commitCart(const QVector<SaleRecord> &sales) override;
+    bool addItem(const StockItem &item) override;
+    bool deleteItem(const QString &itemName) override;
+    bool restockItem(const QString &itemName, int amount) override;
+    bool restockItems(const QMap<QString, int> &amounts) override;
+    bool deleteItems(const QStringList &itemNames) override;
+    bool restockToPar(int level) override;
+    bool refillChange(const CoinCounts &amounts) override;
+    bool collectMoney() override;
+    bool saveCheckpoint(const VendingSnapshot &snapshot) override;
+    void setJournalSequence(quint64 sequence) override;
+    bool recordsSales() const override { return true; }
+    bool conflicted() const override { return lastConflict; }
+    bool needsCheckpoint() const override { return checkpointNeeded; }
+    void markNeedsCheckpoint() override;
+
+    QString lastError() const override;
+
+signals:
+    void storageError(const QString &message);
+    void batchCommitted(int operations);
+
+private:
+    struct PendingOperation {
+        Operation operation;
+        QFutureInterface<bool> promise;
+        bool awaited;
+    };
+
+    QFuture<bool> submitOperation(const Operation &operation, bool mayHold);
+    void scheduleDrain();
+    void enqueue(const Operation &operation);
+    void drain();
+    void setError(const QString &message);
+
+    QThread thread;
+    QObject *context;                  // lives on the storage thread
+    SqliteVendingStore *store = nullptr; // only touched on the storage thread
+    QString connectionName;
+
+    mutable QMutex mutex;
+    QVector<PendingOperation> pending;
+    bool drainScheduled = false;
+    int holds = 0;
+    QString errorText;
+
+    std::atomic<int> windowMsecs{0};
+    std::atomic<int> injectedLatency{0};
+    std::atomic<bool> multiTerminal{false};
+    std::atomic<bool> lastConflict{false};
+    std::atomic<bool> checkpointNeeded{false};
+};
+
+#endif // ASYNCSTORE_H
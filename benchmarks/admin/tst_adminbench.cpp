@@ -0,0 +1,178 @@
+// tst_adminbench.cpp
+// A service visit on a 10k-item machine: restocking 100 items one call at a
+// time against one bulk call, and restocking every item to par. Also checks
+// that bulk restock, delete and restock-to-par reach the tables and replay
+// from the journal.
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QTemporaryDir>
+#include <limits>
+#include "benchfixture.h"
+#include "sqlitestore.h"
+
+class AdminBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void bulkChangesReachTables();
+    void bulkChangesReplayFromJournal();
+    void invalidAmountsAreRefused();
+    void restockOneByOne();
+    void restockInBulk();
+    void restockToPar();
+
+private:
+    static VendingSnapshot seed(int items);
+    QTemporaryDir dir;
+    QSqlDatabase db;
+};
+
+static const int kItems = 10000;
+static const int kRestocked = 100;
+
+VendingSnapshot AdminBenchmark::seed(int items) {
+    VendingSnapshot snapshot = BenchFixture::boxes(50);
+    for (int i = 0; i < items; ++i) {
+        snapshot.items.append({QString("item%1").arg(i), 15, i % 30});
+    }
+    return snapshot;
+}
+
+void AdminBenchmark::initTestCase() {
+    QVERIFY(dir.isValid());
+    db = BenchFixture::openDatabase("admin", dir.filePath("admin.db"));
+    QVERIFY(db.isOpen());
+}
+
+void AdminBenchmark::cleanupTestCase() {
+    BenchFixture::closeDatabase(db);
+}
+
+void AdminBenchmark::bulkChangesReachTables() {
+    SqliteVendingStore store(db);
+    QVERIFY(store.saveCheckpoint(seed(40)));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    QVERIFY(engine.restockItems({{"item1", 5}, {"item2", 7}}));
+    QCOMPARE(engine.catalog().stock(engine.findItem("item1")), 6);
+    QCOMPARE(BenchFixture::queryValue("SELECT stock FROM stock_67011755 WHERE item_name = 'item2'", db), qint64(9));
+
+    // Nothing is touched when any name is unknown
+    QVERIFY(!engine.restockItems({{"item1", 5}, {"missing", 1}}));
+    QVERIFY(!engine.deleteItems({"item3", "missing"}));
+    QCOMPARE(engine.catalog().stock(engine.findItem("item1")), 6);
+    QCOMPARE(engine.catalog().size(), 40);
+
+    QVERIFY(engine.deleteItems({"item3", "item5"}));
+    QCOMPARE(engine.catalog().size(), 38);
+    QCOMPARE(engine.findItem("item5"), -1);
+    QCOMPARE(BenchFixture::queryValue("SELECT COUNT(*) FROM stock_67011755", db), qint64(38));
+
+    // Items at or above par keep their stock
+    QCOMPARE(engine.itemsBelowPar(20), 28);
+    QVERIFY(engine.restockToPar(20));
+    QCOMPARE(engine.itemsBelowPar(20), 0);
+    QCOMPARE(engine.catalog().stock(engine.findItem("item0")), 20);
+    QCOMPARE(engine.catalog().stock(engine.findItem("item25")), 25);
+    QCOMPARE(BenchFixture::queryValue("SELECT MIN(stock) FROM stock_67011755", db), qint64(20));
+    QCOMPARE(BenchFixture::queryValue("SELECT stock FROM stock_67011755 WHERE item_name = 'item25'", db), qint64(25));
+    QCOMPARE(engine.operatingStatus().outOfStockCount(), 0);
+}
+
+void AdminBenchmark::bulkChangesReplayFromJournal() {
+    QString path = dir.filePath("admin.journal");
+    {
+        TransactionJournal journal;
+        QVERIFY(journal.open(path));
+        MemoryVendingStore store(seed(40));
+        VendingEngine engine(&store);
+        engine.setJournal(&journal);
+        QVERIFY(engine.load());
+        QVERIFY(engine.restockItems({{"item1", 5}, {"item2", 7}}));
+        QVERIFY(engine.deleteItems({"item3", "item5"}));
+        QVERIFY(engine.restockToPar(10));
+    }
+
+    TransactionJournal journal;
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.lastSequence(), quint64(3));
+    MemoryVendingStore store(seed(40));
+    VendingEngine engine(&store);
+    engine.setJournal(&journal);
+    QVERIFY(engine.load());
+    QCOMPARE(engine.catalog().size(), 38);
+    QCOMPARE(engine.findItem("item3"), -1);
+    QCOMPARE(engine.catalog().stock(engine.findItem("item0")), 10);
+    QCOMPARE(engine.catalog().stock(engine.findItem("item1")), 10);
+    QCOMPARE(engine.catalog().stock(engine.findItem("item2")), 10);
+    QCOMPARE(engine.catalog().stock(engine.findItem("item29")), 29);
+}
+
+void AdminBenchmark::invalidAmountsAreRefused() {
+    MemoryVendingStore store(seed(40));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+    const int coin = VendingEngine::changeDenominations().first();
+    const int huge = std::numeric_limits<int>::max();
+
+    // Nothing negative, empty or past int gets as far as the journal or store
+    QVERIFY(!engine.restockItem("item1", 0));
+    QVERIFY(!engine.restockItem("item1", -5));
+    QVERIFY(!engine.restockItem("item1", huge));
+    QVERIFY(!engine.restockItems({{"item1", 5}, {"item2", -7}}));
+    QVERIFY(!engine.refillChange({{coin, -1}}));
+    QVERIFY(!engine.refillChange({{coin, huge}}));
+    QCOMPARE(engine.catalog().stock(engine.findItem("item1")), 1);
+    QCOMPARE(engine.catalog().stock(engine.findItem("item2")), 2);
+    QCOMPARE(engine.changeBox().value(coin), 50);
+}
+
+void AdminBenchmark::restockOneByOne() {
+    SqliteVendingStore store(db);
+    QVERIFY(store.saveCheckpoint(seed(kItems)));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    QBENCHMARK {
+        for (int i = 0; i < kRestocked; ++i) {
+            QVERIFY(engine.restockItem(QString("item%1").arg(i * 97), 1));
+        }
+    }
+}
+
+void AdminBenchmark::restockInBulk() {
+    SqliteVendingStore store(db);
+    QVERIFY(store.saveCheckpoint(seed(kItems)));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    QMap<QString, int> amounts;
+    for (int i = 0; i < kRestocked; ++i) {
+        amounts.insert(QString("item%1").arg(i * 97), 1);
+    }
+    QBENCHMARK {
+        QVERIFY(engine.restockItems(amounts));
+    }
+}
+
+void AdminBenchmark::restockToPar() {
+    SqliteVendingStore store(db);
+    VendingEngine engine(&store);
+    int level = 30;
+    QBENCHMARK {
+        // Everything is at par after a pass, so each pass starts over
+        QBENCHMARK_SUSPEND {
+            QVERIFY(store.saveCheckpoint(seed(kItems)));
+            QVERIFY(engine.load());
+        }
+        QVERIFY(engine.restockToPar(level));
+    }
+    QCOMPARE(BenchFixture::queryValue("SELECT MIN(stock) FROM stock_67011755", db), qint64(level));
+}
+
+QTEST_GUILESS_MAIN(AdminBenchmark)
+
+#include "tst_adminbench.moc"
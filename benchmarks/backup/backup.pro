@@ -0,0 +1,13 @@
+QT       += core sql testlib
+QT       -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = bench_backup
+
+include(../../vending_engine.pri)
+include(../common/common.pri)
+
+SOURCES += \
+    tst_backupbench.cpp
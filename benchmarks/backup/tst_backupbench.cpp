@@ -0,0 +1,145 @@
+// tst_backupbench.cpp
+// Online backup of a live machine: backups rotate, verify and restore to
+// the same state, and purchases made while a backup runs stay within a few
+// percent of their latency without one.
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include "asyncstore.h"
+#include "benchfixture.h"
+#include "databasebackup.h"
+
+class BackupBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void rotates();
+    void restoresVerifiedCopy();
+    void rejectsDamagedBackup();
+    void purchaseLatencyDuringBackup();
+
+private:
+    static const int kItems = 20000;
+    static VendingSnapshot seed();
+    static double meanPurchaseMicros(VendingEngine &engine, int purchases);
+
+    QTemporaryDir dir;
+    QString databasePath;
+};
+
+VendingSnapshot BackupBenchmark::seed() {
+    VendingSnapshot snapshot = BenchFixture::boxes(100000);
+    for (int i = 0; i < kItems; ++i) {
+        snapshot.items.append({QString("item%1").arg(i), 15, 1000000});
+    }
+    return snapshot;
+}
+
+double BackupBenchmark::meanPurchaseMicros(VendingEngine &engine, int purchases) {
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < purchases; ++i) {
+        engine.purchase(QString("item%1").arg(i % kItems), {{20, 1}});
+    }
+    return clock.nsecsElapsed() / 1000.0 / purchases;
+}
+
+void BackupBenchmark::initTestCase() {
+    QVERIFY(dir.isValid());
+    databasePath = dir.filePath("machine.db");
+
+    // A database with a catalog and some sales history to copy
+    AsyncVendingStore store(databasePath);
+    QVERIFY(store.saveCheckpoint(seed()));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+    meanPurchaseMicros(engine, 20000);
+    QVERIFY(store.flush().result());
+}
+
+void BackupBenchmark::rotates() {
+    QString backups = dir.filePath("rotating");
+    for (int i = 0; i < 3; ++i) {
+        DatabaseBackup::Result result = DatabaseBackup::run(databasePath, backups, 2);
+        QVERIFY2(result.ok, qPrintable(result.error));
+        QVERIFY(QFileInfo::exists(result.path));
+        QThread::msleep(5); // distinct timestamps
+    }
+    QStringList kept = DatabaseBackup::list(backups);
+    QCOMPARE(kept.size(), 2);
+    QVERIFY(kept.first() > kept.last());
+    QVERIFY(QDir(backups).entryList({"*.part"}, QDir::Files).isEmpty());
+}
+
+void BackupBenchmark::restoresVerifiedCopy() {
+    DatabaseBackup::Result result = DatabaseBackup::run(databasePath, dir.filePath("restore"), 1);
+    QVERIFY2(result.ok, qPrintable(result.error));
+
+    QString original;
+    QVERIFY(DatabaseBackup::verify(databasePath, original));
+
+    QString target = dir.filePath("restored.db");
+    QString summary;
+    QVERIFY2(DatabaseBackup::restore(result.path, target, summary), qPrintable(summary));
+    QString restored;
+    QVERIFY(DatabaseBackup::verify(target, restored));
+    QCOMPARE(restored, original);
+}
+
+void BackupBenchmark::rejectsDamagedBackup() {
+    QString damaged = dir.filePath("damaged.db");
+    QFile file(damaged);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(QByteArray(8192, 'x'));
+    file.close();
+
+    QString target = dir.filePath("untouched.db");
+    QString summary;
+    QVERIFY(!DatabaseBackup::restore(damaged, target, summary));
+    QVERIFY(!QFileInfo::exists(target));
+}
+
+void BackupBenchmark::purchaseLatencyDuringBackup() {
+    AsyncVendingStore store(databasePath);
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    // Warm up, then the baseline
+    meanPurchaseMicros(engine, 5000);
+    double baseline = meanPurchaseMicros(engine, 20000);
+
+    DatabaseBackup backup(databasePath);
+    backup.setDirectory(dir.filePath("live"));
+    QSignalSpy finished(&backup, &DatabaseBackup::finished);
+    QVERIFY(backup.start());
+
+    // Sell for as long as the backup runs
+    QElapsedTimer clock;
+    clock.start();
+    qint64 sold = 0;
+    qint64 sellingNsecs = 0;
+    while (finished.isEmpty() && clock.elapsed() < 60000) {
+        QElapsedTimer batch;
+        batch.start();
+        meanPurchaseMicros(engine, 500);
+        sellingNsecs += batch.nsecsElapsed();
+        sold += 500;
+        QCoreApplication::processEvents();
+    }
+    QCOMPARE(finished.count(), 1);
+    DatabaseBackup::Result result = finished.first().first().value<DatabaseBackup::Result>();
+    QVERIFY2(result.ok, qPrintable(result.error));
+    qInfo().noquote() << result.summary();
+
+    double during = sellingNsecs / 1000.0 / qMax<qint64>(1, sold);
+    qInfo("purchase: %.2f us baseline, %.2f us during backup (%+.1f%%)",
+          baseline, during, (during / baseline - 1) * 100);
+    // A few percent, plus scheduling noise on a loaded machine
+    QVERIFY(during <= baseline * 1.05 + 1.0);
+}
+
+QTEST_GUILESS_MAIN(BackupBenchmark)
+
+#include "tst_backupbench.moc"
@@ -0,0 +1,23 @@
+# Benchmark suite, built separately from the application. Each subdirectory
+# is a QTest executable using QBENCHMARK; run one with e.g.
+# "./bench_schema -tickcounter", or all of them headlessly with
+# run_benchmarks.sh, which saves XML results per git revision.
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    admin \
+    backup \
+    cart \
+    catalog \
+    changesolver \
+    forecast \
+    journal \
+    lookup \
+    metrics \
+    sales \
+    schema \
+    startup \
+    storage \
+    terminals \
+    views
+
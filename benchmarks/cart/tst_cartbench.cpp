@@ -0,0 +1,148 @@
+// tst_cartbench.cpp
+// A five-item cart checked out for one payment against the same five items
+// bought one at a time, each sale committed to SQLite on its own; and checks
+// that a cart sells whole or not at all, is recorded a row per line, and replays
+// from the journal.
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QTemporaryDir>
+#include "benchfixture.h"
+#include "sqlitestore.h"
+
+class CartBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void cartIsRecordedPerLine();
+    void cartIsAllOrNothing();
+    void cartReplaysFromJournal();
+    void fiveSinglePurchases();
+    void fiveItemCart();
+
+private:
+    static VendingSnapshot seed(int stock);
+    QTemporaryDir dir;
+    QSqlDatabase db;
+};
+
+VendingSnapshot CartBenchmark::seed(int stock) {
+    VendingSnapshot snapshot = BenchFixture::boxes(stock);
+    for (int i = 0; i < 5; ++i) {
+        snapshot.items.append({QString("item%1").arg(i), 15, stock});
+    }
+    return snapshot;
+}
+
+void CartBenchmark::initTestCase() {
+    QVERIFY(dir.isValid());
+    db = BenchFixture::openDatabase("cart", dir.filePath("cart.db"));
+    QVERIFY(db.isOpen());
+}
+
+void CartBenchmark::cleanupTestCase() {
+    BenchFixture::closeDatabase(db);
+}
+
+void CartBenchmark::cartIsRecordedPerLine() {
+    SqliteVendingStore store(db);
+    QVERIFY(store.saveCheckpoint(seed(10)));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    // Repeated items merge: 3 x item0 and 2 x item1 for 75, paid with 100
+    PurchaseResult result = engine.purchaseCart({{"item0", 2}, {"item1", 2}, {"item0", 1}}, {{100, 1}});
+    QCOMPARE(result.status, PurchaseResult::Ok);
+    QCOMPARE(result.price, 75);
+    QCOMPARE(result.change, CoinCounts({{20, 1}, {5, 1}}));
+    QCOMPARE(engine.catalog().stock(0), 7);
+    QCOMPARE(engine.catalog().stock(1), 8);
+
+    QCOMPARE(BenchFixture::queryValue("SELECT stock FROM stock_67011755 WHERE item_name = 'item0'", db), qint64(7));
+    QCOMPARE(BenchFixture::queryValue("SELECT Count FROM change_box_67011755 WHERE THB = 20", db), qint64(9));
+    QCOMPARE(BenchFixture::queryValue("SELECT Count FROM collection_box_67011755 WHERE THB = 100", db), qint64(1));
+    QCOMPARE(BenchFixture::queryValue("SELECT COUNT(*) FROM sales_67011755", db), qint64(2));
+    QCOMPARE(BenchFixture::queryValue("SELECT SUM(quantity) FROM sales_67011755", db), qint64(5));
+    QCOMPARE(BenchFixture::queryValue("SELECT SUM(price * quantity) FROM sales_67011755", db), qint64(75));
+    QCOMPARE(BenchFixture::queryValue("SELECT SUM(payment_total) FROM sales_67011755", db), qint64(100));
+    QCOMPARE(BenchFixture::queryValue("SELECT SUM(change_total) FROM sales_67011755", db), qint64(25));
+    QCOMPARE(BenchFixture::queryValue("SELECT SUM(units) FROM sales_daily_67011755", db), qint64(5));
+    QCOMPARE(BenchFixture::queryValue("SELECT SUM(revenue) FROM sales_hourly_67011755", db), qint64(75));
+}
+
+void CartBenchmark::cartIsAllOrNothing() {
+    MemoryVendingStore store(seed(2));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    PurchaseResult result = engine.purchaseCart({{"item0", 1}, {"item1", 3}}, {{100, 1}});
+    QCOMPARE(result.status, PurchaseResult::OutOfStock);
+    QCOMPARE(result.refusedItem, QString("item1"));
+    result = engine.purchaseCart({{"item0", 1}, {"missing", 1}}, {{100, 1}});
+    QCOMPARE(result.status, PurchaseResult::UnknownItem);
+    QCOMPARE(result.refusedItem, QString("missing"));
+    QCOMPARE(engine.purchaseCart({{"item0", 2}}, {{20, 1}}).status, PurchaseResult::InsufficientPayment);
+    QCOMPARE(engine.purchaseCart({}, {{20, 1}}).status, PurchaseResult::UnknownItem);
+    QCOMPARE(engine.purchaseCart({{"item0", 0}}, {{20, 1}}).status, PurchaseResult::InvalidQuantity);
+    QCOMPARE(engine.purchaseCart({{"item0", 1}, {"item0", VendingEngine::kMaxCartUnits}}, {{100, 1}}).status,
+             PurchaseResult::InvalidQuantity);
+
+    QCOMPARE(engine.catalog().stock(0), 2);
+    QCOMPARE(engine.collectionBox().value(100), 0);
+}
+
+void CartBenchmark::cartReplaysFromJournal() {
+    QString path = dir.filePath("cart.journal");
+    {
+        TransactionJournal journal;
+        QVERIFY(journal.open(path));
+        MemoryVendingStore store(seed(10));
+        VendingEngine engine(&store);
+        engine.setJournal(&journal);
+        QVERIFY(engine.load());
+        QCOMPARE(engine.purchaseCart({{"item2", 4}, {"item3", 1}}, {{100, 1}}).status, PurchaseResult::Ok);
+    }
+
+    TransactionJournal journal;
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.lastSequence(), quint64(1));
+    MemoryVendingStore store(seed(10));
+    VendingEngine engine(&store);
+    engine.setJournal(&journal);
+    QVERIFY(engine.load());
+    QCOMPARE(engine.catalog().stock(2), 6);
+    QCOMPARE(engine.catalog().stock(3), 9);
+    QCOMPARE(engine.changeBox().value(20), 9);
+    QCOMPARE(engine.changeBox().value(5), 9);
+    QCOMPARE(engine.collectionBox().value(100), 1);
+}
+
+void CartBenchmark::fiveSinglePurchases() {
+    SqliteVendingStore store(db);
+    QVERIFY(store.saveCheckpoint(seed(1000000)));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    QBENCHMARK {
+        for (int i = 0; i < 5; ++i) {
+            QCOMPARE(engine.purchase(QString("item%1").arg(i), {{20, 1}}).status, PurchaseResult::Ok);
+        }
+    }
+}
+
+void CartBenchmark::fiveItemCart() {
+    SqliteVendingStore store(db);
+    QVERIFY(store.saveCheckpoint(seed(1000000)));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    const QVector<CartLine> cart = {{"item0", 1}, {"item1", 1}, {"item2", 1}, {"item3", 1}, {"item4", 1}};
+    QBENCHMARK {
+        QCOMPARE(engine.purchaseCart(cart, {{100, 1}}).status, PurchaseResult::Ok);
+    }
+}
+
+QTEST_GUILESS_MAIN(CartBenchmark)
+
+#include "tst_cartbench.moc"
@@ -0,0 +1,153 @@
+// tst_catalogbench.cpp
+// Provisioning a machine from a 100k-item planogram, in CSV and binary form,
+// and exporting it back out.
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include "benchfixture.h"
+#include "catalogio.h"
+
+class CatalogBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void rowErrorsDoNotAbort();
+    void roundTrip();
+    void importPlanogram_data();
+    void importPlanogram();
+    void exportPlanogram_data();
+    void exportPlanogram();
+
+private:
+    QSqlDatabase database(const QString &name);
+    QTemporaryDir dir;
+    QStringList connections;
+};
+
+static const int kPlanogramItems = 100000;
+
+QSqlDatabase CatalogBenchmark::database(const QString &name) {
+    QSqlDatabase db = BenchFixture::openDatabase(name, dir.filePath(name + ".db"));
+    if (db.isOpen()) {
+        connections << name;
+    }
+    return db;
+}
+
+void CatalogBenchmark::initTestCase() {
+    QVERIFY(dir.isValid());
+
+    QFile file(dir.filePath("planogram.csv"));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QTextStream out(&file);
+    out << "item_name,price,stock\n";
+    for (int i = 0; i < kPlanogramItems; ++i) {
+        out << "item" << i << ',' << (5 + i % 95) << ',' << (i % 50) << '\n';
+    }
+    out.flush();
+    file.close();
+
+    // The binary planogram is the CSV one round-tripped through a database
+    QSqlDatabase db = database("source");
+    CatalogIO catalog(db);
+    QVERIFY(catalog.importFile(dir.filePath("planogram.csv")));
+    QVERIFY(catalog.exportFile(dir.filePath("planogram.vcat")));
+    QCOMPARE(catalog.rowsExported(), qint64(kPlanogramItems));
+}
+
+void CatalogBenchmark::cleanupTestCase() {
+    for (const QString &name : connections) {
+        QSqlDatabase::database(name).close();
+    }
+    for (const QString &name : connections) {
+        QSqlDatabase::removeDatabase(name);
+    }
+}
+
+void CatalogBenchmark::rowErrorsDoNotAbort() {
+    QByteArray csv =
+        "item_name,price,stock\n"
+        "cola,15,10\n"
+        "broken,,3\n"
+        "\"chips, salted\",20,5\n"
+        "\n"
+        "negative,10,-1\n"
+        "\"multi\nline\",12,1\n"
+        "too,many,fields,here\n";
+    QBuffer buffer(&csv);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+
+    QSqlDatabase db = database("errors");
+    CatalogIO catalog(db);
+    QVERIFY(catalog.importDevice(&buffer, CatalogIO::Csv));
+    QCOMPARE(catalog.rowsImported(), qint64(3));
+    QCOMPARE(catalog.rejectedRows(), qint64(3));
+    QCOMPARE(catalog.rowErrors().at(0).row, qint64(3));
+    QCOMPARE(catalog.rowErrors().at(1).row, qint64(6));
+    QCOMPARE(catalog.rowErrors().at(2).row, qint64(8));
+    QCOMPARE(BenchFixture::queryValue("SELECT COUNT(*) FROM stock_67011755", db), qint64(3));
+
+    QSqlQuery query(db);
+    QVERIFY(query.exec("SELECT stock FROM stock_67011755 WHERE item_name = 'chips, salted'"));
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 5);
+}
+
+void CatalogBenchmark::roundTrip() {
+    QSqlDatabase db = database("roundtrip");
+    CatalogIO catalog(db);
+    QVERIFY(catalog.importFile(dir.filePath("planogram.vcat")));
+    QCOMPARE(catalog.rejectedRows(), qint64(0));
+
+    QString exported = dir.filePath("roundtrip.csv");
+    QVERIFY(catalog.exportFile(exported));
+
+    QFile original(dir.filePath("planogram.csv"));
+    QFile copy(exported);
+    QVERIFY(original.open(QIODevice::ReadOnly));
+    QVERIFY(copy.open(QIODevice::ReadOnly));
+    QVERIFY(original.readAll() == copy.readAll());
+}
+
+void CatalogBenchmark::importPlanogram_data() {
+    QTest::addColumn<QString>("file");
+    QTest::newRow("csv") << "planogram.csv";
+    QTest::newRow("binary") << "planogram.vcat";
+}
+
+void CatalogBenchmark::importPlanogram() {
+    QFETCH(QString, file);
+
+    // Each run provisions a fresh machine
+    QSqlDatabase db = database("import_" + QFileInfo(file).suffix());
+    CatalogIO catalog(db);
+    QBENCHMARK_ONCE {
+        QVERIFY(catalog.importFile(dir.filePath(file)));
+    }
+    QCOMPARE(catalog.rowsImported(), qint64(kPlanogramItems));
+    QCOMPARE(BenchFixture::queryValue("SELECT COUNT(*) FROM stock_67011755", db), qint64(kPlanogramItems));
+}
+
+void CatalogBenchmark::exportPlanogram_data() {
+    QTest::addColumn<QString>("file");
+    QTest::newRow("csv") << "export.csv";
+    QTest::newRow("binary") << "export.vcat";
+}
+
+void CatalogBenchmark::exportPlanogram() {
+    QFETCH(QString, file);
+
+    CatalogIO catalog(QSqlDatabase::database("source"));
+    QBENCHMARK {
+        QVERIFY(catalog.exportFile(dir.filePath(file)));
+    }
+    QCOMPARE(catalog.rowsExported(), qint64(kPlanogramItems));
+}
+
+QTEST_GUILESS_MAIN(CatalogBenchmark)
+
+#include "tst_catalogbench.moc"
@@ -0,0 +1,18 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = bench_changesolver
+
+INCLUDEPATH += ../..
+
+include(../common/common.pri)
+
+SOURCES += \
+    ../../changesolver.cpp \
+    tst_changesolverbench.cpp
+
+HEADERS += \
+    ../../changesolver.h
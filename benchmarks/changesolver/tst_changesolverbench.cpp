@@ -0,0 +1,121 @@
+// tst_changesolverbench.cpp
+// Cold (DP build) against cached (memo hit) change solves, plus a pre-check
+// of every change amount up to the largest accepted note.
+#include <QtTest>
+#include <limits>
+#include "changesolver.h"
+
+class ChangeSolverBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void solvesExactChangeGreedyMisses();
+    void preserveAvoidsScarceCoins();
+    void hugeAmountsAreRefused();
+    void solveCold();
+    void solveCached_data();
+    void solveCached();
+    void precheckAllAmounts();
+
+private:
+    static QVector<int> denominations() { return {20, 10, 5, 1}; }
+};
+
+void ChangeSolverBenchmark::solvesExactChangeGreedyMisses() {
+    // With a non-chained set, greedy takes the 50 and is stuck on 10; the
+    // DP hands out three 20s instead
+    ChangeSolver solver({50, 20, 10}, 100);
+    CoinCounts box = {{50, 1}, {20, 3}, {10, 0}};
+    CoinCounts change;
+    QVERIFY(solver.solve(box, 60, change));
+    QCOMPARE(change, (CoinCounts{{20, 3}}));
+
+    ChangeSolver thb(denominations(), 100);
+    box = {{20, 2}, {10, 0}, {5, 3}, {1, 0}};
+    QVERIFY(thb.solve(box, 15, change));
+    QCOMPARE(change, (CoinCounts{{5, 3}}));
+    QVERIFY(!thb.canMake(box, 16));
+}
+
+void ChangeSolverBenchmark::preserveAvoidsScarceCoins() {
+    ChangeSolver solver(denominations(), 100);
+    CoinCounts box = {{20, 1}, {10, 50}, {5, 50}, {1, 50}};
+    CoinCounts change;
+
+    QVERIFY(solver.solve(box, 20, change));
+    QCOMPARE(change, (CoinCounts{{20, 1}}));
+
+    solver.setPolicy(ChangeSolver::PreserveLowStock);
+    QVERIFY(solver.solve(box, 20, change));
+    QCOMPARE(change, (CoinCounts{{10, 2}}));
+}
+
+void ChangeSolverBenchmark::hugeAmountsAreRefused() {
+    ChangeSolver solver(denominations(), 100);
+    CoinCounts change;
+
+    // Beyond the box's worth: refused before any table is built
+    CoinCounts box = {{20, 5}, {10, 5}, {5, 5}, {1, 5}};
+    QVERIFY(!solver.solve(box, std::numeric_limits<int>::max(), change));
+    QVERIFY(change.isEmpty());
+
+    // A count past what a table entry holds is never handed out wrapped
+    box = {{20, 0}, {10, 0}, {5, 0}, {1, 100000}};
+    QVERIFY(!solver.solve(box, 70000, change));
+    QVERIFY(solver.solve(box, 60000, change));
+    QCOMPARE(change, (CoinCounts{{1, 60000}}));
+}
+
+void ChangeSolverBenchmark::solveCold() {
+    ChangeSolver solver(denominations(), 100);
+    CoinCounts box = {{20, 40}, {10, 40}, {5, 40}, {1, 40}};
+    CoinCounts change;
+
+    QBENCHMARK {
+        solver.clearCache();
+        solver.solve(box, 37, change);
+    }
+    QVERIFY(!change.isEmpty());
+}
+
+void ChangeSolverBenchmark::solveCached_data() {
+    QTest::addColumn<int>("policy");
+
+    QTest::newRow("fewest") << int(ChangeSolver::FewestCoins);
+    QTest::newRow("preserve") << int(ChangeSolver::PreserveLowStock);
+}
+
+void ChangeSolverBenchmark::solveCached() {
+    QFETCH(int, policy);
+
+    ChangeSolver solver(denominations(), 100);
+    solver.setPolicy(ChangeSolver::Policy(policy));
+    CoinCounts box = {{20, 40}, {10, 40}, {5, 40}, {1, 40}};
+    CoinCounts change;
+    solver.solve(box, 37, change);
+
+    QBENCHMARK {
+        solver.solve(box, 37, change);
+    }
+    QCOMPARE(solver.cachedStates(), 1);
+}
+
+void ChangeSolverBenchmark::precheckAllAmounts() {
+    ChangeSolver solver(denominations(), 100);
+    CoinCounts box = {{20, 3}, {10, 0}, {5, 2}, {1, 4}};
+    int makeable = 0;
+
+    QBENCHMARK {
+        makeable = 0;
+        for (int amount = 0; amount <= solver.maxAmount(); ++amount) {
+            if (solver.canMake(box, amount)) {
+                makeable++;
+            }
+        }
+    }
+    QVERIFY(makeable > 0);
+}
+
+QTEST_GUILESS_MAIN(ChangeSolverBenchmark)
+
+#include "tst_changesolverbench.moc"
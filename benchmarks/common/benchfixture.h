@@ -0,0 +1,58 @@
+// benchfixture.h
+// Setup shared by the benchmarks that run against a real machine state or
+// database file.
+#ifndef BENCHFIXTURE_H
+#define BENCHFIXTURE_H
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QVariant>
+#include "currency.h"
+#include "database.h"
+#include "vendingengine.h"
+
+class BenchFixture {
+public:
+    // No items, changeCoins of every change denomination and an empty
+    // collection box, in whichever currency the build is for
+    static VendingSnapshot boxes(int changeCoins) {
+        VendingSnapshot snapshot;
+        for (int denomination : Currency::Dispensable::toVector()) {
+            snapshot.changeBox[denomination] = changeCoins;
+        }
+        for (int denomination : Currency::Accepted::toVector()) {
+            snapshot.collectionBox[denomination] = 0;
+        }
+        return snapshot;
+    }
+
+    // Opens a named connection to path and brings its schema up to date; the
+    // result is not open on failure
+    static QSqlDatabase openDatabase(const QString &connectionName, const QString &path) {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(path);
+        if (!db.open() || !Database::prepare(db)) {
+            db.close();
+        }
+        return db;
+    }
+
+    // Drops every handle to the connection before removing it
+    static void closeDatabase(QSqlDatabase &db) {
+        QString connectionName = db.connectionName();
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(connectionName);
+    }
+
+    // First column of the first row, or -1 if the query fails or is empty
+    static qint64 queryValue(const QString &sql, QSqlDatabase db) {
+        QSqlQuery query(db);
+        if (!query.exec(sql) || !query.next()) {
+            return -1;
+        }
+        return query.value(0).toLongLong();
+    }
+};
+
+#endif // BENCHFIXTURE_H
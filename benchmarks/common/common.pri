@@ -0,0 +1,5 @@
+# Fixtures shared by every benchmark.
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/benchfixture.h
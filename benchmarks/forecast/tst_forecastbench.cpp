@@ -0,0 +1,109 @@
+// tst_forecastbench.cpp
+// Accuracy of the streaming sales-rate estimates, and their cost per sale
+// on a 50k-item catalog, alone and inside a full purchase.
+#include <QtTest>
+#include <QDateTime>
+#include <cmath>
+#include "benchfixture.h"
+#include "salesforecaster.h"
+#include "vendingengine.h"
+
+class ForecastBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void steadyRate();
+    void warmUp();
+    void decaysWithoutSales();
+    void projections();
+    void recordSale();
+    void purchase();
+
+private:
+    static const int kItems = 50000;
+    static const qint64 kHour = 3600 * 1000;
+};
+
+void ForecastBenchmark::steadyRate() {
+    // Ten sales an hour for two days
+    qint64 start = QDateTime::currentMSecsSinceEpoch() - 48 * kHour;
+    SalesForecaster forecaster;
+    for (int i = 0; i < 480; ++i) {
+        forecaster.recordSale("Cola", {{20, 1}}, start + i * kHour / 10);
+    }
+    qint64 now = start + 48 * kHour;
+    QVERIFY(qAbs(forecaster.itemRate("Cola", now) - 10) < 1);
+    QVERIFY(qAbs(forecaster.coinRate(20, now) - 10) < 1);
+    QCOMPARE(forecaster.itemRate("Water", now), 0.0);
+}
+
+void ForecastBenchmark::warmUp() {
+    // Three hours into a window, the rate is already about right
+    qint64 start = QDateTime::currentMSecsSinceEpoch() - 3 * kHour;
+    SalesForecaster forecaster;
+    for (int i = 0; i < 30; ++i) {
+        forecaster.recordSale("Cola", {{20, 1}}, start + i * kHour / 10);
+    }
+    QVERIFY(qAbs(forecaster.itemRate("Cola", start + 3 * kHour) - 10) < 1.5);
+}
+
+void ForecastBenchmark::decaysWithoutSales() {
+    qint64 start = QDateTime::currentMSecsSinceEpoch() - 48 * kHour;
+    SalesForecaster forecaster(24 * kHour);
+    for (int i = 0; i < 240; ++i) {
+        forecaster.recordSale("Cola", {{20, 1}}, start + i * kHour / 10);
+    }
+    double atStop = forecaster.itemRate("Cola", start + 24 * kHour);
+    double dayLater = forecaster.itemRate("Cola", start + 48 * kHour);
+
+    // A window of silence decays the count by 1/e, and the warm-up scaling
+    // moves from one observed window to two
+    double expected = std::exp(-1.0) * (1 - std::exp(-1.0)) / (1 - std::exp(-2.0));
+    QVERIFY(qAbs(dayLater / atStop - expected) < 0.02);
+}
+
+void ForecastBenchmark::projections() {
+    QCOMPARE(SalesForecaster::hoursUntil(0, 5), 0.0);
+    QCOMPARE(SalesForecaster::hoursUntil(10, 5), 2.0);
+    QVERIFY(SalesForecaster::hoursUntil(10, 0) < 0);
+}
+
+void ForecastBenchmark::recordSale() {
+    SalesForecaster forecaster;
+    QVector<QString> names;
+    for (int i = 0; i < kItems; ++i) {
+        names.append(QString("Item %1").arg(i));
+        forecaster.recordSale(names.last(), {{20, 1}}, QDateTime::currentMSecsSinceEpoch());
+    }
+
+    const CoinCounts payment = {{20, 1}, {5, 1}};
+    qint64 at = QDateTime::currentMSecsSinceEpoch();
+    int next = 0;
+    QBENCHMARK {
+        forecaster.recordSale(names.at(next), payment, at++);
+        next = (next * 7 + 13) % kItems;
+    }
+}
+
+void ForecastBenchmark::purchase() {
+    // Compare against bench_views' purchase for the engine without it
+    VendingSnapshot initial = BenchFixture::boxes(1 << 30);
+    for (int i = 0; i < kItems; ++i) {
+        initial.items.append({QString("Item %1").arg(i), 15, 1 << 30});
+    }
+    MemoryVendingStore store(initial);
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    const CoinCounts payment = {{20, 1}};
+    int next = 0;
+    QBENCHMARK {
+        PurchaseResult result = engine.purchase(initial.items.at(next).name, payment);
+        Q_UNUSED(result);
+        next = (next * 7 + 13) % kItems;
+    }
+}
+
+QTEST_GUILESS_MAIN(ForecastBenchmark)
+
+#include "tst_forecastbench.moc"
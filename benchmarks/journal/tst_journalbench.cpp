@@ -0,0 +1,262 @@
+// tst_journalbench.cpp
+// Journal append cost per event, and replay of a million-event journal into
+// an engine as done at startup.
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include "benchfixture.h"
+#include "sqlitestore.h"
+#include "transactionjournal.h"
+#include "vendingengine.h"
+
+class JournalBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void replayRestoresState();
+    void tornTailIsTruncated();
+    void failedWriteIsRepaired();
+    void compactionRotatesJournal();
+    void tornRotatedJournalEndsReplay();
+    void oversizeFieldsAreRefused();
+    void append();
+    void replayMillion();
+
+private:
+    static JournalEvent purchaseEvent(int i);
+    QTemporaryDir dir;
+};
+
+JournalEvent JournalBenchmark::purchaseEvent(int i) {
+    JournalEvent event;
+    event.type = JournalEvent::Purchase;
+    event.itemName = QString("item%1").arg(i % 50);
+    event.price = 15;
+    event.payment = {{20, 1}};
+    event.change = {{5, 1}};
+    return event;
+}
+
+void JournalBenchmark::initTestCase() {
+    QVERIFY(dir.isValid());
+}
+
+void JournalBenchmark::replayRestoresState() {
+    VendingSnapshot initial = BenchFixture::boxes(5);
+    initial.items.append({"cola", 15, 10});
+
+    QString path = dir.filePath("state.journal");
+    {
+        TransactionJournal journal;
+        QVERIFY(journal.open(path));
+        MemoryVendingStore store(initial);
+        VendingEngine engine(&store);
+        engine.setJournal(&journal);
+        QVERIFY(engine.load());
+        QCOMPARE(engine.purchase("cola", {{20, 1}}).status, PurchaseResult::Ok);
+        QVERIFY(engine.restockItem("cola", 3));
+        QVERIFY(engine.addItem("water", 10, 4));
+    }
+
+    // A store still holding the old checkpoint is rolled forward by replay
+    TransactionJournal journal;
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.lastSequence(), quint64(3));
+    MemoryVendingStore store(initial);
+    VendingEngine engine(&store);
+    engine.setJournal(&journal);
+    QVERIFY(engine.load());
+    QCOMPARE(engine.catalog().size(), 2);
+    QCOMPARE(engine.catalog().stock(0), 12);
+    QCOMPARE(engine.changeBox().value(5), 4);
+    QCOMPARE(engine.collectionBox().value(20), 1);
+}
+
+void JournalBenchmark::tornTailIsTruncated() {
+    QString path = dir.filePath("torn.journal");
+    {
+        TransactionJournal journal;
+        QVERIFY(journal.open(path));
+        JournalEvent event = purchaseEvent(0);
+        QVERIFY(journal.append(event));
+        QVERIFY(journal.append(event));
+    }
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 3));
+    file.close();
+
+    TransactionJournal journal;
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.lastSequence(), quint64(1));
+    QCOMPARE(journal.replay(0, [](const JournalEvent &) {}), qint64(1));
+}
+
+void JournalBenchmark::failedWriteIsRepaired() {
+    VendingSnapshot initial = BenchFixture::boxes(5);
+    initial.items.append({"cola", 15, 10});
+
+    QString journalPath = dir.filePath("repair.journal");
+    {
+        QSqlDatabase db = BenchFixture::openDatabase("repair", dir.filePath("repair.db"));
+        QVERIFY(db.isOpen());
+        SqliteVendingStore store(db);
+        QVERIFY(store.saveCheckpoint(initial));
+
+        TransactionJournal journal;
+        QVERIFY(journal.open(journalPath));
+        VendingEngine engine(&store);
+        engine.setJournal(&journal);
+        QVERIFY(engine.load());
+
+        // The restock is journaled but its table write fails
+        QSqlQuery query(db);
+        QVERIFY(query.exec("CREATE TRIGGER refuse_restock BEFORE UPDATE OF stock ON stock_67011755 "
+                           "WHEN NEW.stock > OLD.stock BEGIN SELECT RAISE(ABORT, 'refused'); END"));
+        QVERIFY(engine.restockItem("cola", 5));
+        QVERIFY(store.needsCheckpoint());
+        QVERIFY(query.exec("DROP TRIGGER refuse_restock"));
+
+        // The next sale commits a later sequence, so the tables must hold the
+        // restock by then or replay would never bring it back
+        QCOMPARE(engine.purchase("cola", {{20, 1}}).status, PurchaseResult::Ok);
+        QVERIFY(!store.needsCheckpoint());
+    }
+
+    {
+        SqliteVendingStore store(QSqlDatabase::database("repair"));
+        TransactionJournal journal;
+        QVERIFY(journal.open(journalPath));
+        VendingEngine engine(&store);
+        engine.setJournal(&journal);
+        QVERIFY(engine.load());
+        QCOMPARE(engine.catalog().stock(0), 14);
+        QCOMPARE(engine.collectionBox().value(20), 1);
+
+        VendingSnapshot stored;
+        QVERIFY(store.load(stored));
+        QCOMPARE(stored.items.first().stock, 14);
+        QCOMPARE(stored.journalSequence, quint64(2));
+    }
+    QSqlDatabase::removeDatabase("repair");
+}
+
+void JournalBenchmark::compactionRotatesJournal() {
+    QString path = dir.filePath("compact.journal");
+    JournalEvent event = purchaseEvent(0);
+    {
+        TransactionJournal journal;
+        QVERIFY(journal.open(path));
+        QVERIFY(journal.append(event));
+        QVERIFY(journal.append(event));
+
+        // A checkpoint short of the last event keeps the file
+        QVERIFY(journal.compact(1));
+        QVERIFY(QFileInfo(path).size() > 0);
+        QVERIFY(journal.compact(2));
+        QCOMPARE(QFileInfo(path).size(), qint64(0));
+    }
+
+    // Numbering carries over the empty file, and a checkpoint older than it
+    // still replays the rotated generation
+    TransactionJournal journal;
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.lastSequence(), quint64(2));
+    QVERIFY(journal.append(event));
+    QCOMPARE(event.sequence, quint64(3));
+    QCOMPARE(journal.replay(0, [](const JournalEvent &) {}), qint64(3));
+    QCOMPARE(journal.replay(2, [](const JournalEvent &) {}), qint64(1));
+}
+
+void JournalBenchmark::tornRotatedJournalEndsReplay() {
+    QString path = dir.filePath("rotated.journal");
+    {
+        TransactionJournal journal;
+        QVERIFY(journal.open(path));
+        JournalEvent event = purchaseEvent(0);
+        QVERIFY(journal.append(event));
+        QVERIFY(journal.append(event));
+        QVERIFY(journal.compact(2));
+    }
+
+    // open() only truncates the current file, so replay must not trust the
+    // last length in the rotated one
+    QFile rotated(path + ".1");
+    QVERIFY(rotated.open(QIODevice::ReadWrite));
+    QVERIFY(rotated.resize(rotated.size() - 3));
+    rotated.close();
+
+    TransactionJournal journal;
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.replay(0, [](const JournalEvent &) {}), qint64(1));
+}
+
+void JournalBenchmark::oversizeFieldsAreRefused() {
+    QString path = dir.filePath("oversize.journal");
+    TransactionJournal journal;
+    QVERIFY(journal.open(path));
+
+    // Names are framed with a u16 length
+    JournalEvent event = purchaseEvent(0);
+    event.itemName = QString(0x10000, QChar('x'));
+    QVERIFY(!journal.append(event));
+    event = purchaseEvent(0);
+    event.type = JournalEvent::Cart;
+    event.lines.append({QString(0x10000, QChar('x')), 15, 1});
+    QVERIFY(!journal.append(event));
+
+    event = purchaseEvent(0);
+    QVERIFY(journal.append(event));
+    QCOMPARE(event.sequence, quint64(1));
+    journal.close();
+    QVERIFY(journal.open(path));
+    QCOMPARE(journal.replay(0, [](const JournalEvent &) {}), qint64(1));
+}
+
+void JournalBenchmark::append() {
+    TransactionJournal journal;
+    QVERIFY(journal.open(dir.filePath("append.journal")));
+    JournalEvent event = purchaseEvent(7);
+
+    QBENCHMARK {
+        journal.append(event);
+    }
+}
+
+void JournalBenchmark::replayMillion() {
+    const int events = 1000000;
+    QString path = dir.filePath("million.journal");
+
+    VendingSnapshot initial = BenchFixture::boxes(events);
+    for (int i = 0; i < 50; ++i) {
+        initial.items.append({QString("item%1").arg(i), 15, events});
+    }
+
+    {
+        TransactionJournal journal;
+        QVERIFY(journal.open(path));
+        for (int i = 0; i < events; ++i) {
+            JournalEvent event = purchaseEvent(i);
+            QVERIFY(journal.append(event));
+        }
+    }
+
+    TransactionJournal journal;
+    QVERIFY(journal.open(path));
+    MemoryVendingStore store(initial);
+
+    QBENCHMARK_ONCE {
+        VendingEngine engine(&store);
+        engine.setJournal(&journal);
+        QVERIFY(engine.load());
+        QCOMPARE(engine.collectionBox().value(20), events);
+        store.saveCheckpoint(initial);
+    }
+}
+
+QTEST_GUILESS_MAIN(JournalBenchmark)
+
+#include "tst_journalbench.moc"
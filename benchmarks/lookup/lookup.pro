@@ -0,0 +1,18 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = bench_lookup
+
+INCLUDEPATH += ../..
+
+include(../common/common.pri)
+
+SOURCES += \
+    ../../catalog.cpp \
+    tst_lookupbench.cpp
+
+HEADERS += \
+    ../../catalog.h
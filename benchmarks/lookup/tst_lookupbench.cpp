@@ -0,0 +1,112 @@
+// tst_lookupbench.cpp
+// Item lookup and price checks on the engine's column-wise catalog at 100k
+// items, compared with the QHash<QString, int> index it replaced, and the
+// memory the catalog takes.
+#include <QtTest>
+#include "catalog.h"
+
+class LookupBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void findsEveryItem();
+    void duplicatesKeepFirst();
+    void removeShiftsRows();
+    void memory();
+    void catalogFind();
+    void hashFind();
+    void priceCheck();
+
+private:
+    static const int kItems = 100000;
+    Catalog catalog;
+    QHash<QString, int> hash;
+    QVector<QString> probes; // separate copies, as a caller would pass
+};
+
+void LookupBenchmark::initTestCase() {
+    QVector<StockItem> items;
+    for (int i = 0; i < kItems; ++i) {
+        items.append({QString("Item %1").arg(i), 10 + i % 90, i % 50});
+        hash.insert(items.last().name, i);
+    }
+    catalog.assign(items);
+    for (int i = 0; i < 4096; ++i) {
+        probes.append(QString("Item %1").arg((i * 7919) % kItems));
+    }
+}
+
+void LookupBenchmark::findsEveryItem() {
+    for (int i = 0; i < kItems; i += 97) {
+        QCOMPARE(catalog.find(QString("Item %1").arg(i)), i);
+    }
+    QCOMPARE(catalog.find("Missing"), -1);
+    QCOMPARE(Catalog().find("Item 1"), -1);
+}
+
+void LookupBenchmark::duplicatesKeepFirst() {
+    Catalog duplicates;
+    duplicates.assign({{"Cola", 15, 1}, {"Water", 10, 2}, {"Cola", 20, 3}});
+    QCOMPARE(duplicates.size(), 3);
+    QCOMPARE(duplicates.find("Cola"), 0);
+    QCOMPARE(duplicates.append("Juice", 25, 4), 3);
+    QCOMPARE(duplicates.find("Juice"), 3);
+}
+
+void LookupBenchmark::removeShiftsRows() {
+    Catalog small;
+    for (int i = 0; i < 40; ++i) {
+        small.append(QString("Item %1").arg(i), i, i);
+    }
+    small.remove(10);
+    QCOMPARE(small.size(), 39);
+    QCOMPARE(small.find("Item 10"), -1);
+    QCOMPARE(small.find("Item 11"), 10);
+    QCOMPARE(small.price(10), 11);
+    QCOMPARE(small.find("Item 39"), 38);
+}
+
+void LookupBenchmark::memory() {
+    qint64 bytes = catalog.memoryUsage();
+    qInfo("%d items: %.1f MB", kItems, bytes / 1048576.0);
+    QVERIFY(bytes < 10 * 1024 * 1024);
+}
+
+void LookupBenchmark::catalogFind() {
+    int next = 0;
+    int found = 0;
+    QBENCHMARK {
+        found += catalog.find(probes.at(next)) >= 0;
+        next = (next + 1) & 4095;
+    }
+    QVERIFY(found > 0);
+}
+
+void LookupBenchmark::hashFind() {
+    int next = 0;
+    int found = 0;
+    QBENCHMARK {
+        found += hash.value(probes.at(next), -1) >= 0;
+        next = (next + 1) & 4095;
+    }
+    QVERIFY(found > 0);
+}
+
+void LookupBenchmark::priceCheck() {
+    // What a purchase does before touching change: find, price, stock
+    int next = 0;
+    qint64 total = 0;
+    QBENCHMARK {
+        int row = catalog.find(probes.at(next));
+        if (catalog.stock(row) > 0) {
+            total += catalog.price(row);
+        }
+        next = (next + 1) & 4095;
+    }
+    QVERIFY(total > 0);
+}
+
+QTEST_GUILESS_MAIN(LookupBenchmark)
+
+#include "tst_lookupbench.moc"
@@ -0,0 +1,18 @@
+QT       += core testlib
+QT       -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = bench_metrics
+
+INCLUDEPATH += ../..
+
+include(../common/common.pri)
+
+SOURCES += \
+    ../../metrics.cpp \
+    tst_metricsbench.cpp
+
+HEADERS += \
+    ../../metrics.h
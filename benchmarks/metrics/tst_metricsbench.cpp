@@ -0,0 +1,87 @@
+// tst_metricsbench.cpp
+// Recording cost of the metrics hot path, which must stay well under a
+// microsecond, and the accuracy of the histogram percentiles.
+#include <QtTest>
+#include "metrics.h"
+
+class MetricsBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void bucketsBoundEveryValue();
+    void percentiles();
+    void openMetricsText();
+    void counterIncrement();
+    void histogramRecord();
+    void scopedTimer();
+};
+
+void MetricsBenchmark::bucketsBoundEveryValue() {
+    for (quint64 value : {quint64(0), quint64(1), quint64(15), quint64(16), quint64(17), quint64(1000),
+                          quint64(123456789), quint64(1) << 40, ~quint64(0) >> 1}) {
+        int index = LatencyHistogram::bucketIndex(value);
+        QVERIFY(index >= 0 && index < LatencyHistogram::kBuckets);
+        QVERIFY(value < LatencyHistogram::bucketUpperBound(index));
+        QVERIFY(index == 0 || value >= LatencyHistogram::bucketUpperBound(index - 1));
+    }
+}
+
+void MetricsBenchmark::percentiles() {
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 10000; ++i) {
+        histogram.record(i * 1000);
+    }
+    QCOMPARE(histogram.count(), quint64(10000));
+    QCOMPARE(histogram.max(), qint64(10000000));
+
+    // Within one sub-bucket (1/16) above the exact value
+    const struct {
+        double fraction;
+        qint64 exact;
+    } expected[] = {{0.5, 5000000}, {0.99, 9900000}, {0.999, 9990000}};
+    for (const auto &point : expected) {
+        qint64 reported = histogram.percentile(point.fraction);
+        QVERIFY2(reported >= point.exact && reported <= point.exact + point.exact / 16,
+                 qPrintable(QString("p%1 = %2").arg(point.fraction * 100).arg(reported)));
+    }
+}
+
+void MetricsBenchmark::openMetricsText() {
+    Metrics::counter("bench_events", "Events.", "kind=\"a\"")->increment(3);
+    Metrics::latency("bench")->record(2000);
+
+    QString text = Metrics::openMetricsText();
+    QVERIFY(text.contains("# TYPE bench_events counter\n"));
+    QVERIFY(text.contains("bench_events_total{kind=\"a\"} 3\n"));
+    QVERIFY(text.contains("# TYPE vending_latency_seconds histogram\n"));
+    QVERIFY(text.contains("vending_latency_seconds_bucket{path=\"bench\",le=\"+Inf\"} 1\n"));
+    QVERIFY(text.contains("vending_latency_seconds_count{path=\"bench\"} 1\n"));
+    QVERIFY(text.endsWith("# EOF\n"));
+}
+
+void MetricsBenchmark::counterIncrement() {
+    Counter *counter = Metrics::counter("bench_increments", "Increments.");
+    QBENCHMARK {
+        counter->increment();
+    }
+}
+
+void MetricsBenchmark::histogramRecord() {
+    LatencyHistogram *histogram = Metrics::latency("bench_record");
+    qint64 value = 1;
+    QBENCHMARK {
+        histogram->record(value);
+        value = (value * 7 + 13) & 0xFFFFF;
+    }
+}
+
+void MetricsBenchmark::scopedTimer() {
+    LatencyHistogram *histogram = Metrics::latency("bench_scope");
+    QBENCHMARK {
+        ScopedTimer timer(histogram);
+    }
+}
+
+QTEST_GUILESS_MAIN(MetricsBenchmark)
+
+#include "tst_metricsbench.moc"
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Runs every bench_* executable under a build directory without a display
+# and writes QTest XML (for tooling) and plain text (for reading) results
+# to <output>/<git revision>/, so runs before and after a change can be
+# diffed.
+#
+# usage: run_benchmarks.sh [build-dir] [output-dir] [extra QTest args...]
+#   e.g. run_benchmarks.sh ../build-benchmarks results -tickcounter
+
+build=${1:-.}
+output=${2:-benchmark-results}
+[ $# -gt 0 ] && shift
+[ $# -gt 0 ] && shift
+
+revision=$(git -C "$(dirname "$0")" rev-parse --short HEAD 2>/dev/null || echo unknown)
+dir="$output/$revision"
+mkdir -p "$dir" || exit 1
+
+QT_QPA_PLATFORM=offscreen
+export QT_QPA_PLATFORM
+
+failed=0
+for bench in $(find "$build" -type f -name 'bench_*' -perm -u+x | sort); do
+    name=$(basename "$bench")
+    echo "== $name"
+    if ! "$bench" -o "$dir/$name.xml,xml" -o "$dir/$name.txt,txt" "$@"; then
+        echo "$name failed" >&2
+        failed=1
+    fi
+done
+
+echo "Results in $dir"
+exit $failed
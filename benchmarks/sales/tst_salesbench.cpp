@@ -0,0 +1,139 @@
+// tst_salesbench.cpp
+// Analytics over a year of sales for one machine, answered from the hourly
+// and daily rollups, against the same question asked of the raw sales.
+#include <QtTest>
+#include <QDateTime>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include "benchfixture.h"
+#include "salesanalytics.h"
+#include "sqlitestore.h"
+
+class SalesBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void rollupsMatchSales();
+    void topSellersYear();
+    void topSellersYearFromSales();
+    void revenueByDayYear();
+    void revenueByHourDay();
+
+private:
+    QTemporaryDir dir;
+    QSqlDatabase db;
+    int fromDay = 0;
+    int toDay = 0;
+};
+
+static const int kItems = 50;
+static const int kSalesPerDay = 300;
+static const int kDays = 365;
+
+void SalesBenchmark::initTestCase() {
+    QVERIFY(dir.isValid());
+    db = BenchFixture::openDatabase("sales", dir.filePath("sales.db"));
+    QVERIFY(db.isOpen());
+
+    const int sales = kSalesPerDay * kDays;
+    VendingSnapshot seed = BenchFixture::boxes(sales);
+    for (int i = 0; i < kItems; ++i) {
+        seed.items.append({QString("item%1").arg(i), 10 + i, sales});
+    }
+
+    // A year of sales, skewed towards the low-numbered items
+    SqliteVendingStore store(db);
+    QVERIFY(store.saveCheckpoint(seed));
+    QVERIFY(store.beginBatch());
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 start = now - qint64(kDays) * 24 * 3600 * 1000;
+    qint64 step = (now - start) / sales;
+    for (int i = 0; i < sales; ++i) {
+        int item = (i * i) % kItems * (i % 3) / 2;
+        SaleRecord sale;
+        sale.itemName = QString("item%1").arg(item);
+        sale.price = 10 + item;
+        sale.payment = {{100, 1}};
+        sale.soldAt = start + i * step;
+        QVERIFY(store.commitPurchase(sale));
+    }
+    QVERIFY(store.flush());
+
+    fromDay = SalesAnalytics::dayBucket(start);
+    toDay = SalesAnalytics::dayBucket(now);
+}
+
+void SalesBenchmark::cleanupTestCase() {
+    BenchFixture::closeDatabase(db);
+}
+
+void SalesBenchmark::rollupsMatchSales() {
+    SalesAnalytics analytics(db);
+    QVector<SalesTotal> totals;
+    QVERIFY(analytics.topSellers(fromDay, toDay, kItems, totals));
+
+    QSqlQuery query(db);
+    QVERIFY(query.exec("SELECT item_name, SUM(quantity), SUM(price * quantity) FROM sales_67011755 "
+                       "GROUP BY item_name ORDER BY 2 DESC, 3 DESC"));
+    for (const SalesTotal &total : totals) {
+        QVERIFY(query.next());
+        QCOMPARE(total.itemName, query.value(0).toString());
+        QCOMPARE(total.units, query.value(1).toLongLong());
+        QCOMPARE(total.revenue, query.value(2).toLongLong());
+    }
+    QVERIFY(!query.next());
+
+    QVector<SalesTotal> days;
+    QVERIFY(analytics.revenueByDay(fromDay, toDay, days));
+    qint64 units = 0;
+    for (const SalesTotal &day : days) {
+        units += day.units;
+    }
+    QCOMPARE(units, qint64(kSalesPerDay) * kDays);
+}
+
+void SalesBenchmark::topSellersYear() {
+    SalesAnalytics analytics(db);
+    QVector<SalesTotal> totals;
+    QBENCHMARK {
+        QVERIFY(analytics.topSellers(fromDay, toDay, 10, totals));
+    }
+    QCOMPARE(totals.size(), 10);
+}
+
+void SalesBenchmark::topSellersYearFromSales() {
+    // The scan the rollups avoid, for comparison
+    QSqlQuery query(db);
+    QBENCHMARK {
+        QVERIFY(query.exec("SELECT item_name, SUM(quantity), SUM(price * quantity) FROM sales_67011755 "
+                           "GROUP BY item_name ORDER BY 2 DESC, 3 DESC LIMIT 10"));
+        while (query.next()) {
+        }
+    }
+}
+
+void SalesBenchmark::revenueByDayYear() {
+    SalesAnalytics analytics(db);
+    QVector<SalesTotal> totals;
+    QBENCHMARK {
+        QVERIFY(analytics.revenueByDay(fromDay, toDay, totals));
+    }
+    QVERIFY(totals.size() >= kDays);
+}
+
+void SalesBenchmark::revenueByHourDay() {
+    SalesAnalytics analytics(db);
+    QVector<SalesTotal> totals;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QBENCHMARK {
+        QVERIFY(analytics.revenueByHour(now - 24 * 3600 * 1000, now, totals));
+    }
+    QVERIFY(!totals.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(SalesBenchmark)
+
+#include "tst_salesbench.moc"
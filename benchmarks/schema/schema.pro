@@ -0,0 +1,17 @@
+QT       += core sql testlib
+QT       -= gui
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = bench_schema
+
+INCLUDEPATH += ../..
+
+include(../common/common.pri)
+
+SOURCES += \
+    tst_schemabench.cpp
+
+HEADERS += \
+    ../../database.h
@@ -0,0 +1,144 @@
+// tst_schemabench.cpp
+// Item lookup cost on the unversioned schema (v1, full table scan) against
+// the keyed schema (v2, unique index) at 10k and 100k items.
+#include <QtTest>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QRandomGenerator>
+#include "database.h"
+
+class SchemaBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void lookupItem_data();
+    void lookupItem();
+    void updateDenomination_data();
+    void updateDenomination();
+
+private:
+    QSqlDatabase database(int version, int items);
+    QStringList connections;
+};
+
+static QString connectionName(int version, int items) {
+    return QString("bench_v%1_%2").arg(version).arg(items);
+}
+
+static QString itemName(int i) {
+    return QString("item%1").arg(i);
+}
+
+void SchemaBenchmark::initTestCase() {
+    for (int version : {1, 2}) {
+        for (int items : {10000, 100000}) {
+            QVERIFY(database(version, items).isOpen());
+        }
+    }
+}
+
+void SchemaBenchmark::cleanupTestCase() {
+    for (const QString &name : connections) {
+        QSqlDatabase::database(name).close();
+    }
+    for (const QString &name : connections) {
+        QSqlDatabase::removeDatabase(name);
+    }
+}
+
+// Build an in-memory database at the given schema version, filling the
+// catalog while still on v1 so v2 exercises the real migration path
+QSqlDatabase SchemaBenchmark::database(int version, int items) {
+    QString name = connectionName(version, items);
+    if (QSqlDatabase::contains(name)) {
+        return QSqlDatabase::database(name);
+    }
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+    db.setDatabaseName(":memory:");
+    if (!db.open() || !Database::migrate(db, 1)) {
+        return db;
+    }
+    connections << name;
+
+    QVariantList names, prices, stocks;
+    for (int i = 0; i < items; ++i) {
+        names << itemName(i);
+        prices << 10 + i % 50;
+        stocks << i % 20;
+    }
+
+    db.transaction();
+    QSqlQuery insert(db);
+    insert.prepare("INSERT INTO stock_67011755 (item_name, price, stock) VALUES (?, ?, ?)");
+    insert.addBindValue(names);
+    insert.addBindValue(prices);
+    insert.addBindValue(stocks);
+    insert.execBatch();
+
+    QSqlQuery seed(db);
+    for (int denom : {20, 10, 5, 1}) {
+        seed.exec(QString("INSERT INTO change_box_67011755 (THB, Count) VALUES ('%1THB', 50)").arg(denom));
+    }
+    db.commit();
+
+    Database::migrate(db, version);
+    return db;
+}
+
+void SchemaBenchmark::lookupItem_data() {
+    QTest::addColumn<int>("version");
+    QTest::addColumn<int>("items");
+
+    QTest::newRow("v1/10k") << 1 << 10000;
+    QTest::newRow("v1/100k") << 1 << 100000;
+    QTest::newRow("v2/10k") << 2 << 10000;
+    QTest::newRow("v2/100k") << 2 << 100000;
+}
+
+void SchemaBenchmark::lookupItem() {
+    QFETCH(int, version);
+    QFETCH(int, items);
+
+    QSqlDatabase db = database(version, items);
+    QCOMPARE(Database::schemaVersion(db), version);
+
+    QSqlQuery query(db);
+    query.prepare("SELECT price, stock FROM stock_67011755 WHERE item_name = ?");
+    QRandomGenerator random(42);
+
+    QBENCHMARK {
+        query.addBindValue(itemName(random.bounded(items)));
+        query.exec();
+        query.next();
+    }
+    QVERIFY(query.isActive());
+}
+
+void SchemaBenchmark::updateDenomination_data() {
+    QTest::addColumn<int>("version");
+
+    QTest::newRow("v1") << 1;
+    QTest::newRow("v2") << 2;
+}
+
+void SchemaBenchmark::updateDenomination() {
+    QFETCH(int, version);
+
+    QSqlDatabase db = database(version, 10000);
+    QSqlQuery query(db);
+    query.prepare("UPDATE change_box_67011755 SET Count = Count + 0 WHERE THB = ?");
+    QVariant key = version == 1 ? QVariant(QString("5THB")) : QVariant(5);
+
+    QBENCHMARK {
+        query.addBindValue(key);
+        query.exec();
+    }
+    QCOMPARE(query.numRowsAffected(), 1);
+}
+
+QTEST_GUILESS_MAIN(SchemaBenchmark)
+
+#include "tst_schemabench.moc"
@@ -0,0 +1,104 @@
+// tst_startupbench.cpp
+// What main() does before the window appears: Database::initialize on a new
+// and on an up-to-date database file, and seeding the change and collection
+// boxes.
+#include <QtTest>
+#include <QDir>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTemporaryDir>
+#include "database.h"
+
+class StartupBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void initializeNewDatabase();
+    void initializeExistingDatabase();
+    void seedBoxes_data();
+    void seedBoxes();
+
+private:
+    static void removeDatabaseFiles();
+    static void closeDefaultConnection();
+    QTemporaryDir dir;
+};
+
+void StartupBenchmark::initTestCase() {
+    // Database::initialize opens its file relative to the working directory
+    QVERIFY(dir.isValid());
+    QVERIFY(QDir::setCurrent(dir.path()));
+}
+
+void StartupBenchmark::cleanup() {
+    closeDefaultConnection();
+}
+
+void StartupBenchmark::removeDatabaseFiles() {
+    for (const char *suffix : {"", "-wal", "-shm"}) {
+        QFile::remove(Database::path() + suffix);
+    }
+}
+
+void StartupBenchmark::closeDefaultConnection() {
+    {
+        QSqlDatabase db = QSqlDatabase::database(QSqlDatabase::defaultConnection, false);
+        if (db.isOpen()) {
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(QSqlDatabase::defaultConnection);
+}
+
+void StartupBenchmark::initializeNewDatabase() {
+    // First boot: every migration runs
+    removeDatabaseFiles();
+    QBENCHMARK_ONCE {
+        QVERIFY(Database::initialize());
+    }
+    QCOMPARE(Database::schemaVersion(), Database::latestSchemaVersion());
+}
+
+void StartupBenchmark::initializeExistingDatabase() {
+    // Every later boot: the schema is already current
+    QVERIFY(Database::initialize());
+    closeDefaultConnection();
+
+    QBENCHMARK {
+        QVERIFY(Database::initialize());
+        closeDefaultConnection();
+    }
+}
+
+void StartupBenchmark::seedBoxes_data() {
+    QTest::addColumn<bool>("seeded");
+    QTest::newRow("first run") << false;
+    QTest::newRow("already seeded") << true;
+}
+
+void StartupBenchmark::seedBoxes() {
+    QFETCH(bool, seeded);
+
+    removeDatabaseFiles();
+    QVERIFY(Database::initialize());
+    if (seeded) {
+        QVERIFY(Database::seedBoxes());
+        QBENCHMARK {
+            QVERIFY(Database::seedBoxes());
+        }
+    } else {
+        QBENCHMARK_ONCE {
+            QVERIFY(Database::seedBoxes());
+        }
+    }
+
+    QSqlQuery query("SELECT COUNT(*) FROM change_box_67011755");
+    QVERIFY(query.next());
+    QCOMPARE(query.value(0).toInt(), 4);
+}
+
+QTEST_GUILESS_MAIN(StartupBenchmark)
+
+#include "tst_startupbench.moc"
@@ -0,0 +1,176 @@
+// tst_terminalsbench.cpp
+// Several terminals selling from one shared database, each on its own
+// thread and connection with its own engine. Stock and change are scarce
+// enough that terminals race for the last units and coins; no count may go
+// negative, every sale must be recorded exactly once, and throughput must
+// hold up as terminals are added.
+#include <QtTest>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSqlDatabase>
+#include <QTemporaryDir>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "benchfixture.h"
+#include "sqlitestore.h"
+
+class TerminalsBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void sharedDatabase_data();
+    void sharedDatabase();
+    void noJournalOverSharedTables();
+
+private:
+    static VendingSnapshot seed();
+    QTemporaryDir dir;
+    double singleTerminalRate = 0;
+};
+
+static const int kItems = 20;
+static const int kInitialStock = 100;
+static const int kInitialCoins = 150;
+static const int kAttempts = 4000; // shared by all terminals
+
+VendingSnapshot TerminalsBenchmark::seed() {
+    VendingSnapshot snapshot = BenchFixture::boxes(kInitialCoins);
+    for (int i = 0; i < kItems; ++i) {
+        snapshot.items.append({QString("item%1").arg(i), 5 + i * 4, kInitialStock});
+    }
+    return snapshot;
+}
+
+void TerminalsBenchmark::initTestCase() {
+    QVERIFY(dir.isValid());
+}
+
+void TerminalsBenchmark::sharedDatabase_data() {
+    QTest::addColumn<int>("terminals");
+    for (int terminals : {1, 2, 4, 8}) {
+        QTest::newRow(qPrintable(QString("%1 terminals").arg(terminals))) << terminals;
+    }
+}
+
+void TerminalsBenchmark::sharedDatabase() {
+    QFETCH(int, terminals);
+
+    QString path = dir.filePath(QString("shared_%1.db").arg(terminals));
+    QString checkName = QString("check_%1").arg(terminals);
+    {
+        QSqlDatabase db = BenchFixture::openDatabase(checkName, path);
+        QVERIFY(db.isOpen());
+        SqliteVendingStore seedStore(db);
+        QVERIFY(seedStore.saveCheckpoint(seed()));
+    }
+
+    std::atomic<int> sold(0);
+    std::atomic<int> refused(0);
+    std::atomic<int> failures(0);
+    QElapsedTimer clock;
+
+    QBENCHMARK_ONCE {
+        clock.start();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < terminals; ++t) {
+            threads.emplace_back([&, t]() {
+                QString name = QString("terminal_%1_%2").arg(terminals).arg(t);
+                {
+                    QSqlDatabase db = BenchFixture::openDatabase(name, path);
+                    if (!db.isOpen()) {
+                        failures++;
+                        return;
+                    }
+                    SqliteVendingStore store(db);
+                    store.setMultiTerminal(true);
+                    VendingEngine engine(&store);
+                    if (!engine.load()) {
+                        failures++;
+                        return;
+                    }
+
+                    // Pay with a note, so most sales also draw on the change box
+                    QRandomGenerator random(quint32(t + 1));
+                    for (int i = 0; i < kAttempts / terminals; ++i) {
+                        QString item = QString("item%1").arg(random.bounded(kItems));
+                        PurchaseResult result = engine.purchase(item, {{random.bounded(2) ? 100 : 20, 1}});
+                        if (result.status == PurchaseResult::Ok) {
+                            sold++;
+                        } else if (result.status == PurchaseResult::StorageError) {
+                            failures++;
+                        } else {
+                            refused++;
+                        }
+                    }
+                }
+                QSqlDatabase::removeDatabase(name);
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+    double rate = (sold + refused) * 1000.0 / qMax<qint64>(1, clock.elapsed());
+    qDebug("%d terminals: %d sold, %d refused, %d failed, %.0f attempts/s",
+           terminals, sold.load(), refused.load(), failures.load(), rate);
+
+    {
+        QSqlDatabase db = QSqlDatabase::database(checkName);
+
+        // Nothing oversold and no coin paid out twice
+        QVERIFY(BenchFixture::queryValue("SELECT MIN(stock) FROM stock_67011755", db) >= 0);
+        QVERIFY(BenchFixture::queryValue("SELECT MIN(Count) FROM change_box_67011755", db) >= 0);
+
+        // Every committed sale took exactly one unit and is in the history
+        qint64 remaining = BenchFixture::queryValue("SELECT SUM(stock) FROM stock_67011755", db);
+        QCOMPARE(qint64(kItems) * kInitialStock - remaining, qint64(sold.load()));
+        QCOMPARE(BenchFixture::queryValue("SELECT SUM(quantity) FROM sales_67011755", db), qint64(sold.load()));
+
+        // Money in less change out is the revenue of those sales
+        qint64 collected = BenchFixture::queryValue("SELECT SUM(THB * Count) FROM collection_box_67011755", db);
+        qint64 changeLeft = BenchFixture::queryValue("SELECT SUM(THB * Count) FROM change_box_67011755", db);
+        qint64 changeStart = 0;
+        for (int denom : VendingEngine::changeDenominations()) {
+            changeStart += qint64(denom) * kInitialCoins;
+        }
+        QCOMPARE(collected - (changeStart - changeLeft),
+                 BenchFixture::queryValue("SELECT SUM(price * quantity) FROM sales_67011755", db));
+    }
+    QSqlDatabase::removeDatabase(checkName);
+
+    // Retries after lost races must stay rare enough to never run out
+    QCOMPARE(failures.load(), 0);
+
+    // Writers serialise on the database, so more terminals cannot add
+    // throughput, but contention must not make it collapse either
+    if (terminals == 1) {
+        singleTerminalRate = rate;
+    } else if (singleTerminalRate > 0) {
+        QVERIFY2(rate >= singleTerminalRate / 4,
+                 qPrintable(QString("%1 attempts/s against %2 for one terminal").arg(rate).arg(singleTerminalRate)));
+    }
+}
+
+// Other terminals' sales never reach this terminal's journal
+void TerminalsBenchmark::noJournalOverSharedTables() {
+    QSqlDatabase db = BenchFixture::openDatabase("journaled", dir.filePath("journaled.db"));
+    QVERIFY(db.isOpen());
+    {
+        SqliteVendingStore store(db);
+        VendingEngine engine(&store);
+        TransactionJournal journal;
+        QVERIFY(journal.open(dir.filePath("journaled.journal")));
+
+        store.setMultiTerminal(true);
+        QVERIFY(!engine.setJournal(&journal));
+        store.setMultiTerminal(false);
+        QVERIFY(engine.setJournal(&journal));
+    }
+    BenchFixture::closeDatabase(db);
+}
+
+QTEST_GUILESS_MAIN(TerminalsBenchmark)
+
+#include "tst_terminalsbench.moc"
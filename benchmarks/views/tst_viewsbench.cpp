@@ -0,0 +1,135 @@
+// tst_viewsbench.cpp
+// Work the GUI thread does around a sale: repopulating the stock views at
+// several catalog sizes, updating one row after a change, the purchase
+// itself including change-making, and the operating check. Needs a
+// platform plugin; run with QT_QPA_PLATFORM=offscreen on a headless box.
+#include <QtTest>
+#include <QTableView>
+#include "benchfixture.h"
+#include "vendingengine.h"
+#include "vendingmodels.h"
+
+class ViewsBenchmark : public QObject {
+    Q_OBJECT
+
+private slots:
+    void modelReset_data();
+    void modelReset();
+    void rowUpdate_data();
+    void rowUpdate();
+    void purchaseWithChange_data();
+    void purchaseWithChange();
+    void operatingCheck();
+
+private:
+    static VendingSnapshot catalog(int items);
+    static void addSizes();
+};
+
+VendingSnapshot ViewsBenchmark::catalog(int items) {
+    VendingSnapshot snapshot = BenchFixture::boxes(1000000);
+    snapshot.items.reserve(items);
+    for (int i = 0; i < items; ++i) {
+        // Every tenth item is sold out, so the customer view filters rows
+        snapshot.items.append({QString("item%1").arg(i), 5 + i % 95, i % 10 == 0 ? 0 : 1000000});
+    }
+    return snapshot;
+}
+
+void ViewsBenchmark::addSizes() {
+    QTest::addColumn<int>("items");
+    QTest::addColumn<bool>("availableOnly");
+    for (int items : {100, 1000, 10000, 100000}) {
+        QTest::newRow(qPrintable(QString("admin %1").arg(items))) << items << false;
+        QTest::newRow(qPrintable(QString("customer %1").arg(items))) << items << true;
+    }
+}
+
+void ViewsBenchmark::modelReset_data() {
+    addSizes();
+}
+
+void ViewsBenchmark::modelReset() {
+    QFETCH(int, items);
+    QFETCH(bool, availableOnly);
+
+    MemoryVendingStore store(catalog(items));
+    VendingEngine engine(&store);
+    StockTableModel model(&engine, availableOnly);
+    QTableView view;
+    view.setModel(&model);
+    view.resize(800, 600);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+
+    // A full reload and repaint, as after an import or at startup
+    QBENCHMARK {
+        QVERIFY(engine.load());
+        view.viewport()->repaint();
+    }
+    QVERIFY(model.rowCount() > 0);
+}
+
+void ViewsBenchmark::rowUpdate_data() {
+    addSizes();
+}
+
+void ViewsBenchmark::rowUpdate() {
+    QFETCH(int, items);
+    QFETCH(bool, availableOnly);
+
+    MemoryVendingStore store(catalog(items));
+    VendingEngine engine(&store);
+    StockTableModel model(&engine, availableOnly);
+    QTableView view;
+    view.setModel(&model);
+    view.resize(800, 600);
+    view.show();
+    QVERIFY(QTest::qWaitForWindowExposed(&view));
+    QVERIFY(engine.load());
+
+    // One restock touches one row whatever the catalog size
+    QString item = QString("item%1").arg(items / 2 + 1);
+    QBENCHMARK {
+        QVERIFY(engine.restockItem(item, 1));
+        view.viewport()->repaint();
+    }
+}
+
+void ViewsBenchmark::purchaseWithChange_data() {
+    QTest::addColumn<int>("note");
+    QTest::newRow("exact") << 0;
+    QTest::newRow("20THB") << 20;
+    QTest::newRow("100THB") << 100;
+}
+
+void ViewsBenchmark::purchaseWithChange() {
+    QFETCH(int, note);
+
+    MemoryVendingStore store(catalog(100));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    // item7 costs 12
+    CoinCounts payment = note == 0 ? CoinCounts{{10, 1}, {1, 2}} : CoinCounts{{note, 1}};
+    QBENCHMARK {
+        PurchaseResult result = engine.purchase("item7", payment);
+        QCOMPARE(result.status, PurchaseResult::Ok);
+    }
+}
+
+void ViewsBenchmark::operatingCheck() {
+    MemoryVendingStore store(catalog(100000));
+    VendingEngine engine(&store);
+    QVERIFY(engine.load());
+
+    bool operational = false;
+    QBENCHMARK {
+        operational = engine.isOperational();
+    }
+    QVERIFY(operational);
+}
+
+QTEST_MAIN(ViewsBenchmark)
+
+#include "tst_viewsbench.moc"
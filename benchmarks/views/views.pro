@@ -0,0 +1,16 @@
+QT       += core gui widgets sql testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = bench_views
+
+include(../../vending_engine.pri)
+include(../common/common.pri)
+
+SOURCES += \
+    ../../vendingmodels.cpp \
+    tst_viewsbench.cpp
+
+HEADERS += \
+    ../../vendingmodels.h
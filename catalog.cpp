@@ -0,0 +1,117 @@
+// catalog.cpp
+#include "catalog.h"
+
+StockItem Catalog::item(int row) const {
+    StockItem item;
+    item.name = names.at(row);
+    item.price = prices.at(row);
+    item.stock = stocks.at(row);
+    return item;
+}
+
+int Catalog::find(const QString &name) const {
+    if (buckets.isEmpty()) {
+        return -1;
+    }
+    const uint hash = hashOf(name);
+    const int mask = buckets.size() - 1;
+    for (int slot = int(hash & uint(mask));; slot = (slot + 1) & mask) {
+        int entry = buckets.at(slot);
+        if (entry == 0) {
+            return -1;
+        }
+        int row = entry - 1;
+        if (hashes.at(row) == hash && names.at(row) == name) {
+            return row;
+        }
+    }
+}
+
+void Catalog::assign(const QVector<StockItem> &items) {
+    names.clear();
+    prices.clear();
+    stocks.clear();
+    hashes.clear();
+    names.reserve(items.size());
+    prices.reserve(items.size());
+    stocks.reserve(items.size());
+    hashes.reserve(items.size());
+    for (const StockItem &item : items) {
+        names.append(item.name);
+        prices.append(item.price);
+        stocks.append(item.stock);
+        hashes.append(hashOf(item.name));
+    }
+    rebuildIndex();
+}
+
+QVector<StockItem> Catalog::toItems() const {
+    QVector<StockItem> items;
+    items.reserve(size());
+    for (int row = 0; row < size(); ++row) {
+        items.append(item(row));
+    }
+    return items;
+}
+
+int Catalog::append(const QString &name, int price, int stock) {
+    names.append(name);
+    prices.append(price);
+    stocks.append(stock);
+    hashes.append(hashOf(name));
+
+    int row = size() - 1;
+    if (size() * 2 > buckets.size()) {
+        rebuildIndex();
+    } else {
+        insertIndex(row);
+    }
+    return row;
+}
+
+void Catalog::remove(int row) {
+    names.remove(row);
+    prices.remove(row);
+    stocks.remove(row);
+    hashes.remove(row);
+
+    // Every later row changed number; removals are rare admin actions
+    rebuildIndex();
+}
+
+void Catalog::rebuildIndex() {
+    int capacity = 16;
+    while (capacity < size() * 2) {
+        capacity *= 2;
+    }
+    buckets.fill(0, capacity);
+    for (int row = 0; row < size(); ++row) {
+        insertIndex(row);
+    }
+}
+
+void Catalog::insertIndex(int row) {
+    const uint hash = hashes.at(row);
+    const int mask = buckets.size() - 1;
+    for (int slot = int(hash & uint(mask));; slot = (slot + 1) & mask) {
+        int entry = buckets.at(slot);
+        if (entry == 0) {
+            buckets[slot] = row + 1;
+            return;
+        }
+        // Keep the first row if an old database holds duplicate names
+        if (hashes.at(entry - 1) == hash && names.at(entry - 1) == names.at(row)) {
+            return;
+        }
+    }
+}
+
+qint64 Catalog::memoryUsage() const {
+    qint64 bytes = qint64(names.capacity()) * sizeof(QString) + qint64(prices.capacity()) * sizeof(int)
+                   + qint64(stocks.capacity()) * sizeof(int) + qint64(hashes.capacity()) * sizeof(uint)
+                   + qint64(buckets.capacity()) * sizeof(int);
+    for (const QString &name : names) {
+        bytes += sizeof(QArrayData) + qint64(name.capacity() + 1) * sizeof(QChar);
+    }
+    return bytes;
+}
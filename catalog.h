@@ -0,0 +1,61 @@
+// catalog.h
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+struct StockItem {
+    QString name;
+    int price = 0;
+    int stock = 0;
+};
+
+// The engine's item table, stored column-wise: a sale or a status pass
+// reads the contiguous price or stock array and never touches the names.
+// Each name is held once and handed out by reference, so sale records and
+// journal events share it instead of carrying copies. Names are found
+// through an open-addressing index (linear probing, load at most 1/2) that
+// keeps each row's hash beside the row, so a probe compares strings only on
+// a hash match; a lookup allocates nothing.
+class Catalog {
+public:
+    int size() const { return names.size(); }
+    bool isEmpty() const { return names.isEmpty(); }
+
+    const QString &name(int row) const { return names.at(row); }
+    int price(int row) const { return prices.at(row); }
+    int stock(int row) const { return stocks.at(row); }
+    StockItem item(int row) const;
+
+    // Row of the first item with this name, or -1
+    int find(const QString &name) const;
+
+    // Replace the contents; an old database may hold duplicate names, of
+    // which find() returns the first
+    void assign(const QVector<StockItem> &items);
+    QVector<StockItem> toItems() const;
+
+    // Returns the new row, always the last
+    int append(const QString &name, int price, int stock);
+    // Later rows move up by one
+    void remove(int row);
+    void addStock(int row, int delta) { stocks[row] += delta; }
+
+    // Approximate heap bytes held, names included
+    qint64 memoryUsage() const;
+
+private:
+    static uint hashOf(const QString &name) { return uint(qHash(name)); }
+    void rebuildIndex();
+    void insertIndex(int row);
+
+    QVector<QString> names;
+    QVector<int> prices;
+    QVector<int> stocks;
+    QVector<uint> hashes;
+    QVector<int> buckets; // row + 1 per slot, 0 when free; size is a power of two
+};
+
+#endif // CATALOG_H
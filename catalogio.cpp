@@ -0,0 +1,348 @@
+// catalogio.cpp
+#include "catalogio.h"
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QStringList>
+#include <QTextStream>
+#include <climits>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = {'V', 'C', 'A', 'T'};
+const quint32 kBinaryVersion = 1;
+
+const char *kUpsert =
+    "INSERT INTO stock_67011755 (item_name, price, stock) VALUES (?, ?, ?) "
+    "ON CONFLICT(item_name) DO UPDATE SET price = excluded.price, stock = excluded.stock";
+
+void setUtf8(QTextStream &stream) {
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    stream.setCodec("UTF-8");
+#else
+    Q_UNUSED(stream);
+#endif
+}
+
+// Reads one CSV record at a time; a quoted field may span lines
+bool readCsvRecord(QTextStream &in, QStringList &fields) {
+    fields.clear();
+    if (in.atEnd()) {
+        return false;
+    }
+
+    QString line = in.readLine();
+    QString field;
+    bool quoted = false;
+    int i = 0;
+    for (;;) {
+        if (i >= line.size()) {
+            if (quoted && !in.atEnd()) {
+                field += '\n';
+                line = in.readLine();
+                i = 0;
+                continue;
+            }
+            break;
+        }
+
+        QChar c = line.at(i++);
+        if (quoted) {
+            if (c != '"') {
+                field += c;
+            } else if (i < line.size() && line.at(i) == '"') {
+                field += '"';
+                i++;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields << field;
+            field.clear();
+        } else {
+            field += c;
+        }
+    }
+    fields << field;
+    return true;
+}
+
+QString csvField(const QString &value) {
+    bool needsQuotes = value.trimmed() != value;
+    for (QChar c : value) {
+        needsQuotes = needsQuotes || c == ',' || c == '"' || c == '\r' || c == '\n';
+    }
+    if (!needsQuotes) {
+        return value;
+    }
+    QString escaped = value;
+    escaped.replace('"', "\"\"");
+    return '"' + escaped + '"';
+}
+}
+
+CatalogIO::Format CatalogIO::formatForPath(const QString &path) {
+    return QFileInfo(path).suffix().compare("vcat", Qt::CaseInsensitive) == 0 ? Binary : Csv;
+}
+
+CatalogIO::CatalogIO(const QSqlDatabase &db) : db(db) {
+}
+
+bool CatalogIO::execStatement(const QString &sql) {
+    QSqlQuery query(db);
+    if (!query.exec(sql)) {
+        errorText = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool CatalogIO::importFile(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorText = file.errorString();
+        return false;
+    }
+    return importDevice(&file, formatForPath(path));
+}
+
+bool CatalogIO::importDevice(QIODevice *device, Format format) {
+    imported = 0;
+    rejected = 0;
+    errors.clear();
+    names.clear();
+    prices.clear();
+    stocks.clear();
+    batchRows.clear();
+
+    QSqlQuery query(db);
+    if (!query.prepare(kUpsert)) {
+        errorText = query.lastError().text();
+        return false;
+    }
+    upsertQuery = &query;
+
+    // A savepoint opens a transaction of its own when none is active
+    if (!execStatement("SAVEPOINT catalog_import")) {
+        return false;
+    }
+
+    bool ok = (format == Binary ? importBinary(device) : importCsv(device)) && flushBatch();
+    upsertQuery = nullptr;
+    if (!ok) {
+        QString failure = errorText;
+        execStatement("ROLLBACK TO catalog_import");
+        execStatement("RELEASE catalog_import");
+        errorText = failure;
+        imported = 0;
+        return false;
+    }
+    return execStatement("RELEASE catalog_import");
+}
+
+bool CatalogIO::importCsv(QIODevice *device) {
+    QTextStream in(device);
+    setUtf8(in);
+
+    QStringList fields;
+    qint64 row = 0;
+    while (readCsvRecord(in, fields)) {
+        row++;
+        if (fields.size() == 1 && fields.first().trimmed().isEmpty()) {
+            continue;
+        }
+        if (row == 1 && fields.first().trimmed().compare("item_name", Qt::CaseInsensitive) == 0) {
+            continue;
+        }
+        if (fields.size() != 3) {
+            rejectRow(row, QString("Expected 3 fields, found %1").arg(fields.size()));
+            continue;
+        }
+
+        bool priceOk, stockOk;
+        qint64 price = fields.at(1).trimmed().toLongLong(&priceOk);
+        qint64 stock = fields.at(2).trimmed().toLongLong(&stockOk);
+        if (!priceOk || !stockOk) {
+            rejectRow(row, "Price and stock must be whole numbers");
+            continue;
+        }
+        if (!addRow(row, fields.at(0).trimmed(), price, stock)) {
+            return false;
+        }
+    }
+
+    if (in.status() != QTextStream::Ok) {
+        errorText = "Failed to read catalog";
+        return false;
+    }
+    return true;
+}
+
+bool CatalogIO::importBinary(QIODevice *device) {
+    QDataStream in(device);
+    in.setByteOrder(QDataStream::LittleEndian);
+
+    char magic[sizeof(kMagic)];
+    quint32 version = 0;
+    if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic))
+        || memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        errorText = "Not a binary catalog";
+        return false;
+    }
+    in >> version;
+    if (version != kBinaryVersion) {
+        errorText = QString("Unsupported catalog version %1").arg(version);
+        return false;
+    }
+
+    QByteArray name;
+    qint64 row = 0;
+    while (!in.atEnd()) {
+        row++;
+        quint16 nameLength;
+        qint32 price, stock;
+        in >> nameLength;
+        name.resize(nameLength);
+        in.readRawData(name.data(), nameLength);
+        in >> price >> stock;
+
+        // A truncated record ends the file; everything before it still counts
+        if (in.status() != QDataStream::Ok) {
+            rejectRow(row, "Truncated record");
+            break;
+        }
+        if (!addRow(row, QString::fromUtf8(name).trimmed(), price, stock)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CatalogIO::addRow(qint64 row, const QString &name, qint64 price, qint64 stock) {
+    if (name.isEmpty()) {
+        rejectRow(row, "Item name is empty");
+        return true;
+    }
+    if (price <= 0 || price > INT_MAX) {
+        rejectRow(row, "Price must be a positive amount");
+        return true;
+    }
+    if (stock < 0 || stock > INT_MAX) {
+        rejectRow(row, "Stock must not be negative");
+        return true;
+    }
+
+    names << name;
+    prices << int(price);
+    stocks << int(stock);
+    batchRows << row;
+    return names.size() < batchSize || flushBatch();
+}
+
+bool CatalogIO::flushBatch() {
+    if (names.isEmpty()) {
+        return true;
+    }
+
+    if (!execStatement("SAVEPOINT catalog_batch")) {
+        return false;
+    }
+
+    upsertQuery->addBindValue(names);
+    upsertQuery->addBindValue(prices);
+    upsertQuery->addBindValue(stocks);
+    if (upsertQuery->execBatch()) {
+        imported += names.size();
+    } else {
+        // One bad row fails the whole batch; redo it row by row to find it
+        if (!execStatement("ROLLBACK TO catalog_batch")) {
+            return false;
+        }
+        for (int i = 0; i < names.size(); ++i) {
+            upsertQuery->addBindValue(names.at(i));
+            upsertQuery->addBindValue(prices.at(i));
+            upsertQuery->addBindValue(stocks.at(i));
+            if (upsertQuery->exec()) {
+                imported++;
+            } else {
+                rejectRow(batchRows.at(i), upsertQuery->lastError().text());
+            }
+        }
+    }
+
+    names.clear();
+    prices.clear();
+    stocks.clear();
+    batchRows.clear();
+    return execStatement("RELEASE catalog_batch");
+}
+
+void CatalogIO::rejectRow(qint64 row, const QString &message) {
+    rejected++;
+    if (errors.size() < kMaxReportedErrors) {
+        errors.append({row, message});
+    }
+}
+
+bool CatalogIO::exportFile(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorText = file.errorString();
+        return false;
+    }
+    return exportDevice(&file, formatForPath(path)) && file.flush();
+}
+
+bool CatalogIO::exportDevice(QIODevice *device, Format format) {
+    exported = 0;
+
+    // Stream rows straight from the cursor to the file
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT item_name, price, stock FROM stock_67011755 ORDER BY item_id")) {
+        errorText = query.lastError().text();
+        return false;
+    }
+
+    if (format == Binary) {
+        QDataStream out(device);
+        out.setByteOrder(QDataStream::LittleEndian);
+        out.writeRawData(kMagic, sizeof(kMagic));
+        out << kBinaryVersion;
+        while (query.next()) {
+            QByteArray name = query.value(0).toString().toUtf8();
+            if (name.size() > 0xFFFF) {
+                errorText = "Item name too long for a binary catalog";
+                return false;
+            }
+            out << quint16(name.size());
+            out.writeRawData(name.constData(), name.size());
+            out << qint32(query.value(1).toInt()) << qint32(query.value(2).toInt());
+            exported++;
+        }
+        if (out.status() != QDataStream::Ok) {
+            errorText = device->errorString();
+            return false;
+        }
+        return true;
+    }
+
+    QTextStream out(device);
+    setUtf8(out);
+    out << "item_name,price,stock\n";
+    while (query.next()) {
+        out << csvField(query.value(0).toString()) << ','
+            << query.value(1).toInt() << ','
+            << query.value(2).toInt() << '\n';
+        exported++;
+    }
+    out.flush();
+    if (out.status() != QTextStream::Ok) {
+        errorText = device->errorString();
+        return false;
+    }
+    return true;
+}
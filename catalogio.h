@@ -0,0 +1,86 @@
+// catalogio.h
+#ifndef CATALOGIO_H
+#define CATALOGIO_H
+
+#include <QIODevice>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QVariantList>
+#include <QVector>
+
+struct CatalogRowError {
+    qint64 row;       // 1-based record number in the file
+    QString message;
+};
+
+// Streaming bulk import and export of the stock table, for provisioning a
+// machine with a whole planogram at once.
+//
+// CSV files have an optional "item_name,price,stock" header and RFC 4180
+// quoting. Binary files (.vcat) are the "VCAT" magic and a u32 version, then
+// per item a u16 name length, the UTF-8 name, i32 price and i32 stock, all
+// little-endian.
+//
+// Import parses one record at a time and upserts by item name with batched
+// prepared statements, all inside one transaction (a savepoint, so it can also
+// run inside a batch the caller already has open). Invalid rows are skipped
+// and reported; only an unreadable file or a database failure aborts.
+class CatalogIO {
+public:
+    enum Format {
+        Csv,
+        Binary
+    };
+
+    // .vcat is binary, anything else is read as CSV
+    static Format formatForPath(const QString &path);
+
+    // The connection must be used on the thread that opened it
+    explicit CatalogIO(const QSqlDatabase &db = QSqlDatabase());
+    void setDatabase(const QSqlDatabase &db) { this->db = db; }
+
+    // Rows sent to the database per execBatch call
+    void setBatchSize(int rows) { batchSize = qMax(1, rows); }
+
+    bool importFile(const QString &path);
+    bool importDevice(QIODevice *device, Format format);
+    bool exportFile(const QString &path);
+    bool exportDevice(QIODevice *device, Format format);
+
+    qint64 rowsImported() const { return imported; }
+    qint64 rowsExported() const { return exported; }
+
+    // The first kMaxReportedErrors rejected rows; rejectedRows() counts all
+    static const int kMaxReportedErrors = 1000;
+    const QVector<CatalogRowError> &rowErrors() const { return errors; }
+    qint64 rejectedRows() const { return rejected; }
+
+    QString lastError() const { return errorText; }
+
+private:
+    bool importCsv(QIODevice *device);
+    bool importBinary(QIODevice *device);
+    bool addRow(qint64 row, const QString &name, qint64 price, qint64 stock);
+    bool flushBatch();
+    void rejectRow(qint64 row, const QString &message);
+    bool execStatement(const QString &sql);
+
+    QSqlDatabase db;
+    QSqlQuery *upsertQuery = nullptr; // prepared for the current import
+    int batchSize = 5000;
+
+    // Columns of the batch being collected
+    QVariantList names;
+    QVariantList prices;
+    QVariantList stocks;
+    QVector<qint64> batchRows;
+
+    qint64 imported = 0;
+    qint64 exported = 0;
+    qint64 rejected = 0;
+    QVector<CatalogRowError> errors;
+    QString errorText;
+};
+
+#endif // CATALOGIO_H
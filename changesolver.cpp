@@ -0,0 +1,191 @@
+// changesolver.cpp
+#include "changesolver.h"
+#include <limits>
+
+namespace {
+const int kMaxCachedStates = 4096;
+const int kScarcityPenalty = 4;
+const int kUnreachable = std::numeric_limits<int>::max();
+// Tables hold per-denomination counts as quint16
+const int kMaxCoinsPerDenomination = std::numeric_limits<quint16>::max();
+}
+
+ChangeSolver::ChangeSolver(const QVector<int> &denominations, int maxAmount)
+    : denominations(denominations), limit(maxAmount), scratchKey(denominations.size()) {
+}
+
+void ChangeSolver::setPolicy(Policy policy) {
+    if (policy != currentPolicy) {
+        currentPolicy = policy;
+        clearCache();
+    }
+}
+
+void ChangeSolver::setLowStockThreshold(int count) {
+    if (count != threshold) {
+        threshold = qMax(0, count);
+        clearCache();
+    }
+}
+
+void ChangeSolver::clearCache() {
+    cache.clear();
+    lastKey.clear();
+    lastTable = nullptr;
+}
+
+int ChangeSolver::coinWeight(int count) const {
+    if (currentPolicy == FewestCoins) {
+        return 1;
+    }
+    // Every coin costs 1, plus a penalty that grows as its box runs low
+    return 1 + kScarcityPenalty * qMax(0, threshold - count);
+}
+
+bool ChangeSolver::canMake(const CoinCounts &available, int amount) {
+    if (amount < 0) {
+        return false;
+    }
+    if (amount > limit) {
+        CoinCounts change;
+        return solve(available, amount, change);
+    }
+    return table(available).cost.at(amount) >= 0;
+}
+
+bool ChangeSolver::solve(const CoinCounts &available, int amount, CoinCounts &change) {
+    change.clear();
+    if (amount < 0) {
+        return false;
+    }
+
+    // More than the whole box is worth can never be made, however large
+    const int denomCount = denominations.size();
+    qint64 boxValue = 0;
+    for (int i = 0; i < denomCount; ++i) {
+        boxValue += qint64(denominations[i]) * qMax(0, available.value(denominations[i]));
+    }
+    if (amount > boxValue) {
+        return false;
+    }
+
+    const Table *result;
+    Table uncached;
+    if (amount <= limit) {
+        result = &table(available);
+    } else {
+        // Larger than any single note can produce; solve once, uncached
+        QVector<int> counts(denomCount);
+        for (int i = 0; i < denomCount; ++i) {
+            counts[i] = qBound(0, available.value(denominations[i]),
+                               qMin(amount / denominations[i], kMaxCoinsPerDenomination));
+        }
+        uncached = buildTable(counts, amount);
+        result = &uncached;
+    }
+
+    if (result->cost.at(amount) < 0) {
+        return false;
+    }
+
+    const quint16 *coins = result->coins.constData() + size_t(amount) * denomCount;
+    for (int i = 0; i < denomCount; ++i) {
+        if (coins[i] > 0) {
+            change.insert(denominations[i], coins[i]);
+        }
+    }
+    return true;
+}
+
+const ChangeSolver::Table &ChangeSolver::table(const CoinCounts &available) {
+    // Clamp each count to what can matter: never more coins than fit in the
+    // largest amount, and never beyond the point where the weight stops
+    // changing
+    for (int i = 0; i < denominations.size(); ++i) {
+        int usable = limit / denominations[i];
+        if (currentPolicy == PreserveLowStock) {
+            usable = qMax(usable, threshold);
+        }
+        scratchKey[i] = qBound(0, available.value(denominations[i]), qMin(usable, kMaxCoinsPerDenomination));
+    }
+
+    if (lastTable && scratchKey == lastKey) {
+        return *lastTable;
+    }
+
+    auto it = cache.find(scratchKey);
+    if (it == cache.end()) {
+        if (cache.size() >= kMaxCachedStates) {
+            cache.clear();
+        }
+        it = cache.insert(scratchKey, buildTable(scratchKey, limit));
+    }
+
+    // Inserting may move values, so the fast-path pointer is refreshed here
+    lastKey = scratchKey;
+    lastTable = &it.value();
+    return *lastTable;
+}
+
+ChangeSolver::Table ChangeSolver::buildTable(const QVector<int> &counts, int amountLimit) const {
+    const int denomCount = denominations.size();
+    const int width = amountLimit + 1;
+
+    // Binary splitting turns each bounded denomination into O(log count)
+    // 0/1 items of 1, 2, 4, ... coins
+    struct Chunk {
+        int denomIndex;
+        int coins;
+    };
+    QVector<Chunk> chunks;
+    for (int i = 0; i < denomCount; ++i) {
+        int remaining = counts.at(i);
+        for (int size = 1; remaining > 0; size *= 2) {
+            int take = qMin(size, remaining);
+            chunks.append({i, take});
+            remaining -= take;
+        }
+    }
+
+    QVector<int> best(width, kUnreachable);
+    QVector<char> took(chunks.size() * width, 0);
+    best[0] = 0;
+
+    for (int c = 0; c < chunks.size(); ++c) {
+        const Chunk &chunk = chunks.at(c);
+        int value = chunk.coins * denominations.at(chunk.denomIndex);
+        int cost = chunk.coins * coinWeight(counts.at(chunk.denomIndex));
+        char *chunkTook = took.data() + size_t(c) * width;
+
+        for (int amount = amountLimit; amount >= value; --amount) {
+            int previous = best.at(amount - value);
+            if (previous != kUnreachable && previous + cost < best.at(amount)) {
+                best[amount] = previous + cost;
+                chunkTook[amount] = 1;
+            }
+        }
+    }
+
+    // Walk the chunks backwards to recover each amount's coin breakdown
+    Table result;
+    result.cost.resize(width);
+    result.coins.fill(0, width * denomCount);
+    for (int amount = 0; amount < width; ++amount) {
+        if (best.at(amount) == kUnreachable) {
+            result.cost[amount] = -1;
+            continue;
+        }
+
+        result.cost[amount] = best.at(amount);
+        quint16 *coins = result.coins.data() + size_t(amount) * denomCount;
+        int remaining = amount;
+        for (int c = chunks.size() - 1; c >= 0 && remaining > 0; --c) {
+            if (took.constData()[size_t(c) * width + remaining]) {
+                const Chunk &chunk = chunks.at(c);
+                coins[chunk.denomIndex] += chunk.coins;
+                remaining -= chunk.coins * denominations.at(chunk.denomIndex);
+            }
+        }
+    }
+    return result;
+}
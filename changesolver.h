@@ -0,0 +1,63 @@
+// changesolver.h
+#ifndef CHANGESOLVER_H
+#define CHANGESOLVER_H
+
+#include <QMap>
+#include <QHash>
+#include <QVector>
+
+// Denomination value (THB) -> number of coins/notes
+typedef QMap<int, int> CoinCounts;
+
+// Exact change-making over a bounded change box.
+//
+// Solutions come from a bounded-knapsack DP that covers every amount up to
+// maxAmount at once. The resulting table is memoised per box state, so after
+// the first solve for a given state every amount is an O(1) lookup. Counts
+// beyond what could ever be used are clamped before keying, which keeps a
+// well-stocked box on one cache entry across many sales.
+class ChangeSolver {
+public:
+    enum Policy {
+        FewestCoins,      // minimise the number of coins handed out
+        PreserveLowStock  // prefer plentiful denominations over scarce ones
+    };
+
+    ChangeSolver(const QVector<int> &denominations, int maxAmount);
+
+    void setPolicy(Policy policy);
+    Policy policy() const { return currentPolicy; }
+
+    // Denominations holding fewer coins than this are treated as scarce
+    void setLowStockThreshold(int count);
+    int lowStockThreshold() const { return threshold; }
+
+    bool solve(const CoinCounts &available, int amount, CoinCounts &change);
+    bool canMake(const CoinCounts &available, int amount);
+
+    int maxAmount() const { return limit; }
+    int cachedStates() const { return cache.size(); }
+    void clearCache();
+
+private:
+    struct Table {
+        QVector<int> cost;      // per amount, -1 if it cannot be made
+        QVector<quint16> coins; // per amount, one count per denomination
+    };
+
+    const Table &table(const CoinCounts &available);
+    Table buildTable(const QVector<int> &counts, int amountLimit) const;
+    int coinWeight(int count) const;
+
+    QVector<int> denominations;
+    int limit;
+    Policy currentPolicy = FewestCoins;
+    int threshold = 10;
+
+    QHash<QVector<int>, Table> cache;
+    QVector<int> scratchKey;
+    QVector<int> lastKey;
+    const Table *lastTable = nullptr;
+};
+
+#endif // CHANGESOLVER_H
@@ -0,0 +1,61 @@
+// coinsource.cpp
+#include "coinsource.h"
+#include <QLocalSocket>
+#include <QtEndian>
+#include <QDebug>
+
+LocalSocketCoinSource::LocalSocketCoinSource(QObject *parent) : CoinSource(parent) {
+    connect(&server, &QLocalServer::newConnection, this, &LocalSocketCoinSource::acceptClients);
+}
+
+bool LocalSocketCoinSource::listen(const QString &name) {
+    // A server left behind by a crashed instance would block the name
+    QLocalServer::removeServer(name);
+    return server.listen(name);
+}
+
+void LocalSocketCoinSource::acceptClients() {
+    while (QLocalSocket *socket = server.nextPendingConnection()) {
+        buffers.insert(socket, QByteArray());
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readFrames(socket); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void LocalSocketCoinSource::readFrames(QLocalSocket *socket) {
+    QByteArray &buffer = buffers[socket];
+    buffer.append(socket->readAll());
+
+    int offset = 0;
+    while (buffer.size() - offset >= kHeaderSize) {
+        const uchar *frame = reinterpret_cast<const uchar *>(buffer.constData()) + offset;
+        quint16 nameLength = qFromLittleEndian<quint16>(frame + 13);
+        if (buffer.size() - offset < kHeaderSize + nameLength) {
+            break;
+        }
+
+        qint64 sentAt = qFromLittleEndian<qint64>(frame + 1);
+        qint32 denomination = qFromLittleEndian<qint32>(frame + 9);
+        switch (frame[0]) {
+        case Coin:
+            emit coinInserted(denomination, sentAt);
+            break;
+        case Select:
+            emit itemSelected(QString::fromUtf8(reinterpret_cast<const char *>(frame + kHeaderSize), nameLength));
+            break;
+        case Cancel:
+            emit cancelRequested();
+            break;
+        default:
+            qWarning() << "Coin acceptor sent unknown frame type" << frame[0] << "; disconnecting";
+            buffer.clear();
+            socket->disconnectFromServer();
+            return;
+        }
+        offset += kHeaderSize + nameLength;
+    }
+    buffer.remove(0, offset);
+}
@@ -0,0 +1,56 @@
+// coinsource.h
+#ifndef COINSOURCE_H
+#define COINSOURCE_H
+
+#include <QHash>
+#include <QLocalServer>
+#include <QObject>
+
+class QLocalSocket;
+
+// Where coin and selection events come from. Connect one to a
+// PaymentSession with PaymentSession::insertCoin/select/cancel.
+class CoinSource : public QObject {
+    Q_OBJECT
+
+public:
+    using QObject::QObject;
+
+signals:
+    void coinInserted(int denomination, qint64 sentAtNsecs);
+    void itemSelected(const QString &itemName);
+    void cancelRequested();
+};
+
+// Coin acceptor attached over a local socket (a Unix domain socket or a
+// Windows named pipe), as a device driver or the coinsim tool would be.
+// Each client sends a stream of little-endian frames:
+//   u8 type (1 coin, 2 select, 3 cancel), i64 sent-at (steady clock ns),
+//   i32 denomination, u16 name length, name (UTF-8, select only)
+// Every frame already received is decoded in one pass, so a burst of
+// thousands of coins costs one wakeup.
+class LocalSocketCoinSource : public CoinSource {
+    Q_OBJECT
+
+public:
+    enum FrameType : quint8 {
+        Coin = 1,
+        Select = 2,
+        Cancel = 3
+    };
+    static const int kHeaderSize = 1 + 8 + 4 + 2;
+
+    explicit LocalSocketCoinSource(QObject *parent = nullptr);
+
+    bool listen(const QString &name);
+    QString errorString() const { return server.errorString(); }
+
+private:
+    void acceptClients();
+    void readFrames(QLocalSocket *socket);
+
+    QLocalServer server;
+    QHash<QLocalSocket *, QByteArray> buffers; // partial frames per client
+};
+
+#endif // COINSOURCE_H
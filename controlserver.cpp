@@ -0,0 +1,136 @@
+// controlserver.cpp
+#include "controlserver.h"
+#include "asyncstore.h"
+#include "metrics.h"
+#include <QLocalSocket>
+#include <QTcpSocket>
+#include <QtEndian>
+#include <QDebug>
+
+ControlServer::ControlServer(VendingEngine *engine, AsyncVendingStore *store, QObject *parent)
+    : QObject(parent), engine(engine), store(store) {
+    connect(&localServer, &QLocalServer::newConnection, this, [this]() {
+        while (QLocalSocket *socket = localServer.nextPendingConnection()) {
+            connect(socket, &QLocalSocket::disconnected, this, [this, socket]() { drop(socket); });
+            accept(socket);
+        }
+    });
+    connect(&tcpServer, &QTcpServer::newConnection, this, [this]() {
+        while (QTcpSocket *socket = tcpServer.nextPendingConnection()) {
+            // Responses are small and already coalesced per pass
+            socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+            connect(socket, &QTcpSocket::disconnected, this, [this, socket]() { drop(socket); });
+            accept(socket);
+        }
+    });
+}
+
+ControlServer::~ControlServer() {
+    // The sockets belong to the servers and close after this body runs;
+    // their disconnected() must not reach drop() on freed connections
+    for (auto it = connections.constBegin(); it != connections.constEnd(); ++it) {
+        it.key()->disconnect(this);
+    }
+    qDeleteAll(connections);
+    connections.clear();
+}
+
+bool ControlServer::listenLocal(const QString &name) {
+    // A server left behind by a crashed instance would block the name
+    QLocalServer::removeServer(name);
+    if (!localServer.listen(name)) {
+        errorText = localServer.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool ControlServer::listenTcp(quint16 port) {
+    // Loopback only: anything on the network must come through a local agent
+    if (!tcpServer.listen(QHostAddress::LocalHost, port)) {
+        errorText = tcpServer.errorString();
+        return false;
+    }
+    return true;
+}
+
+void ControlServer::accept(QIODevice *socket) {
+    connections.insert(socket, new Connection(engine));
+    connect(socket, &QIODevice::readyRead, this, [this, socket]() { readFrames(socket); });
+}
+
+void ControlServer::drop(QIODevice *socket) {
+    delete connections.take(socket);
+    socket->deleteLater();
+}
+
+void ControlServer::readFrames(QIODevice *socket) {
+    static LatencyHistogram *const latency = Metrics::latency("control_pass");
+    static Counter *const requests =
+        Metrics::counter("vending_control_requests", "Requests answered by the control server.");
+    Connection *connection = connections.value(socket);
+    if (!connection || connection->closing) {
+        socket->readAll();
+        return;
+    }
+    ScopedTimer timer(latency);
+
+    QByteArray &buffer = connection->buffer;
+    buffer.append(socket->readAll());
+
+    // The writes of every request in this pass go to the storage thread as
+    // one batch
+    if (store) {
+        store->holdWrites();
+    }
+    QByteArray responses;
+    QByteArray text;
+    int offset = 0;
+    bool &closing = connection->closing;
+    while (!closing && buffer.size() - offset >= kHeaderSize) {
+        const uchar *frame = reinterpret_cast<const uchar *>(buffer.constData()) + offset;
+        quint32 length = qFromLittleEndian<quint32>(frame);
+        if (length < 4 || length > quint32(kMaxFrameSize)) {
+            qWarning() << "Control client sent a frame of" << length << "bytes; disconnecting";
+            closing = true;
+            break;
+        }
+        if (quint32(buffer.size() - offset) < 4 + length) {
+            break;
+        }
+
+        quint32 id = qFromLittleEndian<quint32>(frame + 4);
+        text.clear();
+        connection->controller.execute(
+            QString::fromUtf8(reinterpret_cast<const char *>(frame + kHeaderSize), int(length) - 4), text);
+        if (text.endsWith('\n')) {
+            text.chop(1);
+        }
+
+        uchar header[kHeaderSize];
+        qToLittleEndian<quint32>(quint32(4 + text.size()), header);
+        qToLittleEndian<quint32>(id, header + 4);
+        responses.append(reinterpret_cast<const char *>(header), kHeaderSize);
+        responses.append(text);
+        requests->increment();
+        offset += 4 + int(length);
+        closing = connection->controller.quitRequested();
+    }
+    buffer.remove(0, offset);
+    if (store) {
+        store->releaseWrites();
+    }
+
+    if (!responses.isEmpty()) {
+        socket->write(responses);
+    }
+    // Answered up to a quit (or garbage); the rest is not read
+    if (closing) {
+        buffer.clear();
+        if (QLocalSocket *local = qobject_cast<QLocalSocket *>(socket)) {
+            local->disconnectFromServer();
+        } else if (QTcpSocket *tcp = qobject_cast<QTcpSocket *>(socket)) {
+            tcp->disconnectFromHost();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+// controlserver.h
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <QHash>
+#include <QLocalServer>
+#include <QObject>
+#include <QTcpServer>
+#include "headlesscontroller.h"
+
+class AsyncVendingStore;
+class QIODevice;
+
+// Programmatic access to a running machine for fleet managers and kiosk
+// software: the headless command set (status, items, buy, restock, refill,
+// collect) over a local socket and/or a TCP port bound to localhost only.
+//
+// Requests and responses are little-endian frames:
+//   u32 length of what follows, u32 request id, UTF-8 command or response
+// A response carries its request's id and is the text the headless mode
+// would print, without the final newline. Clients may pipeline any number of
+// requests. Every frame already received is answered in one pass and one
+// write, and when a store is given, the writes of that pass are committed
+// together.
+class ControlServer : public QObject {
+    Q_OBJECT
+
+public:
+    static const int kHeaderSize = 4 + 4;
+    static const int kMaxFrameSize = 64 * 1024; // larger is treated as garbage
+
+    ControlServer(VendingEngine *engine, AsyncVendingStore *store, QObject *parent = nullptr);
+    ~ControlServer() override;
+
+    bool listenLocal(const QString &name);
+    bool listenTcp(quint16 port);
+    QString errorString() const { return errorText; }
+
+private:
+    struct Connection {
+        explicit Connection(VendingEngine *engine) : controller(engine) {}
+        QByteArray buffer; // partial frames
+        HeadlessController controller;
+        bool closing = false; // after quit or a malformed frame
+    };
+
+    void accept(QIODevice *socket);
+    void readFrames(QIODevice *socket);
+    void drop(QIODevice *socket);
+
+    VendingEngine *engine;
+    AsyncVendingStore *store;
+    QLocalServer localServer;
+    QTcpServer tcpServer;
+    QHash<QIODevice *, Connection *> connections;
+    QString errorText;
+};
+
+#endif // CONTROLSERVER_H
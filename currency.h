@@ -0,0 +1,80 @@
+// currency.h
+#ifndef CURRENCY_H
+#define CURRENCY_H
+
+#include <QString>
+#include <QVector>
+
+// A fixed list of denomination values, largest first, usable in constant
+// expressions so checks like contains() cost no allocation or lookup.
+template <int... Values>
+struct DenominationList {
+    static constexpr int count = sizeof...(Values);
+    static constexpr int values[count] = {Values...};
+
+    static constexpr bool contains(int value) { return ((value == Values) || ...); }
+    static constexpr int largest() { return values[0]; }
+
+    static constexpr bool descending() {
+        for (int i = 1; i < count; ++i) {
+            if (values[i - 1] <= values[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static QVector<int> toVector() { return {Values...}; }
+};
+
+template <typename Subset, typename Set>
+constexpr bool isSubset() {
+    for (int value : Subset::values) {
+        if (!Set::contains(value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compile-time descriptor of the currency a machine is built for. The
+// engine, the schema seeding and the UI all read it through Currency below.
+//   Accepted      - what customers may pay with, all of which is collected
+//   Dispensable   - what the change box holds and gives back
+//   Capacity      - collection box slots per denomination
+template <typename Accepted_, typename Dispensable_, int Capacity>
+struct CurrencyDescriptor {
+    typedef Accepted_ Accepted;
+    typedef Dispensable_ Dispensable;
+    static constexpr int collectionCapacity = Capacity;
+
+    static_assert(Accepted::descending() && Dispensable::descending(),
+                  "Denominations must be listed largest first");
+    static_assert(isSubset<Dispensable, Accepted>(), "Change must be paid in accepted denominations");
+    static_assert(Dispensable::values[Dispensable::count - 1] == 1,
+                  "A unit coin is needed to make every amount of change");
+};
+
+struct ThaiBaht : CurrencyDescriptor<DenominationList<100, 20, 10, 5, 1>,
+                                     DenominationList<20, 10, 5, 1>, 100> {
+    static constexpr const char *code = "THB";
+};
+
+struct UsDollar : CurrencyDescriptor<DenominationList<20, 10, 5, 1>,
+                                     DenominationList<10, 5, 1>, 100> {
+    static constexpr const char *code = "USD";
+};
+
+// Chosen per build, e.g. DEFINES += VENDING_CURRENCY_USD; Thai baht otherwise
+#if defined(VENDING_CURRENCY_USD)
+typedef UsDollar Currency;
+#else
+typedef ThaiBaht Currency;
+#endif
+
+// "20THB" style label for a denomination, for display only
+inline QString denominationLabel(int value) {
+    return QString::number(value) + QLatin1String(Currency::code);
+}
+
+#endif // CURRENCY_H
@@ -1,4 +1,3 @@
-
 #ifndef DATABASE_H
 #define DATABASE_H
 
@@ -6,96 +5,270 @@
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QVariant>
 #include <QDebug>
+#include "currency.h"
+
+// One step of the schema history. Steps run in order, each in its own
+// transaction, and PRAGMA user_version records the last one applied.
+struct SchemaMigration {
+    int version;
+    const char *description;
+    QStringList statements;
+};
 
 class Database {
 public:
+    // How long a writer waits for another connection's write lock before
+    // giving up with SQLITE_BUSY
+    static const int kBusyTimeoutMsecs = 5000;
+
+    static QString path() {
+        return "vending_machine.db";
+    }
+
     static bool initialize() {
         QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
-        db.setDatabaseName("vending_machine.db");
+        db.setDatabaseName(path());
 
         if (!db.open()) {
             qDebug() << "Error: connection with database failed";
             return false;
         }
 
-        QSqlQuery query;
+        return prepare(db);
+    }
 
-        // Create stock table
-        if (!query.exec("CREATE TABLE IF NOT EXISTS stock_67011755("
-                        "item_name TEXT NOT NULL,"
-                        "price INTEGER NOT NULL,"
-                        "stock INTEGER NOT NULL"
-                        ");")) {
-            qDebug() << "Error creating stock table:" << query.lastError();
-            return false;
-        }
+    // Configure an open connection and bring its schema up to date
+    static bool prepare(QSqlDatabase db) {
+        QSqlQuery query(db);
 
-        // Create change box table
-        if (!query.exec("CREATE TABLE IF NOT EXISTS change_box_67011755("
-                        "THB TEXT NOT NULL,"
-                        "Count INTEGER NOT NULL"
-                        ");")) {
-            qDebug() << "Error creating change box table:" << query.lastError();
+        // Write-ahead logging: one fsync per commit instead of per page
+        // write, and readers never block the purchase path
+        if (!query.exec("PRAGMA journal_mode=WAL") || !query.exec("PRAGMA synchronous=NORMAL")) {
+            qDebug() << "Error configuring journal:" << query.lastError();
             return false;
         }
 
-        // Create collection box table
-        if (!query.exec("CREATE TABLE IF NOT EXISTS collection_box_67011755("
-                        "THB TEXT NOT NULL,"
-                        "Count INTEGER NOT NULL"
-                        ");")) {
-            qDebug() << "Error creating collection box table:" << query.lastError();
+        // Terminals sharing the file wait their turn rather than fail
+        if (!query.exec(QString("PRAGMA busy_timeout = %1").arg(kBusyTimeoutMsecs))) {
+            qDebug() << "Error setting busy timeout:" << query.lastError();
             return false;
         }
 
-        return true;
+        return migrate(db);
     }
 
-    static bool isTableEmpty(const QString& tableName) {
-        QSqlQuery query;
-        query.prepare("SELECT COUNT(*) FROM " + tableName);
+    static const QVector<SchemaMigration> &migrations() {
+        static const QVector<SchemaMigration> steps = {
+            {1, "Create stock, change box and collection box tables", {
+                 "CREATE TABLE IF NOT EXISTS stock_67011755("
+                 "item_name TEXT NOT NULL,"
+                 "price INTEGER NOT NULL,"
+                 "stock INTEGER NOT NULL"
+                 ")",
+                 "CREATE TABLE IF NOT EXISTS change_box_67011755("
+                 "THB TEXT NOT NULL,"
+                 "Count INTEGER NOT NULL"
+                 ")",
+                 "CREATE TABLE IF NOT EXISTS collection_box_67011755("
+                 "THB TEXT NOT NULL,"
+                 "Count INTEGER NOT NULL"
+                 ")"
+             }},
+            // Duplicate item names are merged (stock summed, highest price
+            // kept) and "20THB" style keys become integer denominations
+            {2, "Key tables by item name and integer denomination", {
+                 "CREATE TABLE stock_v2("
+                 "item_id INTEGER PRIMARY KEY,"
+                 "item_name TEXT NOT NULL UNIQUE,"
+                 "price INTEGER NOT NULL,"
+                 "stock INTEGER NOT NULL"
+                 ")",
+                 "INSERT INTO stock_v2 (item_name, price, stock) "
+                 "SELECT item_name, MAX(price), SUM(stock) FROM stock_67011755 "
+                 "GROUP BY item_name ORDER BY MIN(rowid)",
+                 "DROP TABLE stock_67011755",
+                 "ALTER TABLE stock_v2 RENAME TO stock_67011755",
+                 "CREATE INDEX idx_stock_67011755_stock ON stock_67011755(stock)",
 
-        if (query.exec() && query.next()) {
-            return query.value(0).toInt() == 0;
+                 "CREATE TABLE change_box_v2("
+                 "THB INTEGER PRIMARY KEY,"
+                 "Count INTEGER NOT NULL"
+                 ")",
+                 "INSERT INTO change_box_v2 (THB, Count) "
+                 "SELECT CAST(REPLACE(THB, 'THB', '') AS INTEGER), SUM(Count) "
+                 "FROM change_box_67011755 GROUP BY 1",
+                 "DROP TABLE change_box_67011755",
+                 "ALTER TABLE change_box_v2 RENAME TO change_box_67011755",
+
+                 "CREATE TABLE collection_box_v2("
+                 "THB INTEGER PRIMARY KEY,"
+                 "Count INTEGER NOT NULL"
+                 ")",
+                 "INSERT INTO collection_box_v2 (THB, Count) "
+                 "SELECT CAST(REPLACE(THB, 'THB', '') AS INTEGER), SUM(Count) "
+                 "FROM collection_box_67011755 GROUP BY 1",
+                 "DROP TABLE collection_box_67011755",
+                 "ALTER TABLE collection_box_v2 RENAME TO collection_box_67011755"
+             }},
+            // Last journal sequence folded into the tables above
+            {3, "Track the transaction journal checkpoint", {
+                 "CREATE TABLE journal_checkpoint_67011755("
+                 "id INTEGER PRIMARY KEY CHECK (id = 1),"
+                 "sequence INTEGER NOT NULL"
+                 ")",
+                 "INSERT INTO journal_checkpoint_67011755 (id, sequence) VALUES (1, 0)"
+             }},
+            // One row per sale, plus per-item hourly and daily totals kept up
+            // to date in the same transaction; analytics read only the totals
+            {4, "Record sales history and hourly/daily rollups", {
+                 "CREATE TABLE sales_67011755("
+                 "sale_id INTEGER PRIMARY KEY,"
+                 "sold_at INTEGER NOT NULL,"
+                 "item_name TEXT NOT NULL,"
+                 "price INTEGER NOT NULL,"
+                 "payment_total INTEGER NOT NULL,"
+                 "change_total INTEGER NOT NULL,"
+                 "payment_coins TEXT NOT NULL,"
+                 "change_coins TEXT NOT NULL"
+                 ")",
+                 "CREATE INDEX idx_sales_67011755_sold_at ON sales_67011755(sold_at)",
+                 "CREATE TABLE sales_hourly_67011755("
+                 "hour INTEGER NOT NULL,"
+                 "item_name TEXT NOT NULL,"
+                 "units INTEGER NOT NULL,"
+                 "revenue INTEGER NOT NULL,"
+                 "PRIMARY KEY (hour, item_name)"
+                 ") WITHOUT ROWID",
+                 "CREATE TABLE sales_daily_67011755("
+                 "day INTEGER NOT NULL,"
+                 "item_name TEXT NOT NULL,"
+                 "units INTEGER NOT NULL,"
+                 "revenue INTEGER NOT NULL,"
+                 "PRIMARY KEY (day, item_name)"
+                 ") WITHOUT ROWID"
+             }},
+            // A cart line is one sale row carrying its units, not one row per
+            // unit; earlier rows each sold one
+            {5, "Record the units sold by each sales row", {
+                 "ALTER TABLE sales_67011755 ADD COLUMN quantity INTEGER NOT NULL DEFAULT 1"
+             }}
+        };
+        return steps;
+    }
+
+    static int latestSchemaVersion() {
+        return migrations().last().version;
+    }
+
+    static int schemaVersion(QSqlDatabase db = QSqlDatabase::database()) {
+        QSqlQuery query(db);
+        if (query.exec("PRAGMA user_version") && query.next()) {
+            return query.value(0).toInt();
         }
-        return true;
+        return -1;
     }
 
-    static bool initializeChangeBox() {
-        if (!isTableEmpty("change_box_67011755")) {
+    // Upgrade the database in place up to targetVersion (latest by default).
+    // A database created before versioning reports user_version 0 and is
+    // picked up by step 1, whose CREATE TABLE IF NOT EXISTS keeps its data.
+    static bool migrate(QSqlDatabase db = QSqlDatabase::database(), int targetVersion = -1) {
+        if (targetVersion < 0) {
+            targetVersion = latestSchemaVersion();
+        }
+
+        int current = schemaVersion(db);
+        if (current < 0) {
+            qDebug() << "Error reading schema version:" << db.lastError();
+            return false;
+        }
+
+        // Every boot after the first ends here without running any DDL
+        if (current >= targetVersion) {
             return true;
         }
 
-        QSqlQuery query;
-        QStringList denominations = {"20THB", "10THB", "5THB", "1THB"};
+        for (const SchemaMigration &step : migrations()) {
+            if (step.version <= current || step.version > targetVersion) {
+                continue;
+            }
 
-        for (const QString& denom : denominations) {
-            query.prepare("INSERT OR REPLACE INTO change_box_67011755 (THB, Count) VALUES (?, 0)");
-            query.addBindValue(denom);
+            if (!db.transaction()) {
+                qDebug() << "Error starting migration" << step.version << ":" << db.lastError();
+                return false;
+            }
 
-            if (!query.exec()) {
-                qDebug() << "Error initializing change box:" << query.lastError();
+            QSqlQuery query(db);
+            QStringList statements = step.statements;
+            statements << QString("PRAGMA user_version = %1").arg(step.version);
+            for (const QString &statement : statements) {
+                if (!query.exec(statement)) {
+                    qDebug() << "Error applying migration" << step.version
+                             << "(" << step.description << "):" << query.lastError();
+                    query.finish();
+                    db.rollback();
+                    return false;
+                }
+            }
+            query.finish();
+
+            if (!db.commit()) {
+                qDebug() << "Error committing migration" << step.version << ":" << db.lastError();
+                db.rollback();
                 return false;
             }
+            current = step.version;
         }
         return true;
     }
 
-    static bool initializeCollectionBox() {
-        if (!isTableEmpty("collection_box_67011755")) {
+    // Give the change and collection boxes their denominations with a count
+    // of zero. Only the first run writes anything, in one transaction; later
+    // runs cost a single query that stops at the first row of each table.
+    static bool seedBoxes(QSqlDatabase db = QSqlDatabase::database()) {
+        QSqlQuery query(db);
+        if (!query.exec("SELECT EXISTS (SELECT 1 FROM change_box_67011755), "
+                        "EXISTS (SELECT 1 FROM collection_box_67011755)") || !query.next()) {
+            qDebug() << "Error checking coin boxes:" << query.lastError();
+            return false;
+        }
+        bool changeSeeded = query.value(0).toBool();
+        bool collectionSeeded = query.value(1).toBool();
+        query.finish();
+        if (changeSeeded && collectionSeeded) {
             return true;
         }
 
-        QSqlQuery query;
-        QStringList denominations = {"100THB", "20THB", "10THB", "5THB", "1THB"};
+        if (!db.transaction()) {
+            qDebug() << "Error starting coin box seeding:" << db.lastError();
+            return false;
+        }
+        if ((!changeSeeded && !seedBox(query, "change_box_67011755", Currency::Dispensable::toVector()))
+            || (!collectionSeeded && !seedBox(query, "collection_box_67011755", Currency::Accepted::toVector()))) {
+            query.finish();
+            db.rollback();
+            return false;
+        }
+        query.finish();
 
-        for (const QString& denom : denominations) {
-            query.prepare("INSERT OR REPLACE INTO collection_box_67011755 (THB, Count) VALUES (?, 0)");
-            query.addBindValue(denom);
+        if (!db.commit()) {
+            qDebug() << "Error committing coin boxes:" << db.lastError();
+            db.rollback();
+            return false;
+        }
+        return true;
+    }
 
+private:
+    static bool seedBox(QSqlQuery &query, const QString &table, const QVector<int> &denominations) {
+        query.prepare(QString("INSERT OR REPLACE INTO %1 (THB, Count) VALUES (?, 0)").arg(table));
+        for (int denom : denominations) {
+            query.bindValue(0, denom);
             if (!query.exec()) {
-                qDebug() << "Error initializing collection box:" << query.lastError();
+                qDebug() << "Error initializing" << table << ":" << query.lastError();
                 return false;
             }
         }
@@ -0,0 +1,292 @@
+// databasebackup.cpp
+#include "databasebackup.h"
+#include "database.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QThread>
+
+namespace {
+const char *kPrefix = "vending_machine-";
+
+class BackupTask : public QRunnable {
+public:
+    BackupTask(DatabaseBackup *owner, const QString &databasePath, const QString &directory, int keep)
+        : owner(owner), databasePath(databasePath), directory(directory), keep(keep) {}
+
+    void run() override {
+        DatabaseBackup::Result result = DatabaseBackup::run(databasePath, directory, keep);
+        // The owner waits for this task before it is destroyed
+        QMetaObject::invokeMethod(owner, "finish", Qt::QueuedConnection,
+                                  Q_ARG(DatabaseBackup::Result, result));
+    }
+
+private:
+    DatabaseBackup *owner;
+    QString databasePath;
+    QString directory;
+    int keep;
+};
+
+// Connection private to the calling thread, removed when it goes
+class ScopedConnection {
+public:
+    ScopedConnection(const QString &path, bool readOnly)
+        : name(QString("backup_%1_%2").arg(quintptr(QThread::currentThreadId())).arg(quintptr(this))) {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setDatabaseName(path);
+        if (readOnly) {
+            db.setConnectOptions("QSQLITE_OPEN_READONLY");
+        }
+        db.open();
+    }
+    ~ScopedConnection() {
+        QSqlDatabase::database(name, false).close();
+        QSqlDatabase::removeDatabase(name);
+    }
+    QSqlDatabase db() const { return QSqlDatabase::database(name, false); }
+
+private:
+    QString name;
+};
+
+double meanMicros(quint64 sum, quint64 count) {
+    return count > 0 ? sum / 1000.0 / count : 0;
+}
+}
+
+DatabaseBackup::DatabaseBackup(const QString &databasePath, QObject *parent)
+    : QObject(parent), databasePath(databasePath) {
+    qRegisterMetaType<DatabaseBackup::Result>("DatabaseBackup::Result");
+    pool.setMaxThreadCount(1);
+}
+
+DatabaseBackup::~DatabaseBackup() {
+    pool.waitForDone();
+}
+
+bool DatabaseBackup::start() {
+    if (running) {
+        return false;
+    }
+    running = true;
+    pool.start(new BackupTask(this, databasePath, backupDirectory, keepCount));
+    return true;
+}
+
+void DatabaseBackup::finish(const DatabaseBackup::Result &result) {
+    running = false;
+    emit finished(result);
+}
+
+DatabaseBackup::Result DatabaseBackup::run(const QString &databasePath, const QString &directory, int keep) {
+    static LatencyHistogram *const duration =
+        Metrics::histogram("vending_backup_seconds", "Time to take one online backup.");
+    static Counter *const failures = Metrics::counter("vending_backup_failures", "Backups that failed.");
+    LatencyHistogram *purchase = Metrics::latency("purchase");
+    LatencyHistogram *commit = Metrics::histogram("vending_sql_commit_seconds", "Time to commit a transaction.");
+
+    Result result;
+    QElapsedTimer timer;
+    timer.start();
+    quint64 purchasesBefore = purchase->count();
+    quint64 purchaseSumBefore = purchase->sum();
+    quint64 commitsBefore = commit->count();
+    quint64 commitSumBefore = commit->sum();
+
+    QString name = kPrefix + QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss-zzz") + ".db";
+    result.path = QDir(directory).filePath(name);
+    QString partial = result.path + ".part";
+
+    if (!QDir().mkpath(directory)) {
+        result.error = "Cannot create backup directory " + directory;
+    } else {
+        QFile::remove(partial);
+        ScopedConnection source(databasePath, false);
+        QSqlQuery query(source.db());
+        query.prepare("VACUUM INTO ?");
+        query.addBindValue(partial);
+        if (!source.db().isOpen() || !query.exec()) {
+            result.error = "Backup failed: " + query.lastError().text();
+        }
+    }
+
+    QString summary;
+    if (result.error.isEmpty() && !verify(partial, summary)) {
+        result.error = "Backup did not verify: " + summary;
+    }
+    if (result.error.isEmpty() && !QFile::rename(partial, result.path)) {
+        result.error = "Cannot publish backup " + result.path;
+    }
+
+    if (result.error.isEmpty()) {
+        result.ok = true;
+        result.bytes = QFileInfo(result.path).size();
+
+        // Rotate only once the new backup is known good
+        const QStringList existing = list(directory);
+        for (int i = keep; i < existing.size(); ++i) {
+            QFile::remove(existing.at(i));
+        }
+    } else {
+        QFile::remove(partial);
+        failures->increment();
+    }
+
+    result.nsecs = timer.nsecsElapsed();
+    duration->record(result.nsecs);
+
+    result.purchases = purchase->count() - purchasesBefore;
+    result.purchaseMicros = meanMicros(purchase->sum() - purchaseSumBefore, result.purchases);
+    result.baselinePurchaseMicros = meanMicros(purchaseSumBefore, purchasesBefore);
+    result.commits = commit->count() - commitsBefore;
+    result.commitMicros = meanMicros(commit->sum() - commitSumBefore, result.commits);
+    result.baselineCommitMicros = meanMicros(commitSumBefore, commitsBefore);
+    return result;
+}
+
+QStringList DatabaseBackup::list(const QString &directory) {
+    QDir dir(directory);
+    QStringList paths;
+    // Timestamped names sort oldest first
+    const QStringList names = dir.entryList({QString(kPrefix) + "*.db"}, QDir::Files, QDir::Name | QDir::Reversed);
+    for (const QString &name : names) {
+        paths.append(dir.filePath(name));
+    }
+    return paths;
+}
+
+bool DatabaseBackup::verify(const QString &path, QString &summary) {
+    if (!QFileInfo::exists(path)) {
+        summary = "No such file " + path;
+        return false;
+    }
+
+    ScopedConnection backup(path, true);
+    QSqlDatabase db = backup.db();
+    if (!db.isOpen()) {
+        summary = "Cannot open " + path + ": " + db.lastError().text();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA integrity_check") || !query.next() || query.value(0).toString() != "ok") {
+        summary = "Integrity check failed: "
+                  + (query.isActive() ? query.value(0).toString() : query.lastError().text());
+        return false;
+    }
+
+    int version = Database::schemaVersion(db);
+    if (version < 1 || version > Database::latestSchemaVersion()) {
+        summary = QString("Unsupported schema version %1").arg(version);
+        return false;
+    }
+
+    // Every table the engine loads must be readable
+    int items = 0;
+    int change = 0;
+    int collected = 0;
+    if (!query.exec("SELECT COUNT(*), COALESCE(SUM(stock), 0) FROM stock_67011755") || !query.next()) {
+        summary = "Stock table unreadable: " + query.lastError().text();
+        return false;
+    }
+    items = query.value(0).toInt();
+    int units = query.value(1).toInt();
+    if (!query.exec("SELECT COALESCE(SUM(CAST(THB AS INTEGER) * Count), 0) FROM change_box_67011755")
+        || !query.next()) {
+        summary = "Change box unreadable: " + query.lastError().text();
+        return false;
+    }
+    change = query.value(0).toInt();
+    if (!query.exec("SELECT COALESCE(SUM(CAST(THB AS INTEGER) * Count), 0) FROM collection_box_67011755")
+        || !query.next()) {
+        summary = "Collection box unreadable: " + query.lastError().text();
+        return false;
+    }
+    collected = query.value(0).toInt();
+
+    summary = QString("schema v%1, %2 items (%3 units), change %4 %5, collected %6 %5")
+                  .arg(version).arg(items).arg(units).arg(change).arg(Currency::code).arg(collected);
+    return true;
+}
+
+bool DatabaseBackup::restore(const QString &backupPath, const QString &databasePath, QString &summary) {
+    if (!verify(backupPath, summary)) {
+        return false;
+    }
+
+    // Copy beside the database and swap it in, so a failure part way
+    // leaves the current file untouched
+    QString staged = databasePath + ".restore";
+    QFile::remove(staged);
+    if (!QFile::copy(backupPath, staged)) {
+        summary = "Cannot copy " + backupPath;
+        return false;
+    }
+    QString previous = databasePath + ".before-restore";
+    QFile::remove(previous);
+    bool replacing = QFileInfo::exists(databasePath);
+    if (replacing && !QFile::rename(databasePath, previous)) {
+        QFile::remove(staged);
+        summary = "Cannot move aside " + databasePath;
+        return false;
+    }
+    if (replacing) {
+        // The write-ahead log holds the old file's latest commits
+        for (const char *suffix : {"-wal", "-shm"}) {
+            QFile::remove(previous + suffix);
+            QFile::rename(databasePath + suffix, previous + suffix);
+        }
+    }
+    if (!QFile::rename(staged, databasePath)) {
+        // Put the old file back with its log, or its latest commits are lost
+        if (replacing) {
+            QFile::rename(previous, databasePath);
+            for (const char *suffix : {"-wal", "-shm"}) {
+                QFile::rename(previous + suffix, databasePath + suffix);
+            }
+        }
+        QFile::remove(staged);
+        summary = "Cannot replace " + databasePath;
+        return false;
+    }
+
+    // No log left over from an earlier file may be applied to this one
+    QFile::remove(databasePath + "-wal");
+    QFile::remove(databasePath + "-shm");
+
+    QString restored;
+    if (!verify(databasePath, restored)) {
+        summary = "Restored database did not verify: " + restored;
+        return false;
+    }
+    summary = replacing ? restored + "; previous database kept as " + previous : restored;
+    return true;
+}
+
+QString DatabaseBackup::Result::summary() const {
+    if (!ok) {
+        return error;
+    }
+    QString text = QString("Backed up %1 (%2 KB) in %3 ms")
+                       .arg(QFileInfo(path).fileName()).arg(bytes / 1024).arg(nsecs / 1000000);
+    if (purchases > 0 && baselinePurchaseMicros > 0) {
+        text += QString("; %1 purchases during it averaged %2 us (%3% vs %4 us before)")
+                    .arg(purchases).arg(purchaseMicros, 0, 'f', 1)
+                    .arg((purchaseMicros / baselinePurchaseMicros - 1) * 100, 0, 'f', 1)
+                    .arg(baselinePurchaseMicros, 0, 'f', 1);
+    }
+    if (commits > 0 && baselineCommitMicros > 0) {
+        text += QString("; commits averaged %1 us (%2%)")
+                    .arg(commitMicros, 0, 'f', 1)
+                    .arg((commitMicros / baselineCommitMicros - 1) * 100, 0, 'f', 1);
+    }
+    return text;
+}
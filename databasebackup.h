@@ -0,0 +1,80 @@
+// databasebackup.h
+#ifndef DATABASEBACKUP_H
+#define DATABASEBACKUP_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+// Online backups of the machine database, taken while it keeps selling.
+// A backup is one VACUUM INTO on its own connection on a worker thread. In
+// WAL mode that reads a single consistent snapshot and never takes a lock
+// the storage thread's commits wait for. The copy is written under a
+// temporary name, checked and only then published, so a crash mid-backup
+// leaves no torn file. The newest keep() backups are kept.
+//
+// A backup holds the journal sequence of its checkpoint, so restoring one
+// beside the live journal replays every later sale at next start.
+class DatabaseBackup : public QObject {
+    Q_OBJECT
+
+public:
+    struct Result {
+        bool ok = false;
+        QString path;
+        QString error;
+        qint64 bytes = 0;
+        qint64 nsecs = 0;
+
+        // Mean purchase and commit latency while the backup ran, against
+        // the means before it; zero when none happened during it
+        quint64 purchases = 0;
+        double purchaseMicros = 0;
+        double baselinePurchaseMicros = 0;
+        quint64 commits = 0;
+        double commitMicros = 0;
+        double baselineCommitMicros = 0;
+
+        QString summary() const;
+    };
+
+    explicit DatabaseBackup(const QString &databasePath, QObject *parent = nullptr);
+    ~DatabaseBackup() override;
+
+    void setDirectory(const QString &directory) { backupDirectory = directory; }
+    QString directory() const { return backupDirectory; }
+    void setKeep(int count) { keepCount = qMax(1, count); }
+    int keep() const { return keepCount; }
+
+    // Backs up on a worker thread and emits finished(); false if one is
+    // already running
+    bool start();
+    bool isRunning() const { return running; }
+
+    // The steps start() runs, callable from any thread
+    static Result run(const QString &databasePath, const QString &directory, int keep);
+    static QStringList list(const QString &directory); // newest first
+    static bool verify(const QString &path, QString &summary);
+
+    // Verifies backupPath, then replaces databasePath with it. The machine
+    // must not have the database open.
+    static bool restore(const QString &backupPath, const QString &databasePath, QString &summary);
+
+signals:
+    void finished(const DatabaseBackup::Result &result);
+
+private slots:
+    void finish(const DatabaseBackup::Result &result);
+
+private:
+    QString databasePath;
+    QString backupDirectory = "backups";
+    int keepCount = 7;
+    bool running = false;
+    QThreadPool pool; // one backup at a time; waited for on destruction
+};
+
+Q_DECLARE_METATYPE(DatabaseBackup::Result)
+
+#endif // DATABASEBACKUP_H
@@ -0,0 +1,423 @@
+// headlesscontroller.cpp
+#include "headlesscontroller.h"
+#include "asyncstore.h"
+#include "database.h"
+#include "metrics.h"
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <QTimer>
+#include <QDebug>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace {
+const char *kHelp =
+    "OK commands: status | items | buy <item> <coin>... | cart <item>[:<quantity>]... = <coin>... | "
+    "restock <item> <amount> [<item> <amount>]... | par <units> | "
+    "refill <coin>... | collect | help | quit (coins as <denomination> or <denomination>x<count>)\n";
+
+// Machine-readable reason for each purchase failure
+const char *statusCode(PurchaseResult::Status status) {
+    switch (status) {
+    case PurchaseResult::Ok: return "ok";
+    case PurchaseResult::UnknownItem: return "unknown_item";
+    case PurchaseResult::OutOfStock: return "out_of_stock";
+    case PurchaseResult::InvalidDenomination: return "invalid_denomination";
+    case PurchaseResult::InsufficientPayment: return "insufficient_payment";
+    case PurchaseResult::InsufficientChange: return "insufficient_change";
+    case PurchaseResult::PaymentTooLarge: return "payment_too_large";
+    case PurchaseResult::InvalidQuantity: return "invalid_quantity";
+    case PurchaseResult::StorageError: return "storage_error";
+    }
+    return "error";
+}
+
+void appendError(QByteArray &out, const char *code, const QString &message) {
+    out += "ERR ";
+    out += code;
+    out += ' ';
+    out += message.toUtf8();
+    out += '\n';
+}
+
+// Reads whatever stdin already holds, blocking only while it holds nothing,
+// so a piped script is answered a chunk at a time; 0 at end of input
+qint64 readInput(char *buffer, qint64 size) {
+#ifdef Q_OS_UNIX
+    ssize_t n;
+    do {
+        n = ::read(STDIN_FILENO, buffer, size_t(size));
+    } while (n < 0 && errno == EINTR);
+    return n > 0 ? qint64(n) : 0;
+#else
+    return std::fgets(buffer, int(size), stdin) ? qint64(std::strlen(buffer)) : 0;
+#endif
+}
+
+void writeOutput(const QByteArray &data) {
+    std::fwrite(data.constData(), 1, size_t(data.size()), stdout);
+    std::fflush(stdout);
+}
+}
+
+HeadlessController::HeadlessController(VendingEngine *engine) : engine(engine) {
+}
+
+QStringList HeadlessController::tokenize(const QString &line) {
+    QStringList tokens;
+    QString current;
+    bool quoted = false;
+    bool inToken = false;
+    for (QChar c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+            inToken = true;
+        } else if (c.isSpace() && !quoted) {
+            if (inToken) {
+                tokens << current;
+                current.clear();
+                inToken = false;
+            }
+        } else {
+            current += c;
+            inToken = true;
+        }
+    }
+    if (inToken) {
+        tokens << current;
+    }
+    return tokens;
+}
+
+bool HeadlessController::parseCoins(const QStringList &tokens, int first, CoinCounts &coins) {
+    for (int i = first; i < tokens.size(); ++i) {
+        const QString &token = tokens.at(i);
+        int separator = token.indexOf('x');
+        bool valueOk = false;
+        bool countOk = true;
+        int value = token.left(separator < 0 ? token.size() : separator).toInt(&valueOk);
+        int count = separator < 0 ? 1 : token.mid(separator + 1).toInt(&countOk);
+        // Repeated denominations add up, and must not wrap doing so
+        if (!valueOk || !countOk || value <= 0 || count <= 0
+            || count > std::numeric_limits<int>::max() - coins.value(value)) {
+            return false;
+        }
+        coins[value] += count;
+    }
+    return !coins.isEmpty();
+}
+
+QByteArray HeadlessController::formatCoins(const CoinCounts &coins) {
+    QByteArray text;
+    for (auto it = coins.constEnd(); it != coins.constBegin();) {
+        --it;
+        if (it.value() == 0) {
+            continue;
+        }
+        if (!text.isEmpty()) {
+            text += ',';
+        }
+        text += QByteArray::number(it.key()) + 'x' + QByteArray::number(it.value());
+    }
+    return text.isEmpty() ? QByteArray("-") : text;
+}
+
+void HeadlessController::execute(const QString &line, QByteArray &out) {
+    static LatencyHistogram *const latency = Metrics::latency("headless_command");
+    ScopedTimer timer(latency);
+
+    const QStringList tokens = tokenize(line);
+    if (tokens.isEmpty()) {
+        return;
+    }
+
+    const QString command = tokens.first().toLower();
+    if (command == "status") {
+        status(out);
+    } else if (command == "items") {
+        items(out);
+    } else if (command == "buy") {
+        buy(tokens, out);
+    } else if (command == "cart") {
+        cart(tokens, out);
+    } else if (command == "restock") {
+        restock(tokens, out);
+    } else if (command == "par") {
+        par(tokens, out);
+    } else if (command == "refill") {
+        refill(tokens, out);
+    } else if (command == "collect") {
+        collect(out);
+    } else if (command == "help") {
+        out += kHelp;
+    } else if (command == "quit") {
+        out += "OK bye\n";
+        quit = true;
+    } else {
+        appendError(out, "unknown_command", "Unknown command " + tokens.first() + "; try help");
+    }
+}
+
+void HeadlessController::status(QByteArray &out) {
+    out += "OK operational=" + QByteArray(engine->isOperational() ? "1" : "0")
+           + " items=" + QByteArray::number(engine->catalog().size())
+           + " out_of_stock=" + QByteArray::number(engine->operatingStatus().outOfStockCount())
+           + " change=" + formatCoins(engine->changeBox())
+           + " collection=" + formatCoins(engine->collectionBox()) + '\n';
+}
+
+void HeadlessController::items(QByteArray &out) {
+    const Catalog &catalog = engine->catalog();
+    out += "OK " + QByteArray::number(catalog.size()) + '\n';
+    for (int row = 0; row < catalog.size(); ++row) {
+        out += catalog.name(row).toUtf8() + '\t' + QByteArray::number(catalog.price(row)) + '\t'
+               + QByteArray::number(catalog.stock(row)) + '\n';
+    }
+}
+
+void HeadlessController::buy(const QStringList &args, QByteArray &out) {
+    CoinCounts payment;
+    if (args.size() < 3 || !parseCoins(args, 2, payment)) {
+        appendError(out, "usage", "buy <item> <coin>...");
+        return;
+    }
+
+    PurchaseResult result = engine->purchase(args.at(1), payment);
+    if (result.status != PurchaseResult::Ok) {
+        QString message = result.status == PurchaseResult::StorageError ? engine->lastError()
+                                                                         : QString("Purchase refused");
+        appendError(out, statusCode(result.status), message);
+        return;
+    }
+    out += "OK price=" + QByteArray::number(result.price)
+           + " paid=" + QByteArray::number(result.totalPayment)
+           + " change=" + formatCoins(result.change) + '\n';
+}
+
+void HeadlessController::cart(const QStringList &args, QByteArray &out) {
+    int separator = args.indexOf("=");
+    QVector<CartLine> lines;
+    CoinCounts payment;
+    bool ok = separator > 1 && parseCoins(args, separator + 1, payment);
+    for (int i = 1; ok && i < separator; ++i) {
+        // The last colon, so a name may contain one
+        const QString &token = args.at(i);
+        int colon = token.lastIndexOf(':');
+        CartLine line;
+        line.itemName = colon < 0 ? token : token.left(colon);
+        if (colon >= 0) {
+            line.quantity = token.mid(colon + 1).toInt(&ok);
+            ok = ok && line.quantity > 0 && line.quantity <= VendingEngine::kMaxCartUnits;
+        }
+        lines.append(line);
+    }
+    if (!ok) {
+        appendError(out, "usage", "cart <item>[:<quantity>]... = <coin>...");
+        return;
+    }
+
+    PurchaseResult result = engine->purchaseCart(lines, payment);
+    if (result.status != PurchaseResult::Ok) {
+        QString message = result.status == PurchaseResult::StorageError ? engine->lastError()
+                                                                         : QString("Purchase refused");
+        if (!result.refusedItem.isEmpty()) {
+            message += ": " + result.refusedItem;
+        }
+        appendError(out, statusCode(result.status), message);
+        return;
+    }
+    out += "OK price=" + QByteArray::number(result.price)
+           + " paid=" + QByteArray::number(result.totalPayment)
+           + " change=" + formatCoins(result.change) + '\n';
+}
+
+void HeadlessController::restock(const QStringList &args, QByteArray &out) {
+    bool ok = false;
+    int amount = args.size() >= 3 && args.size() % 2 == 1 ? args.at(2).toInt(&ok) : 0;
+    if (!ok || amount <= 0) {
+        appendError(out, "usage", "restock <item> <amount> [<item> <amount>]...");
+        return;
+    }
+    if (args.size() > 3) {
+        restockMany(args, out);
+        return;
+    }
+    int row = engine->findItem(args.at(1));
+    if (row < 0) {
+        appendError(out, "unknown_item", "No item named " + args.at(1));
+        return;
+    }
+    if (!engine->restockItem(args.at(1), amount)) {
+        appendError(out, "storage_error", engine->lastError());
+        return;
+    }
+    out += "OK stock=" + QByteArray::number(engine->catalog().stock(row)) + '\n';
+}
+
+// Several items in one journal event and one commit
+void HeadlessController::restockMany(const QStringList &args, QByteArray &out) {
+    QMap<QString, int> amounts;
+    for (int i = 1; i + 1 < args.size(); i += 2) {
+        bool ok = false;
+        int amount = args.at(i + 1).toInt(&ok);
+        if (!ok || amount <= 0) {
+            appendError(out, "usage", "restock <item> <amount> [<item> <amount>]...");
+            return;
+        }
+        if (engine->findItem(args.at(i)) < 0) {
+            appendError(out, "unknown_item", "No item named " + args.at(i));
+            return;
+        }
+        amounts[args.at(i)] += amount;
+    }
+    if (!engine->restockItems(amounts)) {
+        appendError(out, "storage_error", engine->lastError());
+        return;
+    }
+    out += "OK items=" + QByteArray::number(amounts.size()) + '\n';
+}
+
+void HeadlessController::par(const QStringList &args, QByteArray &out) {
+    bool ok = false;
+    int level = args.size() == 2 ? args.at(1).toInt(&ok) : 0;
+    if (!ok || level <= 0) {
+        appendError(out, "usage", "par <units>");
+        return;
+    }
+    int below = engine->itemsBelowPar(level);
+    if (!engine->restockToPar(level)) {
+        appendError(out, "storage_error", engine->lastError());
+        return;
+    }
+    out += "OK items=" + QByteArray::number(below) + '\n';
+}
+
+void HeadlessController::refill(const QStringList &args, QByteArray &out) {
+    CoinCounts amounts;
+    if (!parseCoins(args, 1, amounts)) {
+        appendError(out, "usage", "refill <coin>...");
+        return;
+    }
+    for (auto it = amounts.constBegin(); it != amounts.constEnd(); ++it) {
+        if (!VendingEngine::changeDenominations().contains(it.key())) {
+            appendError(out, "invalid_denomination", "Not a change denomination: " + QString::number(it.key()));
+            return;
+        }
+    }
+    if (!engine->refillChange(amounts)) {
+        appendError(out, "storage_error", engine->lastError());
+        return;
+    }
+    out += "OK change=" + formatCoins(engine->changeBox()) + '\n';
+}
+
+void HeadlessController::collect(QByteArray &out) {
+    CoinCounts collected = engine->collectionBox();
+    int total = 0;
+    for (auto it = collected.constBegin(); it != collected.constEnd(); ++it) {
+        total += it.key() * it.value();
+    }
+    if (!engine->collectMoney()) {
+        appendError(out, "storage_error", engine->lastError());
+        return;
+    }
+    out += "OK total=" + QByteArray::number(total) + " coins=" + formatCoins(collected) + '\n';
+}
+
+int HeadlessController::run(const HeadlessOptions &options, const QElapsedTimer &startup) {
+    // Initialize database; an up-to-date file needs no DDL
+    if (!Database::initialize()) {
+        writeOutput("ERR database Failed to initialize database\n");
+        return 1;
+    }
+    Database::seedBoxes();
+    qint64 databaseNsecs = startup.nsecsElapsed();
+
+    // Same storage as the GUI: writes commit on the storage thread, so a
+    // command is answered without waiting on the disk
+    AsyncVendingStore store(Database::path());
+    store.setGroupCommitWindow(options.groupCommitMsecs);
+    store.setMultiTerminal(options.multiTerminal);
+    QObject::connect(&store, &AsyncVendingStore::storageError, [](const QString &message) {
+        qWarning().noquote() << "Storage error:" << message;
+    });
+
+    VendingEngine engine(&store);
+    engine.setChangePolicy(options.changePolicy);
+
+    // Other terminals write the same tables, so only a single terminal keeps
+    // a journal
+    TransactionJournal journal;
+    if (!options.multiTerminal) {
+        if (journal.open("vending_machine.journal")) {
+            engine.setJournal(&journal);
+        } else {
+            qWarning().noquote() << "Failed to open transaction journal:" << journal.lastError();
+        }
+    }
+
+    if (!engine.load()) {
+        writeOutput("ERR storage_error Failed to load machine state: " + engine.lastError().toUtf8() + '\n');
+        return 1;
+    }
+
+    QTimer metricsDumpTimer;
+    QString metricsPath = options.metricsPath;
+    QObject::connect(&metricsDumpTimer, &QTimer::timeout, [metricsPath]() { Metrics::dumpAsync(metricsPath); });
+    if (!metricsPath.isEmpty() && options.metricsIntervalMsecs > 0) {
+        metricsDumpTimer.start(options.metricsIntervalMsecs);
+    }
+
+    qint64 totalNsecs = startup.nsecsElapsed();
+    Metrics::startup("database")->record(databaseNsecs);
+    Metrics::startup("total")->record(totalNsecs);
+    writeOutput("READY startup_ms=" + QByteArray::number(totalNsecs / 1000000) + '\n');
+
+    // Every complete line in a chunk is answered before the one write for
+    // the chunk, so a scripted burst costs one syscall each way
+    HeadlessController controller(&engine);
+    QByteArray pending;
+    QByteArray response;
+    char chunk[64 * 1024];
+    while (!controller.quitRequested()) {
+        qint64 n = readInput(chunk, sizeof(chunk));
+        if (n == 0) {
+            break;
+        }
+        pending.append(chunk, int(n));
+
+        // The writes of the whole chunk reach the storage thread as one batch
+        store.holdWrites();
+        int start = 0;
+        int newline;
+        while (!controller.quitRequested() && (newline = pending.indexOf('\n', start)) >= 0) {
+            controller.execute(QString::fromUtf8(pending.constData() + start, newline - start), response);
+            start = newline + 1;
+        }
+        pending.remove(0, start);
+        store.releaseWrites();
+        writeOutput(response);
+        response.clear();
+
+        // Let timers (metrics dumps) and queued signals run between chunks
+        QCoreApplication::processEvents();
+    }
+
+    // A last command without a newline
+    if (!controller.quitRequested() && !pending.isEmpty()) {
+        controller.execute(QString::fromUtf8(pending), response);
+        writeOutput(response);
+    }
+
+    store.flush().waitForFinished();
+    if (!metricsPath.isEmpty()) {
+        Metrics::dumpAsync(metricsPath);
+    }
+    QThreadPool::globalInstance()->waitForDone();
+    return 0;
+}
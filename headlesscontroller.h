@@ -0,0 +1,62 @@
+// headlesscontroller.h
+#ifndef HEADLESSCONTROLLER_H
+#define HEADLESSCONTROLLER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include "vendingengine.h"
+
+struct HeadlessOptions {
+    int groupCommitMsecs = 0;
+    bool multiTerminal = false;
+    ChangeSolver::Policy changePolicy = ChangeSolver::FewestCoins;
+    QString metricsPath;
+    int metricsIntervalMsecs = 0;
+};
+
+// The machine without QtWidgets: one command per line in, one response per
+// command out, for controller boards without a display and for scripted
+// simulation; ControlServer serves the same commands over sockets.
+// Responses start with "OK" or "ERR <code>"; "items" is followed by one
+// tab-separated line per item. Names containing spaces are quoted.
+//
+//   status                      buy <item> <coin>...    e.g. buy Cola 20 5x2
+//   items                       restock <item> <amount> [<item> <amount>]...
+//   par <units>                 (fills every item below <units> up to it)
+//   cart <item>[:<quantity>]... = <coin>...             e.g. cart Cola:2 Water = 100
+//   collect                     refill <coin>...        e.g. refill 20x10 1x50
+//   help                        quit
+class HeadlessController {
+public:
+    explicit HeadlessController(VendingEngine *engine);
+
+    // Runs one command, appending its response to out
+    void execute(const QString &line, QByteArray &out);
+    bool quitRequested() const { return quit; }
+
+    // Opens the database and journal, loads the engine and serves stdin
+    // until end of input or "quit"; returns the process exit code
+    static int run(const HeadlessOptions &options, const QElapsedTimer &startup);
+
+private:
+    static QStringList tokenize(const QString &line);
+    static bool parseCoins(const QStringList &tokens, int first, CoinCounts &coins);
+    static QByteArray formatCoins(const CoinCounts &coins);
+
+    void status(QByteArray &out);
+    void items(QByteArray &out);
+    void buy(const QStringList &args, QByteArray &out);
+    void cart(const QStringList &args, QByteArray &out);
+    void restock(const QStringList &args, QByteArray &out);
+    void restockMany(const QStringList &args, QByteArray &out);
+    void par(const QStringList &args, QByteArray &out);
+    void refill(const QStringList &args, QByteArray &out);
+    void collect(QByteArray &out);
+
+    VendingEngine *engine;
+    bool quit = false;
+};
+
+#endif // HEADLESSCONTROLLER_H
@@ -4,20 +4,142 @@
 #include<QStyleFactory>
 #include<QPalette>
 #include<QMessageBox>
+#include<QCommandLineParser>
+#include<QScopedPointer>
+#include<QElapsedTimer>
+#include<QStatusBar>
+#include<QTimer>
+#include<QTextStream>
 #include "database.h"
+#include "databasebackup.h"
+#include "headlesscontroller.h"
+#include "metrics.h"
+
+// One stylesheet for the whole application, parsed once instead of per
+// button. Dialogs are not inside the stacked pages, so they keep the
+// platform look.
+static const char *kStyleSheet =
+    "QStackedWidget QPushButton {"
+    "    padding: 10px;"
+    "    border-radius: 5px;"
+    "    background-color: #2ECC71;"
+    "    color: white;"
+    "    border: none;"
+    "    min-width: 120px;"
+    "}"
+    "QStackedWidget QPushButton:hover {"
+    "    background-color: #27AE60;"
+    "}"
+    "QStackedWidget QPushButton[large=\"true\"] {"
+    "    padding: 15px;"
+    "    font-size: 18px;"
+    "    border-radius: 8px;"
+    "    min-width: 200px;"
+    "}"
+    "QLabel#pageTitle {"
+    "    color: #ECF0F1;"
+    "    margin: 20px;"
+    "}";
 
 int main(int argc, char *argv[]) {
-    QApplication a(argc, argv);
+    QElapsedTimer startup;
+    startup.start();
+
+    // Headless mode never loads QtWidgets (no platform plugin, fonts or
+    // windows), so the kind of application is settled before parsing
+    bool headless = false;
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        }
+    }
+    QScopedPointer<QCoreApplication> app(headless ? new QCoreApplication(argc, argv)
+                                                  : new QApplication(argc, argv));
+
+    // Parse command line options
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption groupCommitOption("group-commit-ms",
+                                         "Coalesce purchases arriving within <ms> into one commit (0 = commit every sale).",
+                                         "ms", "0");
+    parser.addOption(groupCommitOption);
+    QCommandLineOption multiTerminalOption("multi-terminal",
+                                           "Share the database with other terminals: sales are checked against the shared stock and coins and retried on conflict.");
+    parser.addOption(multiTerminalOption);
+    QCommandLineOption coinAcceptorOption("coin-acceptor",
+                                          "Accept coin events from the local socket <name>, e.g. from tools/coinsim.",
+                                          "name");
+    parser.addOption(coinAcceptorOption);
+    QCommandLineOption controlSocketOption("control-socket",
+                                           "Serve the control API on the local socket <name>, e.g. for tools/controlclient.",
+                                           "name");
+    parser.addOption(controlSocketOption);
+    QCommandLineOption controlPortOption("control-port",
+                                         "Serve the control API on localhost TCP <port>.",
+                                         "port");
+    parser.addOption(controlPortOption);
+    QCommandLineOption changePolicyOption("change-policy",
+                                          "Change-making policy: \"fewest\" coins or \"preserve\" low-stock denominations.",
+                                          "policy", "fewest");
+    parser.addOption(changePolicyOption);
+    QCommandLineOption metricsFileOption("metrics-file",
+                                         "Write metrics in OpenMetrics format to <file> (empty = off).",
+                                         "file", "vending_metrics.txt");
+    parser.addOption(metricsFileOption);
+    QCommandLineOption metricsIntervalOption("metrics-interval",
+                                             "Seconds between metrics dumps.",
+                                             "seconds", "10");
+    parser.addOption(metricsIntervalOption);
+    QCommandLineOption backupDirOption("backup-dir",
+                                       "Directory for online database backups.",
+                                       "dir", "backups");
+    parser.addOption(backupDirOption);
+    QCommandLineOption backupIntervalOption("backup-interval",
+                                            "Minutes between automatic backups (0 = only from the admin page).",
+                                            "minutes", "0");
+    parser.addOption(backupIntervalOption);
+    QCommandLineOption backupKeepOption("backup-keep",
+                                        "Number of backups to keep.",
+                                        "n", "7");
+    parser.addOption(backupKeepOption);
+    QCommandLineOption restoreOption("restore",
+                                     "Verify the backup <file>, make it the machine's database and exit.",
+                                     "file");
+    parser.addOption(restoreOption);
+    QCommandLineOption headlessOption("headless",
+                                      "Run without a display, taking commands on stdin (try \"help\").");
+    parser.addOption(headlessOption);
+    parser.process(*app);
+
+    // Restore runs before anything opens the database
+    if (parser.isSet(restoreOption)) {
+        QString summary;
+        bool restored = DatabaseBackup::restore(parser.value(restoreOption), Database::path(), summary);
+        QTextStream(restored ? stdout : stderr) << (restored ? "Restored: " : "Restore failed: ") << summary << "\n";
+        return restored ? 0 : 1;
+    }
 
-    // Initialize database
+    ChangeSolver::Policy changePolicy = parser.value(changePolicyOption) == "preserve"
+                                            ? ChangeSolver::PreserveLowStock : ChangeSolver::FewestCoins;
+    if (headless) {
+        HeadlessOptions options;
+        options.groupCommitMsecs = parser.value(groupCommitOption).toInt();
+        options.multiTerminal = parser.isSet(multiTerminalOption);
+        options.changePolicy = changePolicy;
+        options.metricsPath = parser.value(metricsFileOption);
+        options.metricsIntervalMsecs = parser.value(metricsIntervalOption).toInt() * 1000;
+        return HeadlessController::run(options, startup);
+    }
+
+    // Initialize database; an up-to-date file needs no DDL
     if (!Database::initialize()) {
         QMessageBox::critical(nullptr, "Error", "Failed to initialize database!");
         return -1;
     }
 
-    // Initialize boxes
-    Database::initializeChangeBox();
-    Database::initializeCollectionBox();
+    // Initialize boxes on first run
+    Database::seedBoxes();
+    qint64 databaseNsecs = startup.nsecsElapsed();
 
     // Set application style
     QApplication::setStyle(QStyleFactory::create("Fusion"));
@@ -38,9 +160,32 @@ int main(int argc, char *argv[]) {
     darkPalette.setColor(QPalette::Highlight, QColor(42, 130, 218));
     darkPalette.setColor(QPalette::HighlightedText, Qt::black);
     QApplication::setPalette(darkPalette);
+    qApp->setStyleSheet(kStyleSheet);
 
-    MainWindow w;
+    MainWindow w(parser.isSet(multiTerminalOption));
+    w.setGroupCommitWindow(parser.value(groupCommitOption).toInt());
+    if (parser.isSet(coinAcceptorOption)) {
+        w.setCoinAcceptor(parser.value(coinAcceptorOption));
+    }
+    if (parser.isSet(controlSocketOption) || parser.isSet(controlPortOption)) {
+        w.setControlServer(parser.value(controlSocketOption), quint16(parser.value(controlPortOption).toUInt()));
+    }
+    w.setChangePolicy(changePolicy);
+    w.setMetricsDump(parser.value(metricsFileOption), parser.value(metricsIntervalOption).toInt() * 1000);
+    w.setBackups(parser.value(backupDirOption), parser.value(backupKeepOption).toInt(),
+                 parser.value(backupIntervalOption).toInt() * 60 * 1000);
     w.show();
 
-    return a.exec();
+    // Report once the event loop is running, i.e. when the first frame goes up
+    QTimer::singleShot(0, &w, [&w, &startup, databaseNsecs]() {
+        qint64 totalNsecs = startup.nsecsElapsed();
+        Metrics::startup("database")->record(databaseNsecs);
+        Metrics::startup("total")->record(totalNsecs);
+        QString report = QString("Started in %1 ms (database %2 ms)")
+                             .arg(totalNsecs / 1000000).arg(databaseNsecs / 1000000);
+        qInfo().noquote() << report;
+        w.statusBar()->showMessage(report, 10000);
+    });
+
+    return app->exec();
 }
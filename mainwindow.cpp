@@ -10,11 +10,50 @@
 #include <QInputDialog>
 #include <QFont>
 #include <QHeaderView>
-#include <QSqlQuery>
-#include <QSqlError>
+#include <QStatusBar>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QFormLayout>
+#include <QFileDialog>
+#include <QFutureWatcher>
+#include <algorithm>
+#include <memory>
+#include "catalogio.h"
+#include "salesanalytics.h"
+#include "metrics.h"
 #include <QDebug>
+#include "database.h"
+
+namespace {
+// "1, 5, 10, 20, or 100 THB" for the build's currency, built once
+const QString &acceptedDenominationsText() {
+    static const QString text = [] {
+        QStringList values;
+        const QVector<int> &accepted = VendingEngine::acceptedDenominations();
+        for (auto it = accepted.crbegin(); it != accepted.crend(); ++it) {
+            values << QString::number(*it);
+        }
+        values.last().prepend("or ");
+        return values.join(", ") + ' ' + Currency::code;
+    }();
+    return text;
+}
+
+// Names of the selected stock rows, in table order
+QStringList selectedItemNames(QTableView *table, StockTableModel *model, const Catalog &catalog) {
+    QModelIndexList selectedIndexes = table->selectionModel()->selectedRows();
+    std::sort(selectedIndexes.begin(), selectedIndexes.end());
+    QStringList names;
+    for (const QModelIndex &index : selectedIndexes) {
+        names << catalog.name(model->itemRow(index.row()));
+    }
+    return names;
+}
+}
 
-MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
+MainWindow::MainWindow(bool multiTerminal, QWidget *parent)
+    : QMainWindow(parent), store(Database::path()), engine(&store), payment(&engine),
+      backup(Database::path()) {
     // Initialize the window with a title and reasonable size
     setWindowTitle("Modern Vending Machine");
     resize(1024, 768);
@@ -28,18 +67,82 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     QVBoxLayout *mainLayout = new QVBoxLayout(centralWidget);
     mainLayout->addWidget(stackedWidget);
 
-    // Create all our pages
+    // Only the main page is needed for the first frame; the others, and the
+    // models behind their tables, are built on first navigation
     createMainPage();
-    createAdminPage();
-    createUserPage();
-
-    // Add pages to the stacked widget
     stackedWidget->addWidget(mainPage);
-    stackedWidget->addWidget(adminPage);
-    stackedWidget->addWidget(userPage);
 
-    // Refresh all data tables
-    refreshTables();
+    // Re-evaluated by the engine after every sale and admin action; queued so
+    // the purchase result is shown before any out-of-service notice
+    connect(&engine, &VendingEngine::operationalChanged, this,
+            &MainWindow::handleOperationalChanged, Qt::QueuedConnection);
+
+    // Periodic OpenMetrics dump, written off the GUI thread
+    connect(&metricsDumpTimer, &QTimer::timeout, this, [this]() { Metrics::dumpAsync(metricsPath); });
+
+    // Payment progress is shown on the user page as each event lands
+    connect(&payment, &PaymentSession::creditChanged, this, &MainWindow::updateCredit);
+    connect(&payment, &PaymentSession::coinRejected, this, &MainWindow::handleCoinRejected);
+    connect(&payment, &PaymentSession::refunded, this, &MainWindow::handleRefund);
+    connect(&payment, &PaymentSession::completed, this, &MainWindow::handlePurchaseCompleted);
+
+    // Writes complete in the background; a failure there is reported here
+    connect(&store, &AsyncVendingStore::storageError, this, &MainWindow::handleStorageError);
+
+    // Backups run on their own thread and connection and report back here
+    connect(&backupTimer, &QTimer::timeout, this, &MainWindow::backupNow);
+    connect(&backup, &DatabaseBackup::finished, this, &MainWindow::handleBackupFinished);
+
+    // The journal is the record of every sale and the tables are its
+    // checkpoint. Other terminals write shared tables too, so a local journal
+    // cannot be the record of them; the shared database is. Decided before
+    // anything is replayed.
+    this->multiTerminal = multiTerminal;
+    store.setMultiTerminal(multiTerminal);
+    if (!multiTerminal) {
+        if (journal.open("vending_machine.journal")) {
+            engine.setJournal(&journal);
+        } else {
+            QMessageBox::warning(this, "Journal", "Failed to open transaction journal: " + journal.lastError());
+        }
+    }
+
+    // Load machine state into the purchase engine; the models follow it
+    if (!engine.load()) {
+        QMessageBox::critical(this, "Error", "Failed to load machine state: " + engine.lastError());
+    }
+}
+
+void MainWindow::setGroupCommitWindow(int msecs) {
+    store.setGroupCommitWindow(msecs);
+}
+
+bool MainWindow::setCoinAcceptor(const QString &name) {
+    delete coinAcceptor;
+    coinAcceptor = new LocalSocketCoinSource(this);
+    connect(coinAcceptor, &CoinSource::coinInserted, &payment, &PaymentSession::insertCoin);
+    connect(coinAcceptor, &CoinSource::itemSelected, &payment, &PaymentSession::select);
+    connect(coinAcceptor, &CoinSource::cancelRequested, &payment, &PaymentSession::cancel);
+    if (!coinAcceptor->listen(name)) {
+        statusBar()->showMessage("Coin acceptor unavailable: " + coinAcceptor->errorString());
+        return false;
+    }
+    return true;
+}
+
+bool MainWindow::setControlServer(const QString &socketName, quint16 tcpPort) {
+    delete controlServer;
+    controlServer = new ControlServer(&engine, &store, this);
+    bool ok = (socketName.isEmpty() || controlServer->listenLocal(socketName))
+              && (tcpPort == 0 || controlServer->listenTcp(tcpPort));
+    if (!ok) {
+        statusBar()->showMessage("Control API unavailable: " + controlServer->errorString());
+    }
+    return ok;
+}
+
+void MainWindow::setChangePolicy(ChangeSolver::Policy policy) {
+    engine.setChangePolicy(policy);
 }
 
 void MainWindow::createMainPage() {
@@ -51,29 +154,13 @@ void MainWindow::createMainPage() {
     QFont titleFont("Arial", 24, QFont::Bold);
     titleLabel->setFont(titleFont);
     titleLabel->setAlignment(Qt::AlignCenter);
-    titleLabel->setStyleSheet("color: #ECF0F1; margin: 20px;");
+    titleLabel->setObjectName("pageTitle");
 
-    // Create mode selection buttons
+    // Create mode selection buttons, styled large by the application stylesheet
     QPushButton *userButton = new QPushButton("User Mode");
     QPushButton *adminButton = new QPushButton("Admin Mode");
-
-    // Style the buttons for a modern look
-    QString buttonStyle =
-        "QPushButton {"
-        "    padding: 15px;"
-        "    font-size: 18px;"
-        "    border-radius: 8px;"
-        "    min-width: 200px;"
-        "    background-color: #2ECC71;"
-        "    color: white;"
-        "    border: none;"
-        "}"
-        "QPushButton:hover {"
-        "    background-color: #27AE60;"
-        "}";
-
-    userButton->setStyleSheet(buttonStyle);
-    adminButton->setStyleSheet(buttonStyle);
+    userButton->setProperty("large", true);
+    adminButton->setProperty("large", true);
 
     // Add widgets to layout with proper spacing
     layout->addStretch();
@@ -98,66 +185,78 @@ void MainWindow::createAdminPage() {
     QFont titleFont("Arial", 20, QFont::Bold);
     titleLabel->setFont(titleFont);
     titleLabel->setAlignment(Qt::AlignCenter);
-    titleLabel->setStyleSheet("color: #ECF0F1; margin: 20px;");
+    titleLabel->setObjectName("pageTitle");
+
+    // Create the table models; they load from the engine as they are built
+    stockModel = new StockTableModel(&engine, false, this);
+    changeBoxModel = new BoxTableModel(&engine, BoxTableModel::ChangeBox, this);
+    collectionBoxModel = new BoxTableModel(&engine, BoxTableModel::CollectionBox, this);
 
     // Create tables for displaying data
-    stockTable = new QTableWidget();
-    stockTable->setColumnCount(3);
-    stockTable->setHorizontalHeaderLabels({"Item Name", "Price (THB)", "Stock"});
-    stockTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    stockTable = new QTableView();
+    setupTableView(stockTable, stockModel);
 
-    changeBoxTable = new QTableWidget();
-    changeBoxTable->setColumnCount(2);
-    changeBoxTable->setHorizontalHeaderLabels({"Denomination", "Count"});
-    changeBoxTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    changeBoxTable = new QTableView();
+    setupTableView(changeBoxTable, changeBoxModel);
 
-    collectionBoxTable = new QTableWidget();
-    collectionBoxTable->setColumnCount(2);
-    collectionBoxTable->setHorizontalHeaderLabels({"Denomination", "Count"});
-    collectionBoxTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    collectionBoxTable = new QTableView();
+    setupTableView(collectionBoxTable, collectionBoxModel);
+
+    // Restock and delete act on every selected item at once
+    stockTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
     // Create admin control buttons
     QHBoxLayout *buttonLayout = new QHBoxLayout();
     QPushButton *addButton = new QPushButton("Add Item");
     QPushButton *deleteButton = new QPushButton("Delete Item");
     QPushButton *restockButton = new QPushButton("Restock");
+    QPushButton *parButton = new QPushButton("Restock to Par");
     QPushButton *refillChangeButton = new QPushButton("Refill Change");
     QPushButton *collectMoneyButton = new QPushButton("Collect Money");
+    QPushButton *importButton = new QPushButton("Import Catalog");
+    QPushButton *exportButton = new QPushButton("Export Catalog");
+    QPushButton *analyticsButton = new QPushButton("Sales Analytics");
+    QPushButton *backupButton = new QPushButton("Backup Now");
     QPushButton *backButton = new QPushButton("Back to Main");
 
-    // Style the buttons
-    QString buttonStyle =
-        "QPushButton {"
-        "    padding: 10px;"
-        "    border-radius: 5px;"
-        "    background-color: #2ECC71;"
-        "    color: white;"
-        "    border: none;"
-        "    min-width: 120px;"
-        "}"
-        "QPushButton:hover {"
-        "    background-color: #27AE60;"
-        "}";
-
-    addButton->setStyleSheet(buttonStyle);
-    deleteButton->setStyleSheet(buttonStyle);
-    restockButton->setStyleSheet(buttonStyle);
-    refillChangeButton->setStyleSheet(buttonStyle);
-    collectMoneyButton->setStyleSheet(buttonStyle);
-    backButton->setStyleSheet(buttonStyle);
-
     // Add buttons to layout
     buttonLayout->addWidget(addButton);
     buttonLayout->addWidget(deleteButton);
     buttonLayout->addWidget(restockButton);
+    buttonLayout->addWidget(parButton);
     buttonLayout->addWidget(refillChangeButton);
     buttonLayout->addWidget(collectMoneyButton);
+    buttonLayout->addWidget(importButton);
+    buttonLayout->addWidget(exportButton);
+    buttonLayout->addWidget(analyticsButton);
+    buttonLayout->addWidget(backupButton);
     buttonLayout->addWidget(backButton);
 
+    // Live latency percentiles and counters, refreshed while the page is shown
+    performanceModel = new QStandardItemModel(0, 6, this);
+    performanceModel->setHorizontalHeaderLabels(
+        {"Metric", "Count", "p50 (us)", "p99 (us)", "p99.9 (us)", "Max (us)"});
+    QTableView *performanceTable = new QTableView();
+    setupTableView(performanceTable, performanceModel);
+    performanceTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+    performanceTimer.setInterval(1000);
+    connect(&performanceTimer, &QTimer::timeout, this, &MainWindow::refreshPerformance);
+    performanceTimer.start();
+
+    // Time-to-empty and time-to-full age between sales, so the projections
+    // are refreshed with the performance figures while the page is shown
+    connect(&performanceTimer, &QTimer::timeout, this, [this]() {
+        if (stackedWidget->currentWidget() == adminPage) {
+            stockModel->refreshForecast();
+            collectionBoxModel->refreshForecast();
+        }
+    });
+
     // Create section labels
     QLabel *stockLabel = new QLabel("Stock Management");
     QLabel *changeLabel = new QLabel("Change Box Status");
     QLabel *collectionLabel = new QLabel("Collection Box Status");
+    QLabel *performanceLabel = new QLabel("Performance");
 
     // Add all widgets to main layout
     layout->addWidget(titleLabel);
@@ -167,14 +266,22 @@ void MainWindow::createAdminPage() {
     layout->addWidget(changeBoxTable);
     layout->addWidget(collectionLabel);
     layout->addWidget(collectionBoxTable);
+    layout->addWidget(performanceLabel);
+    layout->addWidget(performanceTable);
     layout->addLayout(buttonLayout);
 
     // Connect buttons to their respective slots
     connect(addButton, &QPushButton::clicked, this, &MainWindow::addNewItem);
     connect(deleteButton, &QPushButton::clicked, this, &MainWindow::deleteItem);
     connect(restockButton, &QPushButton::clicked, this, &MainWindow::restockItem);
+    connect(parButton, &QPushButton::clicked, this, &MainWindow::restockToPar);
     connect(refillChangeButton, &QPushButton::clicked, this, &MainWindow::refillChange);
     connect(collectMoneyButton, &QPushButton::clicked, this, &MainWindow::collectMoney);
+    connect(importButton, &QPushButton::clicked, this, &MainWindow::importCatalog);
+    connect(exportButton, &QPushButton::clicked, this, &MainWindow::exportCatalog);
+    connect(analyticsButton, &QPushButton::clicked, this, &MainWindow::showAnalytics);
+    connect(backupButton, &QPushButton::clicked, this, &MainWindow::backupNow);
+
     connect(backButton, &QPushButton::clicked, this, &MainWindow::returnToMain);
 }
 
@@ -189,114 +296,316 @@ void MainWindow::createUserPage() {
     titleLabel->setAlignment(Qt::AlignCenter);
 
     // Create items display table
-    itemsTable = new QTableWidget(); // Change to class member
-    itemsTable->setColumnCount(3);
-    itemsTable->setHorizontalHeaderLabels({"Item Name", "Price (THB)", "Stock"});
-    itemsTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    itemsModel = new StockTableModel(&engine, true, this);
+    itemsTable = new QTableView();
+    setupTableView(itemsTable, itemsModel);
+
+    // Running credit and the outcome of the last sale, updated in place
+    creditLabel = new QLabel();
+    QFont creditFont("Arial", 16, QFont::Bold);
+    creditLabel->setFont(creditFont);
+    creditLabel->setAlignment(Qt::AlignCenter);
+    paymentStatusLabel = new QLabel();
+    paymentStatusLabel->setAlignment(Qt::AlignCenter);
+    paymentStatusLabel->setWordWrap(true);
+
+    // One button per accepted denomination feeds the payment session
+    QHBoxLayout *coinLayout = new QHBoxLayout();
+    for (int denom : VendingEngine::acceptedDenominations()) {
+        QPushButton *coinButton = new QPushButton("Insert " + denominationLabel(denom));
+        coinLayout->addWidget(coinButton);
+        connect(coinButton, &QPushButton::clicked, &payment, [this, denom]() { payment.insertCoin(denom); });
+    }
 
-    // Add purchase button
+    // Several rows can be selected and added to the cart at once
+    itemsTable->setSelectionMode(QAbstractItemView::ExtendedSelection);
+
+    // Cart: bought together for one payment
+    cartModel = new QStandardItemModel(0, 3, this);
+    cartModel->setHorizontalHeaderLabels({"Item", "Quantity", "Subtotal"});
+    cartTable = new QTableView();
+    setupTableView(cartTable, cartModel);
+    cartTable->setMaximumHeight(cartTable->verticalHeader()->defaultSectionSize() * 5);
+    cartQuantity = new QSpinBox();
+    cartQuantity->setRange(1, 99);
+    cartQuantity->setPrefix("Qty ");
+    cartTotalLabel = new QLabel();
+    QPushButton *addToCartButton = new QPushButton("Add Selected to Cart");
+    QPushButton *removeFromCartButton = new QPushButton("Remove from Cart");
+    QPushButton *checkoutButton = new QPushButton("Checkout Cart");
+    QHBoxLayout *cartLayout = new QHBoxLayout();
+    cartLayout->addWidget(cartQuantity);
+    cartLayout->addWidget(addToCartButton);
+    cartLayout->addWidget(removeFromCartButton);
+    cartLayout->addWidget(cartTotalLabel);
+    cartLayout->addWidget(checkoutButton);
+
+    // Add purchase and cancel buttons
     QPushButton *purchaseButton = new QPushButton("Purchase Selected Item");
-    purchaseButton->setStyleSheet(
-        "QPushButton {"
-        "    padding: 10px;"
-        "    border-radius: 5px;"
-        "    background-color: #2ECC71;"
-        "    color: white;"
-        "    border: none;"
-        "    min-width: 120px;"
-        "}"
-        "QPushButton:hover {"
-        "    background-color: #27AE60;"
-        "}"
-        );
+    QPushButton *cancelButton = new QPushButton("Cancel and Return Coins");
+    QHBoxLayout *actionLayout = new QHBoxLayout();
+    actionLayout->addWidget(purchaseButton);
+    actionLayout->addWidget(cancelButton);
 
     // Create back button
     QPushButton *backButton = new QPushButton("Back to Main");
-    backButton->setStyleSheet(
-        "QPushButton {"
-        "    padding: 10px;"
-        "    border-radius: 5px;"
-        "    background-color: #2ECC71;"
-        "    color: white;"
-        "    border: none;"
-        "    min-width: 120px;"
-        "}"
-        "QPushButton:hover {"
-        "    background-color: #27AE60;"
-        "}"
-        );
 
     // Add widgets to layout
     layout->addWidget(titleLabel);
     layout->addWidget(itemsTable);
-    layout->addWidget(purchaseButton);
+    layout->addLayout(cartLayout);
+    layout->addWidget(cartTable);
+    layout->addWidget(creditLabel);
+    layout->addWidget(paymentStatusLabel);
+    layout->addLayout(coinLayout);
+    layout->addLayout(actionLayout);
     layout->addWidget(backButton);
 
     // Connect buttons
     connect(backButton, &QPushButton::clicked, this, &MainWindow::returnToMain);
     connect(purchaseButton, &QPushButton::clicked, this, &MainWindow::handleItemPurchase);
+    connect(cancelButton, &QPushButton::clicked, &payment, &PaymentSession::cancel);
+    connect(addToCartButton, &QPushButton::clicked, this, &MainWindow::addToCart);
+    connect(removeFromCartButton, &QPushButton::clicked, this, &MainWindow::removeFromCart);
+    connect(checkoutButton, &QPushButton::clicked, &payment, &PaymentSession::checkout);
+    connect(&payment, &PaymentSession::cartChanged, this, &MainWindow::refreshCart);
+    updateCredit(payment.credit(), payment.selectedPrice());
+    refreshCart();
 }
 
-void MainWindow::refreshTables() {
-    // Refresh stock table
-    QSqlQuery stockQuery("SELECT item_name, price, stock FROM stock_67011755");
-    stockTable->setRowCount(0);
-    while (stockQuery.next()) {
-        int row = stockTable->rowCount();
-        stockTable->insertRow(row);
-        stockTable->setItem(row, 0, new QTableWidgetItem(stockQuery.value(0).toString()));
-        stockTable->setItem(row, 1, new QTableWidgetItem(stockQuery.value(1).toString()));
-        stockTable->setItem(row, 2, new QTableWidgetItem(stockQuery.value(2).toString()));
-    }
+void MainWindow::createAnalyticsPage() {
+    analyticsPage = new QWidget();
+    QVBoxLayout *layout = new QVBoxLayout(analyticsPage);
 
-    // Refresh change box table
-    QSqlQuery changeQuery("SELECT THB, Count FROM change_box_67011755");
-    changeBoxTable->setRowCount(0);
-    while (changeQuery.next()) {
-        int row = changeBoxTable->rowCount();
-        changeBoxTable->insertRow(row);
-        changeBoxTable->setItem(row, 0, new QTableWidgetItem(changeQuery.value(0).toString()));
-        changeBoxTable->setItem(row, 1, new QTableWidgetItem(changeQuery.value(1).toString()));
+    // Create title for analytics page
+    QLabel *titleLabel = new QLabel("Sales Analytics");
+    QFont titleFont("Arial", 20, QFont::Bold);
+    titleLabel->setFont(titleFont);
+    titleLabel->setAlignment(Qt::AlignCenter);
+    titleLabel->setObjectName("pageTitle");
+
+    // Reporting period; today is broken down by hour, longer ranges by day
+    analyticsRange = new QComboBox();
+    analyticsRange->addItem("Today", 1);
+    analyticsRange->addItem("Last 7 Days", 7);
+    analyticsRange->addItem("Last 30 Days", 30);
+    analyticsRange->addItem("Last 365 Days", 365);
+    analyticsSummary = new QLabel();
+
+    QHBoxLayout *rangeLayout = new QHBoxLayout();
+    rangeLayout->addWidget(new QLabel("Period:"));
+    rangeLayout->addWidget(analyticsRange);
+    rangeLayout->addStretch();
+    rangeLayout->addWidget(analyticsSummary);
+
+    // Create result tables
+    topSellersModel = new QStandardItemModel(0, 3, this);
+    topSellersModel->setHorizontalHeaderLabels({"Item", "Units Sold", QString("Revenue (%1)").arg(Currency::code)});
+    QTableView *topSellersTable = new QTableView();
+    setupTableView(topSellersTable, topSellersModel);
+
+    salesTrendModel = new QStandardItemModel(0, 3, this);
+    salesTrendModel->setHorizontalHeaderLabels({"Period", "Units Sold", QString("Revenue (%1)").arg(Currency::code)});
+    QTableView *salesTrendTable = new QTableView();
+    setupTableView(salesTrendTable, salesTrendModel);
+
+    // Create back button
+    QPushButton *backButton = new QPushButton("Back to Admin");
+
+    // Add widgets to layout
+    layout->addWidget(titleLabel);
+    layout->addLayout(rangeLayout);
+    layout->addWidget(new QLabel("Top Sellers"));
+    layout->addWidget(topSellersTable);
+    layout->addWidget(new QLabel("Sales Over Time"));
+    layout->addWidget(salesTrendTable);
+    layout->addWidget(backButton);
+
+    // Connect controls
+    connect(analyticsRange, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::refreshAnalytics);
+    connect(backButton, &QPushButton::clicked, this, &MainWindow::showAdminMode);
+}
+
+void MainWindow::setupTableView(QTableView *view, QAbstractItemModel *model) {
+    view->setModel(model);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->setWordWrap(false);
+    view->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    // Fixed row heights let the view compute its extent without measuring
+    // rows, so only the visible rows of a large catalog are ever touched
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->setDefaultSectionSize(view->fontMetrics().height() + 8);
+}
+
+void MainWindow::showAdminMode() {
+    if (!adminPage) {
+        createAdminPage();
+        stackedWidget->addWidget(adminPage);
     }
+    stackedWidget->setCurrentWidget(adminPage);
+    refreshPerformance();
+}
 
-    // Refresh collection box table
-    QSqlQuery collectionQuery("SELECT THB, Count FROM collection_box_67011755");
-    collectionBoxTable->setRowCount(0);
-    while (collectionQuery.next()) {
-        int row = collectionBoxTable->rowCount();
-        collectionBoxTable->insertRow(row);
-        collectionBoxTable->setItem(row, 0, new QTableWidgetItem(collectionQuery.value(0).toString()));
-        collectionBoxTable->setItem(row, 1, new QTableWidgetItem(collectionQuery.value(1).toString()));
+void MainWindow::setMetricsDump(const QString &path, int intervalMsecs) {
+    metricsDumpTimer.stop();
+    metricsPath = path;
+    if (!path.isEmpty() && intervalMsecs > 0) {
+        metricsDumpTimer.start(intervalMsecs);
     }
+}
 
-    // Refresh user items table
-    QSqlQuery itemsQuery("SELECT item_name, price, stock FROM stock_67011755 WHERE stock > 0");
-    itemsTable->setRowCount(0);
-    while (itemsQuery.next()) {
-        int row = itemsTable->rowCount();
-        itemsTable->insertRow(row);
-        itemsTable->setItem(row, 0, new QTableWidgetItem(itemsQuery.value(0).toString()));
-        itemsTable->setItem(row, 1, new QTableWidgetItem(itemsQuery.value(1).toString()));
-        itemsTable->setItem(row, 2, new QTableWidgetItem(itemsQuery.value(2).toString()));
+void MainWindow::setBackups(const QString &directory, int keep, int intervalMsecs) {
+    backup.setDirectory(directory);
+    backup.setKeep(keep);
+    backupTimer.stop();
+    if (intervalMsecs > 0) {
+        backupTimer.start(intervalMsecs);
     }
 }
 
-void MainWindow::showAdminMode() {
-    stackedWidget->setCurrentWidget(adminPage);
-    refreshTables();
+void MainWindow::refreshPerformance() {
+    if (stackedWidget->currentWidget() != adminPage) {
+        return;
+    }
+
+    // Rows are only appended as metrics register, so update them in place
+    const QVector<const Metrics::Entry *> entries = Metrics::entries();
+    performanceModel->setRowCount(entries.size());
+    for (int row = 0; row < entries.size(); ++row) {
+        const Metrics::Entry *entry = entries.at(row);
+        QStringList values;
+        values << (entry->labels.isEmpty() ? entry->name : entry->name + '{' + entry->labels + '}');
+        if (entry->counter) {
+            values << QString::number(entry->counter->value()) << QString() << QString() << QString() << QString();
+        } else {
+            const LatencyHistogram &histogram = *entry->histogram;
+            values << QString::number(histogram.count())
+                   << QString::number(histogram.percentile(0.5) / 1000.0, 'f', 1)
+                   << QString::number(histogram.percentile(0.99) / 1000.0, 'f', 1)
+                   << QString::number(histogram.percentile(0.999) / 1000.0, 'f', 1)
+                   << QString::number(histogram.max() / 1000.0, 'f', 1);
+        }
+        for (int column = 0; column < values.size(); ++column) {
+            QStandardItem *item = performanceModel->item(row, column);
+            if (!item) {
+                performanceModel->setItem(row, column, new QStandardItem(values.at(column)));
+            } else if (item->text() != values.at(column)) {
+                item->setText(values.at(column));
+            }
+        }
+    }
 }
 
 void MainWindow::showUserMode() {
+    // Pick up sales and restocks made at the other terminals
+    if (multiTerminal && !engine.load()) {
+        QMessageBox::critical(this, "Error", "Failed to load machine state: " + engine.lastError());
+        return;
+    }
     if (!checkOperatingConditions()) {
         QMessageBox::warning(this, "System Status",
                              "Vending machine is currently not operational.\nPlease contact administrator.");
         return;
     }
+    if (!userPage) {
+        createUserPage();
+        stackedWidget->addWidget(userPage);
+    }
     stackedWidget->setCurrentWidget(userPage);
-    refreshTables();
+}
+
+void MainWindow::handleOperationalChanged(bool operational) {
+    if (operational || engine.isOperational() || stackedWidget->currentWidget() != userPage) {
+        return;
+    }
+
+    // The last sale tipped the machine out of service; return any credit
+    // and leave User Mode
+    payment.cancel();
+    stackedWidget->setCurrentWidget(mainPage);
+    QMessageBox::warning(this, "System Status",
+                         "Vending machine is currently not operational.\nPlease contact administrator.");
+}
+
+void MainWindow::handleStorageError(const QString &message) {
+    // The sale already stands in memory and the journal replays it on the
+    // next start, so don't interrupt the customer with a dialog
+    statusBar()->showMessage("Storage error: " + message, 10000);
+}
+
+void MainWindow::showAnalytics() {
+    if (!analyticsPage) {
+        createAnalyticsPage();
+        stackedWidget->addWidget(analyticsPage);
+    }
+    stackedWidget->setCurrentWidget(analyticsPage);
+    refreshAnalytics();
+}
+
+void MainWindow::refreshAnalytics() {
+    int days = analyticsRange->currentData().toInt();
+    QDate today = QDate::currentDate();
+    int fromDay = SalesAnalytics::dayBucket(today.addDays(1 - days));
+    int toDay = SalesAnalytics::dayBucket(today);
+    qint64 fromMsecs = QDateTime(today, QTime(0, 0)).toMSecsSinceEpoch();
+    qint64 toMsecs = QDateTime(today.addDays(1), QTime(0, 0)).toMSecsSinceEpoch();
+
+    // Queries run on the storage thread and read only the rollup tables
+    struct AnalyticsResult {
+        QVector<SalesTotal> topSellers;
+        QVector<SalesTotal> trend;
+        QString error;
+    };
+    auto result = std::make_shared<AnalyticsResult>();
+    QFuture<bool> done = store.submit([=](SqliteVendingStore &storage) {
+        SalesAnalytics analytics(storage.database());
+        bool ok = analytics.topSellers(fromDay, toDay, 10, result->topSellers)
+                  && (days == 1 ? analytics.revenueByHour(fromMsecs, toMsecs, result->trend)
+                                : analytics.revenueByDay(fromDay, toDay, result->trend));
+        result->error = analytics.lastError();
+        return ok;
+    });
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, result, days]() {
+        watcher->deleteLater();
+        if (!watcher->result()) {
+            analyticsSummary->setText("Failed to load sales: " + result->error);
+            return;
+        }
+
+        topSellersModel->setRowCount(0);
+        for (const SalesTotal &total : result->topSellers) {
+            topSellersModel->appendRow({new QStandardItem(total.itemName),
+                                        new QStandardItem(QString::number(total.units)),
+                                        new QStandardItem(QString::number(total.revenue))});
+        }
+
+        qint64 units = 0;
+        qint64 revenue = 0;
+        salesTrendModel->setRowCount(0);
+        for (const SalesTotal &total : result->trend) {
+            QString period = days == 1
+                                 ? QDateTime::fromSecsSinceEpoch(total.bucket).toString("HH:00")
+                                 : QDate(int(total.bucket / 10000), int(total.bucket / 100 % 100),
+                                         int(total.bucket % 100)).toString("yyyy-MM-dd");
+            salesTrendModel->appendRow({new QStandardItem(period),
+                                        new QStandardItem(QString::number(total.units)),
+                                        new QStandardItem(QString::number(total.revenue))});
+            units += total.units;
+            revenue += total.revenue;
+        }
+        analyticsSummary->setText(QString("%1 items sold, %2 %3 revenue").arg(units).arg(revenue).arg(Currency::code));
+    });
+    watcher->setFuture(done);
 }
 
 void MainWindow::returnToMain() {
+    // A customer walking away gets their coins back
+    payment.cancel();
     stackedWidget->setCurrentWidget(mainPage);
 }
 
@@ -307,282 +616,334 @@ void MainWindow::addNewItem() {
     if (!ok || itemName.isEmpty()) return;
 
     int price = QInputDialog::getInt(this, "Add New Item",
-                                     "Enter price (THB):", 0, 0, 10000, 1, &ok);
+                                     QString("Enter price (%1):").arg(Currency::code), 0, 0, 10000, 1, &ok);
     if (!ok) return;
 
     int stock = QInputDialog::getInt(this, "Add New Item",
                                      "Enter initial stock:", 0, 0, 1000, 1, &ok);
     if (!ok) return;
 
-    QSqlQuery query;
-    query.prepare("INSERT INTO stock_67011755 (item_name, price, stock) VALUES (?, ?, ?)");
-    query.addBindValue(itemName.toLower());
-    query.addBindValue(price);
-    query.addBindValue(stock);
-
-    if (query.exec()) {
+    if (engine.addItem(itemName.toLower(), price, stock)) {
         QMessageBox::information(this, "Success", "Item added successfully!");
-        refreshTables();
     } else {
-        QMessageBox::critical(this, "Error", "Failed to add item: " + query.lastError().text());
+        QMessageBox::critical(this, "Error", "Failed to add item: " + engine.lastError());
     }
 }
 
 bool MainWindow::checkOperatingConditions() {
-    QSqlQuery stockQuery("SELECT COUNT(*) FROM stock_67011755 WHERE stock = 0");
-    QSqlQuery totalItemsQuery("SELECT COUNT(*) FROM stock_67011755");
-    QSqlQuery changeQuery("SELECT COUNT(*) FROM change_box_67011755 WHERE Count = 0");
-    QSqlQuery collectionQuery("SELECT THB, Count FROM collection_box_67011755");
-
-    stockQuery.next();
-    totalItemsQuery.next();
-    changeQuery.next();
-
-    int outOfStock = stockQuery.value(0).toInt();
-    int totalItems = totalItemsQuery.value(0).toInt();
-
-    // Check if more than 50% items are out of stock
-    bool lowStock = totalItems > 0 && (outOfStock >= totalItems / 2);
-
-    // Check if change box has any zero count denominations
-    bool insufficientChange = (changeQuery.value(0).toInt() > 0);
-
-    // Check if collection box is full (max 100 for each denomination)
-    bool collectionBoxFull = false;
-    while (collectionQuery.next()) {
-        if (collectionQuery.value(1).toInt() >= 100) {
-            collectionBoxFull = true;
-            break;
-        }
-    }
+    static LatencyHistogram *const latency = Metrics::latency("operating_check");
+    ScopedTimer timer(latency);
 
-    return !(lowStock || insufficientChange || collectionBoxFull);
+    return engine.isOperational();
 }
 
 void MainWindow::deleteItem() {
-    QModelIndexList selectedIndexes = stockTable->selectionModel()->selectedRows();
-    if (selectedIndexes.isEmpty()) {
-        QMessageBox::warning(this, "Delete Item", "Please select an item to delete.");
+    QStringList itemNames = selectedItemNames(stockTable, stockModel, engine.catalog());
+    if (itemNames.isEmpty()) {
+        QMessageBox::warning(this, "Delete Item", "Please select items to delete.");
+        return;
+    }
+    if (itemNames.size() > 1
+        && QMessageBox::question(this, "Delete Items", QString("Delete %1 items?").arg(itemNames.size()))
+               != QMessageBox::Yes) {
         return;
     }
 
-    QString itemName = stockTable->item(selectedIndexes.first().row(), 0)->text();
-    QSqlQuery query;
-    query.prepare("DELETE FROM stock_67011755 WHERE item_name = ?");
-    query.addBindValue(itemName);
-
-    if (query.exec()) {
-        QMessageBox::information(this, "Success", "Item deleted successfully!");
-        refreshTables();
+    if (engine.deleteItems(itemNames)) {
+        QMessageBox::information(this, "Success", QString("%1 item(s) deleted successfully!").arg(itemNames.size()));
     } else {
-        QMessageBox::critical(this, "Error", "Failed to delete item: " + query.lastError().text());
+        QMessageBox::critical(this, "Error", "Failed to delete items: " + engine.lastError());
     }
 }
 
 void MainWindow::restockItem() {
-    QModelIndexList selectedIndexes = stockTable->selectionModel()->selectedRows();
-    if (selectedIndexes.isEmpty()) {
-        QMessageBox::warning(this, "Restock", "Please select an item to restock.");
+    QStringList itemNames = selectedItemNames(stockTable, stockModel, engine.catalog());
+    if (itemNames.isEmpty()) {
+        QMessageBox::warning(this, "Restock", "Please select items to restock.");
         return;
     }
 
-    QString itemName = stockTable->item(selectedIndexes.first().row(), 0)->text();
     bool ok;
-    int amount = QInputDialog::getInt(this, "Restock Item",
-                                      "Enter amount to add:", 0, 0, 1000, 1, &ok);
-    if (!ok) return;
+    QString prompt = itemNames.size() == 1 ? QString("Enter amount to add:")
+                                           : QString("Enter amount to add to each of %1 items:").arg(itemNames.size());
+    int amount = QInputDialog::getInt(this, "Restock Items", prompt, 0, 0, 1000, 1, &ok);
+    if (!ok || amount == 0) return;
+
+    QMap<QString, int> amounts;
+    for (const QString &itemName : itemNames) {
+        amounts.insert(itemName, amount);
+    }
+    if (engine.restockItems(amounts)) {
+        QMessageBox::information(this, "Success", QString("%1 item(s) restocked successfully!").arg(itemNames.size()));
+    } else {
+        QMessageBox::critical(this, "Error", "Failed to restock items: " + engine.lastError());
+    }
+}
 
-    QSqlQuery query;
-    query.prepare("UPDATE stock_67011755 SET stock = stock + ? WHERE item_name = ?");
-    query.addBindValue(amount);
-    query.addBindValue(itemName);
+void MainWindow::restockToPar() {
+    bool ok;
+    int level = QInputDialog::getInt(this, "Restock to Par",
+                                     "Fill every item up to this many units:", parLevel, 1, 1000, 1, &ok);
+    if (!ok) return;
+    parLevel = level;
 
-    if (query.exec()) {
-        QMessageBox::information(this, "Success", "Item restocked successfully!");
-        refreshTables();
+    int below = engine.itemsBelowPar(level);
+    if (below == 0) {
+        QMessageBox::information(this, "Restock to Par", QString("Every item already holds %1 or more.").arg(level));
+        return;
+    }
+    if (engine.restockToPar(level)) {
+        QMessageBox::information(this, "Success", QString("%1 item(s) restocked to %2.").arg(below).arg(level));
     } else {
-        QMessageBox::critical(this, "Error", "Failed to restock item: " + query.lastError().text());
+        QMessageBox::critical(this, "Error", "Failed to restock to par: " + engine.lastError());
     }
 }
 
+// One form for every change denomination, committed as a single refill
 void MainWindow::refillChange() {
-    QStringList denominations = {"20THB", "10THB", "5THB", "1THB"};
-    for (const QString &denom : denominations) {
-        bool ok;
-        int count = QInputDialog::getInt(this, "Refill Change",
-                                         "Enter amount of " + denom + " to add:",
-                                         0, 0, 1000, 1, &ok);
-        if (!ok) continue;
-
-        QSqlQuery query;
-        query.prepare("UPDATE change_box_67011755 SET Count = Count + ? WHERE THB = ?");
-        query.addBindValue(count);
-        query.addBindValue(denom);
-
-        if (!query.exec()) {
-            QMessageBox::critical(this, "Error", "Failed to refill change: " + query.lastError().text());
-            return;
+    QDialog dialog(this);
+    dialog.setWindowTitle("Refill Change");
+    QFormLayout *form = new QFormLayout(&dialog);
+    QMap<int, QSpinBox *> counts;
+    for (int denom : VendingEngine::changeDenominations()) {
+        QSpinBox *count = new QSpinBox();
+        count->setRange(0, 1000);
+        form->addRow(QString("%1 (now %2):").arg(denominationLabel(denom)).arg(engine.changeBox().value(denom)),
+                     count);
+        counts.insert(denom, count);
+    }
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    form->addRow(buttons);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    if (dialog.exec() != QDialog::Accepted) return;
+
+    CoinCounts amounts;
+    for (auto it = counts.constBegin(); it != counts.constEnd(); ++it) {
+        if (it.value()->value() > 0) {
+            amounts[it.key()] = it.value()->value();
         }
     }
+    if (amounts.isEmpty()) return;
+
+    if (!engine.refillChange(amounts)) {
+        QMessageBox::critical(this, "Error", "Failed to refill change: " + engine.lastError());
+        return;
+    }
 
     QMessageBox::information(this, "Success", "Change box refilled successfully!");
-    refreshTables();
 }
 
 void MainWindow::collectMoney() {
-    QSqlQuery query("UPDATE collection_box_67011755 SET Count = 0");
-
-    if (query.exec()) {
+    if (engine.collectMoney()) {
         QMessageBox::information(this, "Success", "Money collected successfully!");
-        refreshTables();
     } else {
-        QMessageBox::critical(this, "Error", "Failed to collect money: " + query.lastError().text());
+        QMessageBox::critical(this, "Error", "Failed to collect money: " + engine.lastError());
     }
 }
 
-// Implement handleItemPurchase function
-void MainWindow::handleItemPurchase() {
-    QModelIndexList selectedIndexes = itemsTable->selectionModel()->selectedRows();
-    if (selectedIndexes.isEmpty()) {
-        QMessageBox::warning(this, "Purchase", "Please select an item to purchase.");
-        return;
+void MainWindow::backupNow() {
+    // Sales carry on while it runs; the result lands in the status bar
+    if (backup.start()) {
+        statusBar()->showMessage("Backing up to " + backup.directory() + "...");
+    } else {
+        statusBar()->showMessage("A backup is already running", 5000);
     }
+}
 
-    int row = selectedIndexes.first().row();
-    QString itemName = itemsTable->item(row, 0)->text();
-    int price = itemsTable->item(row, 1)->text().toInt();
-    int stock = itemsTable->item(row, 2)->text().toInt();
-
-    if (stock <= 0) {
-        QMessageBox::warning(this, "Out of Stock", "Selected item is out of stock.");
-        return;
+void MainWindow::handleBackupFinished(const DatabaseBackup::Result &result) {
+    if (result.ok) {
+        qInfo().noquote() << result.summary();
+    } else {
+        qWarning().noquote() << result.summary();
     }
-
-    processPayment(itemName, price);
+    statusBar()->showMessage(result.summary(), 15000);
 }
 
+void MainWindow::importCatalog() {
+    QString path = QFileDialog::getOpenFileName(this, "Import Catalog", QString(),
+                                                "Catalogs (*.csv *.vcat);;All Files (*)");
+    if (path.isEmpty()) {
+        return;
+    }
 
-// Implement processPayment function
-void MainWindow::processPayment(const QString &itemName, int price) {
-    QStringList validDenominations = {"1", "5", "10", "20", "100"};
-    int totalPayment = 0;
-    QMap<int, int> paymentBreakdown;
-
-    while (totalPayment < price) {
-        bool ok;
-        QString denomination = QInputDialog::getText(this, "Payment",
-                                                     QString("Item Price: %1 THB\nRemaining to pay: %2 THB\n"
-                                                             "Enter denomination (1,5,10,20,100 THB):")
-                                                         .arg(price).arg(price - totalPayment),
-                                                     QLineEdit::Normal, "", &ok);
-
-        if (!ok) return;
-
-        if (!validDenominations.contains(denomination)) {
-            QMessageBox::warning(this, "Invalid Denomination",
-                                 "Please use only 1, 5, 10, 20, or 100 THB denominations.");
-            continue;
+    // Parse and insert on the storage thread, then reload the engine from the
+    // tables once the import has committed
+    auto catalog = std::make_shared<CatalogIO>();
+    QFuture<bool> done = store.submit([catalog, path](SqliteVendingStore &storage) {
+        catalog->setDatabase(storage.database());
+        return catalog->importFile(path);
+    });
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, catalog]() {
+        watcher->deleteLater();
+        if (!watcher->result()) {
+            QMessageBox::critical(this, "Error", "Failed to import catalog: " + catalog->lastError());
+            return;
+        }
+        if (!engine.load()) {
+            QMessageBox::critical(this, "Error", "Failed to reload machine state: " + engine.lastError());
+            return;
         }
 
-        int denomValue = denomination.toInt();
-        totalPayment += denomValue;
-        paymentBreakdown[denomValue]++;
-    }
+        QString message = QString("Imported %1 items.").arg(catalog->rowsImported());
+        if (catalog->rejectedRows() > 0) {
+            message += QString("\n%1 rows were skipped:").arg(catalog->rejectedRows());
+            const QVector<CatalogRowError> &errors = catalog->rowErrors();
+            for (int i = 0; i < qMin(10, errors.size()); ++i) {
+                message += QString("\nRow %1: %2").arg(errors.at(i).row).arg(errors.at(i).message);
+            }
+        }
+        QMessageBox::information(this, "Import Catalog", message);
+    });
+    watcher->setFuture(done);
+}
 
-    if (totalPayment < price) {
-        QMessageBox::warning(this, "Insufficient Payment",
-                             "Payment amount is less than the item price.");
+void MainWindow::exportCatalog() {
+    QString path = QFileDialog::getSaveFileName(this, "Export Catalog", "catalog.csv",
+                                                "CSV (*.csv);;Binary Catalog (*.vcat)");
+    if (path.isEmpty()) {
         return;
     }
 
-    int changeAmount = totalPayment - price;
+    // Queued behind every pending write, so the file matches the engine
+    auto catalog = std::make_shared<CatalogIO>();
+    QFuture<bool> done = store.submit([catalog, path](SqliteVendingStore &storage) {
+        catalog->setDatabase(storage.database());
+        return catalog->exportFile(path);
+    });
+
+    QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+    connect(watcher, &QFutureWatcher<bool>::finished, this, [this, watcher, catalog]() {
+        watcher->deleteLater();
+        if (watcher->result()) {
+            QMessageBox::information(this, "Export Catalog",
+                                     QString("Exported %1 items.").arg(catalog->rowsExported()));
+        } else {
+            QMessageBox::critical(this, "Error", "Failed to export catalog: " + catalog->lastError());
+        }
+    });
+    watcher->setFuture(done);
+}
 
-    // Fetch current change box status
-    QSqlQuery changeQuery("SELECT THB, Count FROM change_box_67011755");
-    QMap<int, int> availableChange;
-    while (changeQuery.next()) {
-        QString denomStr = changeQuery.value(0).toString();
-        int denom = denomStr.replace("THB", "").toInt();
-        int count = changeQuery.value(1).toInt();
-        availableChange[denom] = count;
+// Implement handleItemPurchase function
+void MainWindow::handleItemPurchase() {
+    QModelIndexList selectedIndexes = itemsTable->selectionModel()->selectedRows();
+    if (selectedIndexes.isEmpty()) {
+        paymentStatusLabel->setText("Please select an item to purchase.");
+        return;
     }
 
-    // Calculate and update change
-    QVector<int> denominations = {20, 10, 5, 1};
-    QMap<int, int> changeBreakdown;
-
-    for (int denom : denominations) {
-        int availCount = availableChange[denom];
-        int requiredCount = changeAmount / denom;
-        int actualCount = qMin(requiredCount, availCount);
-
-        if (actualCount > 0) {
-            changeBreakdown[denom] = actualCount;
-            changeAmount -= actualCount * denom;
-        }
-    }
+    // The session sells as soon as the credit covers the price
+    payment.select(engine.catalog().name(itemsModel->itemRow(selectedIndexes.first().row())));
+}
 
-    if (changeAmount > 0) {
-        QMessageBox::warning(this, "Insufficient Change",
-                             "Unable to provide exact change. Please contact an administrator.");
+void MainWindow::addToCart() {
+    QStringList itemNames = selectedItemNames(itemsTable, itemsModel, engine.catalog());
+    if (itemNames.isEmpty()) {
+        paymentStatusLabel->setText("Please select items to add to the cart.");
         return;
     }
-
-    // Update change box
-    QSqlQuery updateChangeQuery;
-    for (auto it = changeBreakdown.begin(); it != changeBreakdown.end(); ++it) {
-        updateChangeQuery.prepare("UPDATE change_box_67011755 SET Count = Count - ? WHERE THB = ?");
-        updateChangeQuery.addBindValue(it.value());
-        updateChangeQuery.addBindValue(QString("%1THB").arg(it.key()));
-        updateChangeQuery.exec();
+    for (const QString &itemName : itemNames) {
+        payment.addToCart(itemName, cartQuantity->value());
     }
+}
 
-    // Update collection box for each payment denomination
-    QSqlQuery collectionQuery;
-    for (auto it = paymentBreakdown.begin(); it != paymentBreakdown.end(); ++it) {
-        collectionQuery.prepare("UPDATE collection_box_67011755 SET Count = Count + ? WHERE THB = ?");
-        collectionQuery.addBindValue(it.value());
-        collectionQuery.addBindValue(QString("%1THB").arg(it.key()));
-        collectionQuery.exec();
+void MainWindow::removeFromCart() {
+    QModelIndexList selectedIndexes = cartTable->selectionModel()->selectedRows();
+    // Highest first, so earlier removals do not shift later rows
+    std::sort(selectedIndexes.begin(), selectedIndexes.end(),
+              [](const QModelIndex &a, const QModelIndex &b) { return a.row() > b.row(); });
+    for (const QModelIndex &index : selectedIndexes) {
+        payment.removeFromCart(index.row());
     }
+}
 
-    // Update stock
-    updateStock(itemName);
-
-    // Show success message
-    QString changeMsg = "Purchase successful.\n\nChange breakdown:\n";
-    for (auto it = changeBreakdown.begin(); it != changeBreakdown.end(); ++it) {
-        changeMsg += QString("%1 x %2 THB\n").arg(it.value()).arg(it.key());
+// The cart holds a few lines, so it is simply rebuilt on every change
+void MainWindow::refreshCart() {
+    const QVector<CartLine> &lines = payment.cart();
+    cartModel->setRowCount(lines.size());
+    for (int i = 0; i < lines.size(); ++i) {
+        int row = engine.findItem(lines.at(i).itemName);
+        int price = row >= 0 ? engine.catalog().price(row) : 0;
+        cartModel->setItem(i, 0, new QStandardItem(lines.at(i).itemName));
+        cartModel->setItem(i, 1, new QStandardItem(QString::number(lines.at(i).quantity)));
+        cartModel->setItem(i, 2, new QStandardItem(QString::number(price * lines.at(i).quantity)));
     }
-    QMessageBox::information(this, "Purchase Complete", changeMsg);
+    cartTotalLabel->setText(QString("Cart: %1 %2").arg(payment.cartTotal()).arg(Currency::code));
+}
 
-    // Refresh tables
-    refreshTables();
+void MainWindow::updateCredit(int credit, int price) {
+    if (!creditLabel) {
+        return;
+    }
+    if (price > 0) {
+        creditLabel->setText(QString("Inserted %1 of %2 %3 for %4")
+                                 .arg(credit).arg(price).arg(Currency::code, payment.selectedItem()));
+    } else {
+        creditLabel->setText(QString("Credit: %1 %2").arg(credit).arg(Currency::code));
+    }
 }
-// Implement calculateChange function (already mostly covered in processPayment)
-void MainWindow::calculateChange(int changeAmount) {
-    QVector<int> denominations = {20, 10, 5, 1};
-    QMap<int, int> changeBreakdown;
 
-    for (int denom : denominations) {
-        int count = changeAmount / denom;
-        if (count > 0) {
-            changeBreakdown[denom] = count;
-            changeAmount %= denom;
-        }
+void MainWindow::handleCoinRejected(int denomination) {
+    if (paymentStatusLabel) {
+        paymentStatusLabel->setText(QString("%1 was returned.").arg(denominationLabel(denomination)));
     }
+}
 
-    // You can use changeBreakdown for further processing if needed
+void MainWindow::handleRefund(const CoinCounts &coins) {
+    if (!paymentStatusLabel) {
+        return;
+    }
+    QStringList returned;
+    for (auto it = coins.constBegin(); it != coins.constEnd(); ++it) {
+        returned << QString("%1 x %2").arg(it.value()).arg(denominationLabel(it.key()));
+    }
+    paymentStatusLabel->setText("Returned: " + returned.join(", "));
 }
 
-void MainWindow::updateStock(const QString &itemName) {
-    QSqlQuery query;
-    query.prepare("UPDATE stock_67011755 SET stock = stock - 1 WHERE item_name = ?");
-    query.addBindValue(itemName);
+void MainWindow::handlePurchaseCompleted(const QString &itemName, const PurchaseResult &result) {
+    if (!paymentStatusLabel) {
+        return;
+    }
 
-    if (!query.exec()) {
-        QMessageBox::critical(this, "Error", "Failed to update stock: " + query.lastError().text());
+    QString message;
+    switch (result.status) {
+    case PurchaseResult::Ok: {
+        QStringList change;
+        for (auto it = result.change.constBegin(); it != result.change.constEnd(); ++it) {
+            change << QString("%1 x %2").arg(it.value()).arg(denominationLabel(it.key()));
+        }
+        message = QString("Purchase successful: %1. Change: %2")
+                      .arg(itemName, change.isEmpty() ? QString("none") : change.join(", "));
+        break;
+    }
+    case PurchaseResult::UnknownItem:
+    case PurchaseResult::OutOfStock:
+        message = result.refusedItem.isEmpty() ? QString("Selected item is out of stock.")
+                                               : QString("Not enough %1 in stock.").arg(result.refusedItem);
+        break;
+    case PurchaseResult::InvalidDenomination:
+        message = "Please use only " + acceptedDenominationsText() + " denominations.";
+        break;
+    case PurchaseResult::InsufficientPayment:
+        message = "Payment amount is less than the item price.";
+        break;
+    case PurchaseResult::InsufficientChange:
+        message = "Unable to provide exact change. Please choose another item or cancel.";
+        break;
+    case PurchaseResult::PaymentTooLarge:
+        message = "Payment amount is too large. Please cancel and pay again.";
+        break;
+    case PurchaseResult::InvalidQuantity:
+        message = QString("A cart holds 1 to %1 units in all.").arg(VendingEngine::kMaxCartUnits);
+        break;
+    case PurchaseResult::StorageError:
+        message = "Failed to record purchase: " + engine.lastError();
+        break;
     }
+    paymentStatusLabel->setText(message);
 }
 
 MainWindow::~MainWindow() {
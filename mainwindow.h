@@ -9,56 +9,144 @@
 #include <QLabel>
 #include <QGridLayout>
 #include <QStackedWidget>
-#include <QTableWidget>
+#include <QTableView>
 #include <QMessageBox>
 #include <QInputDialog>
-#include <QSqlTableModel>
 #include <QHeaderView>
+#include <QComboBox>
+#include <QSpinBox>
+#include <QStandardItemModel>
+#include <QTimer>
+#include "vendingengine.h"
+#include "vendingmodels.h"
+#include "asyncstore.h"
+#include "paymentsession.h"
+#include "coinsource.h"
+#include "controlserver.h"
+#include "databasebackup.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    // multiTerminal shares the database with other terminals, which then
+    // keeps no local journal
+    explicit MainWindow(bool multiTerminal = false, QWidget *parent = nullptr);
     ~MainWindow();
 
+    void setGroupCommitWindow(int msecs);
+
+    // Accept coin and selection events from a local socket named name
+    bool setCoinAcceptor(const QString &name);
+
+    // Serve the control API on a local socket and/or a localhost TCP port;
+    // an empty name or port 0 leaves that one off
+    bool setControlServer(const QString &socketName, quint16 tcpPort);
+    void setChangePolicy(ChangeSolver::Policy policy);
+
+    // Write all metrics to path in OpenMetrics format every intervalMsecs
+    void setMetricsDump(const QString &path, int intervalMsecs);
+
+    // Back the database up online into directory every intervalMsecs
+    // (0 = only from the admin page), keeping the newest keep
+    void setBackups(const QString &directory, int keep, int intervalMsecs);
+
 private:
     // GUI Elements
     QWidget *centralWidget;
     QStackedWidget *stackedWidget;
     QWidget *mainPage;
-    QWidget *adminPage;
-    QWidget *userPage;
-    QTableWidget *stockTable;
-    QTableWidget *changeBoxTable;
-    QTableWidget *collectionBoxTable;
-    QTableWidget *itemsTable;
-
-    // Database Models
-    QSqlTableModel *stockModel;
-    QSqlTableModel *changeBoxModel;
-    QSqlTableModel *collectionBoxModel;
+    QWidget *adminPage = nullptr;     // built on first navigation
+    QWidget *userPage = nullptr;
+    QWidget *analyticsPage = nullptr;
+    QTableView *stockTable;
+    QTableView *changeBoxTable;
+    QTableView *collectionBoxTable;
+    QTableView *itemsTable;
+
+    // Table models over the engine state
+    StockTableModel *stockModel;
+    BoxTableModel *changeBoxModel;
+    BoxTableModel *collectionBoxModel;
+    StockTableModel *itemsModel;
+
+    // Payment progress on the user page
+    QLabel *creditLabel = nullptr;
+    QLabel *paymentStatusLabel = nullptr;
+
+    // Items gathered for one checkout on the user page
+    QTableView *cartTable = nullptr;
+    QStandardItemModel *cartModel = nullptr;
+    QSpinBox *cartQuantity = nullptr;
+    QLabel *cartTotalLabel = nullptr;
+
+    // Sales analytics, filled from the rollup tables
+    QComboBox *analyticsRange;
+    QLabel *analyticsSummary;
+    QStandardItemModel *topSellersModel;
+    QStandardItemModel *salesTrendModel;
+
+    // Performance section of the admin page
+    QStandardItemModel *performanceModel;
+    QTimer performanceTimer;
+    QTimer metricsDumpTimer;
+    QString metricsPath;
+
+    // Purchase engine and its persistence; all SQL runs on the store's thread
+    TransactionJournal journal;
+    AsyncVendingStore store;
+    VendingEngine engine;
+    bool multiTerminal = false;
+
+    // Coins and selections from the buttons and any attached acceptor
+    PaymentSession payment;
+    LocalSocketCoinSource *coinAcceptor = nullptr;
+
+    // Fleet managers and kiosk software
+    ControlServer *controlServer = nullptr;
+
+    // Last level used by "Restock to Par"
+    int parLevel = 20;
+
+    // Online backups, on demand and on a timer
+    DatabaseBackup backup;
+    QTimer backupTimer;
 
     // Methods
     void setupUi();
     void createMainPage();
     void createAdminPage();
     void createUserPage();
-    void refreshTables();
+    void createAnalyticsPage();
+    void setupTableView(QTableView *view, QAbstractItemModel *model);
     bool checkOperatingConditions();
-    void processPayment(const QString &itemName, int price);
-    void calculateChange(int changeAmount);
-    void updateStock(const QString &itemName);
 
 private slots:
     void showAdminMode();
     void showUserMode();
+    void showAnalytics();
+    void refreshAnalytics();
+    void refreshPerformance();
     void addNewItem();
     void deleteItem();
     void restockItem();
+    void restockToPar();
     void refillChange();
     void collectMoney();
+    void importCatalog();
+    void exportCatalog();
+    void backupNow();
+    void handleBackupFinished(const DatabaseBackup::Result &result);
     void handleItemPurchase();
+    void addToCart();
+    void removeFromCart();
+    void refreshCart();
+    void updateCredit(int credit, int price);
+    void handleCoinRejected(int denomination);
+    void handleRefund(const CoinCounts &coins);
+    void handlePurchaseCompleted(const QString &itemName, const PurchaseResult &result);
+    void handleOperationalChanged(bool operational);
+    void handleStorageError(const QString &message);
     void returnToMain();
 };
 
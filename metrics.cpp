@@ -0,0 +1,205 @@
+// metrics.cpp
+#include "metrics.h"
+#include <QFile>
+#include <QMap>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtAlgorithms>
+#include <cmath>
+#include <limits>
+
+namespace {
+// Writes a finished dump off the calling thread
+class DumpTask : public QRunnable {
+public:
+    DumpTask(const QString &path, const QString &text) : path(path), text(text) {
+    }
+
+    void run() override {
+        QString temporary = path + ".tmp";
+        QFile file(temporary);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            return;
+        }
+        file.write(text.toUtf8());
+        file.close();
+        QFile::remove(path);
+        QFile::rename(temporary, path);
+    }
+
+private:
+    QString path;
+    QString text;
+};
+
+QString sampleName(const QString &name, const QString &labels, const QString &extraLabel = QString()) {
+    QString all = labels;
+    if (!extraLabel.isEmpty()) {
+        all += (all.isEmpty() ? "" : ",") + extraLabel;
+    }
+    return all.isEmpty() ? name : name + '{' + all + '}';
+}
+
+QString seconds(double nsecs) {
+    return QString::number(nsecs / 1e9, 'g', 9);
+}
+}
+
+int LatencyHistogram::bucketIndex(quint64 nsecs) {
+    if (nsecs < quint64(kSubBuckets)) {
+        return int(nsecs);
+    }
+    int msb = 63 - qCountLeadingZeroBits(nsecs);
+    int shift = msb - kSubBucketBits;
+    int sub = int(nsecs >> shift) & (kSubBuckets - 1);
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index) {
+    if (index < kSubBuckets) {
+        return quint64(index) + 1;
+    }
+    if (index >= kBuckets - 1) {
+        return std::numeric_limits<quint64>::max();
+    }
+    int shift = index / kSubBuckets - 1;
+    int sub = index % kSubBuckets;
+    return quint64(kSubBuckets + sub + 1) << shift;
+}
+
+void LatencyHistogram::record(qint64 nsecs) {
+    quint64 value = nsecs > 0 ? quint64(nsecs) : 0;
+    buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    samples.fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(value, std::memory_order_relaxed);
+
+    quint64 seen = largest.load(std::memory_order_relaxed);
+    while (value > seen && !largest.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+    }
+}
+
+qint64 LatencyHistogram::percentile(double fraction) const {
+    quint64 samplesSeen = count();
+    if (samplesSeen == 0) {
+        return 0;
+    }
+
+    quint64 rank = quint64(std::ceil(qBound(0.0, fraction, 1.0) * samplesSeen));
+    rank = qMax<quint64>(rank, 1);
+    quint64 seen = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        seen += bucketCount(i);
+        if (seen >= rank) {
+            return qMin(qint64(bucketUpperBound(i)), max());
+        }
+    }
+    return max();
+}
+
+Metrics &Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+Metrics::Entry *Metrics::find(const QString &name, const QString &labels) {
+    for (const auto &entry : registered) {
+        if (entry->name == name && entry->labels == labels) {
+            return entry.get();
+        }
+    }
+    return nullptr;
+}
+
+Counter *Metrics::counter(const QString &name, const QString &help, const QString &labels) {
+    Metrics &metrics = instance();
+    QMutexLocker locker(&metrics.mutex);
+    Entry *entry = metrics.find(name, labels);
+    if (!entry) {
+        metrics.registered.emplace_back(new Entry{name, help, labels, nullptr, nullptr});
+        entry = metrics.registered.back().get();
+        entry->counter.reset(new Counter);
+    }
+    return entry->counter.get();
+}
+
+LatencyHistogram *Metrics::histogram(const QString &name, const QString &help, const QString &labels) {
+    Metrics &metrics = instance();
+    QMutexLocker locker(&metrics.mutex);
+    Entry *entry = metrics.find(name, labels);
+    if (!entry) {
+        metrics.registered.emplace_back(new Entry{name, help, labels, nullptr, nullptr});
+        entry = metrics.registered.back().get();
+        entry->histogram.reset(new LatencyHistogram);
+    }
+    return entry->histogram.get();
+}
+
+LatencyHistogram *Metrics::latency(const char *path) {
+    return histogram("vending_latency_seconds", "Time spent on vending machine hot paths.",
+                     QString("path=\"%1\"").arg(path));
+}
+
+LatencyHistogram *Metrics::startup(const char *phase) {
+    return histogram("vending_startup_seconds", "Time from launch until ready to serve.",
+                     QString("phase=\"%1\"").arg(phase));
+}
+
+QVector<const Metrics::Entry *> Metrics::entries() {
+    Metrics &metrics = instance();
+    QMutexLocker locker(&metrics.mutex);
+    QVector<const Entry *> all;
+    for (const auto &entry : metrics.registered) {
+        all.append(entry.get());
+    }
+    return all;
+}
+
+QString Metrics::openMetricsText() {
+    // Samples of one family must be contiguous, so group by name first
+    QMap<QString, QVector<const Entry *>> families;
+    for (const Entry *entry : entries()) {
+        families[entry->name].append(entry);
+    }
+
+    QString text;
+    QTextStream out(&text);
+    for (auto family = families.constBegin(); family != families.constEnd(); ++family) {
+        const Entry *first = family.value().first();
+        out << "# TYPE " << family.key() << (first->counter ? " counter\n" : " histogram\n");
+        out << "# HELP " << family.key() << ' ' << first->help << '\n';
+
+        for (const Entry *entry : family.value()) {
+            if (entry->counter) {
+                out << sampleName(entry->name + "_total", entry->labels) << ' '
+                    << entry->counter->value() << '\n';
+                continue;
+            }
+
+            // Only occupied buckets are listed; le values are cumulative
+            const LatencyHistogram &histogram = *entry->histogram;
+            quint64 cumulative = 0;
+            for (int i = 0; i < LatencyHistogram::kBuckets; ++i) {
+                quint64 bucket = histogram.bucketCount(i);
+                if (bucket == 0) {
+                    continue;
+                }
+                cumulative += bucket;
+                QString le = QString("le=\"%1\"").arg(seconds(LatencyHistogram::bucketUpperBound(i)));
+                out << sampleName(entry->name + "_bucket", entry->labels, le) << ' ' << cumulative << '\n';
+            }
+            out << sampleName(entry->name + "_bucket", entry->labels, "le=\"+Inf\"") << ' '
+                << qMax(cumulative, histogram.count()) << '\n';
+            out << sampleName(entry->name + "_count", entry->labels) << ' ' << histogram.count() << '\n';
+            out << sampleName(entry->name + "_sum", entry->labels) << ' ' << seconds(histogram.sum()) << '\n';
+        }
+    }
+    out << "# EOF\n";
+    out.flush();
+    return text;
+}
+
+void Metrics::dumpAsync(const QString &path) {
+    QThreadPool::globalInstance()->start(new DumpTask(path, openMetricsText()));
+}
@@ -0,0 +1,106 @@
+// metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Monotonic event count; safe to bump from any thread
+class Counter {
+public:
+    void increment(quint64 n = 1) { total.fetch_add(n, std::memory_order_relaxed); }
+    quint64 value() const { return total.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> total{0};
+};
+
+// Log-linear (HDR-style) latency histogram in nanoseconds. Each power of two
+// is split into 16 linear sub-buckets, so a value is reported within 1/16 of
+// itself from 16 ns up to hours. Recording is a few relaxed atomic adds: no
+// locks, no allocation, safe from any thread.
+class LatencyHistogram {
+public:
+    static const int kSubBucketBits = 4;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    void record(qint64 nsecs);
+
+    quint64 count() const { return samples.load(std::memory_order_relaxed); }
+    quint64 sum() const { return total.load(std::memory_order_relaxed); }
+    qint64 max() const { return qint64(largest.load(std::memory_order_relaxed)); }
+    quint64 bucketCount(int index) const { return buckets[index].load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the given fraction of samples, in ns
+    qint64 percentile(double fraction) const;
+
+    static int bucketIndex(quint64 nsecs);
+    static quint64 bucketUpperBound(int index); // exclusive
+
+private:
+    std::atomic<quint64> buckets[kBuckets]{};
+    std::atomic<quint64> samples{0};
+    std::atomic<quint64> total{0};
+    std::atomic<quint64> largest{0};
+};
+
+// Records the lifetime of the enclosing scope into a histogram
+class ScopedTimer {
+public:
+    explicit ScopedTimer(LatencyHistogram *histogram) : histogram(histogram) { timer.start(); }
+    ~ScopedTimer() { histogram->record(timer.nsecsElapsed()); }
+
+private:
+    LatencyHistogram *histogram;
+    QElapsedTimer timer;
+};
+
+// Process-wide registry. Registering takes a lock, so call sites look their
+// metric up once (e.g. into a function-local static) and keep the pointer;
+// metrics live until exit.
+class Metrics {
+public:
+    struct Entry {
+        QString name;
+        QString help;
+        QString labels;   // OpenMetrics label set without braces, e.g. path="purchase"
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<LatencyHistogram> histogram;
+    };
+
+    static Counter *counter(const QString &name, const QString &help, const QString &labels = QString());
+    static LatencyHistogram *histogram(const QString &name, const QString &help,
+                                       const QString &labels = QString());
+
+    // Shorthand for the vending_latency_seconds{path="..."} family
+    static LatencyHistogram *latency(const char *path);
+
+    // The vending_startup_seconds{phase="..."} family, shared by the GUI and
+    // headless mode so both describe it the same way
+    static LatencyHistogram *startup(const char *phase);
+
+    // Registered metrics in registration order
+    static QVector<const Entry *> entries();
+
+    // Current values in OpenMetrics text format
+    static QString openMetricsText();
+
+    // Write openMetricsText() to path on a pool thread, replacing the file
+    // atomically so scrapers never see a partial dump
+    static void dumpAsync(const QString &path);
+
+private:
+    static Metrics &instance();
+    Entry *find(const QString &name, const QString &labels);
+
+    QMutex mutex;
+    std::vector<std::unique_ptr<Entry>> registered;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,81 @@
+// operatingstatus.h
+#ifndef OPERATINGSTATUS_H
+#define OPERATINGSTATUS_H
+
+#include <QtGlobal>
+#include "currency.h"
+
+// Counters behind the operating conditions, kept up to date by the engine on
+// every mutation so that checking them is O(1) and needs no queries.
+class OperatingStatus {
+public:
+    // Collection box holds at most this many of each denomination
+    static const int kCollectionCapacity = Currency::collectionCapacity;
+
+    void clear() {
+        totalItems = 0;
+        outOfStockItems = 0;
+        emptyChangeDenominations = 0;
+        fullCollectionDenominations = 0;
+        maxFill = 0;
+    }
+
+    void itemAdded(int stock) {
+        totalItems++;
+        if (stock == 0) {
+            outOfStockItems++;
+        }
+    }
+
+    void itemRemoved(int stock) {
+        totalItems--;
+        if (stock == 0) {
+            outOfStockItems--;
+        }
+    }
+
+    void stockChanged(int oldStock, int newStock) {
+        outOfStockItems += (newStock == 0) - (oldStock == 0);
+    }
+
+    void changeCountChanged(int oldCount, int newCount) {
+        emptyChangeDenominations += (newCount == 0) - (oldCount == 0);
+    }
+
+    void collectionCountChanged(int oldCount, int newCount) {
+        fullCollectionDenominations += (newCount >= kCollectionCapacity) - (oldCount >= kCollectionCapacity);
+        maxFill = qMax(maxFill, newCount);
+    }
+
+    // Counts only fall when the box is emptied, which resets every
+    // denomination together
+    void collectionEmptied() {
+        fullCollectionDenominations = 0;
+        maxFill = 0;
+    }
+
+    int itemCount() const { return totalItems; }
+    int outOfStockCount() const { return outOfStockItems; }
+    int emptyChangeCount() const { return emptyChangeDenominations; }
+    int fullCollectionCount() const { return fullCollectionDenominations; }
+    int maxCollectionFill() const { return maxFill; }
+
+    // Not operational when half or more of the items are out of stock, any
+    // change denomination has run out, or any collection slot is full
+    bool lowStock() const { return totalItems > 0 && outOfStockItems >= totalItems / 2; }
+    bool insufficientChange() const { return emptyChangeDenominations > 0; }
+    bool collectionBoxFull() const { return fullCollectionDenominations > 0; }
+
+    bool isOperational() const {
+        return !(lowStock() || insufficientChange() || collectionBoxFull());
+    }
+
+private:
+    int totalItems = 0;
+    int outOfStockItems = 0;
+    int emptyChangeDenominations = 0;
+    int fullCollectionDenominations = 0;
+    int maxFill = 0;
+};
+
+#endif // OPERATINGSTATUS_H
@@ -0,0 +1,175 @@
+// paymentsession.cpp
+#include "paymentsession.h"
+#include "metrics.h"
+#include <QStringList>
+#include <chrono>
+
+PaymentSession::PaymentSession(VendingEngine *engine, QObject *parent)
+    : QObject(parent), engine(engine) {
+}
+
+PaymentSession::State PaymentSession::state() const {
+    if (!itemName.isEmpty()) {
+        return Selected;
+    }
+    return total > 0 ? Collecting : Idle;
+}
+
+qint64 PaymentSession::timestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PaymentSession::insertCoin(int denomination, qint64 sentAtNsecs) {
+    static LatencyHistogram *const latency = Metrics::latency("coin");
+    static Counter *const rejected =
+        Metrics::counter("vending_coins_rejected", "Coins returned straight away by the acceptor.");
+
+    // Out of service, the acceptor hands every coin straight back
+    if (!VendingEngine::isAcceptedDenomination(denomination) || !engine->isOperational()) {
+        rejected->increment();
+        emit coinRejected(denomination);
+    } else {
+        coins[denomination]++;
+        total += denomination;
+        if (itemName.isEmpty()) {
+            emit creditChanged(total, 0);
+        } else if (total >= price) {
+            tryPurchase();
+        } else {
+            emit creditChanged(total, price);
+        }
+    }
+
+    if (sentAtNsecs > 0) {
+        latency->record(timestamp() - sentAtNsecs);
+    }
+}
+
+void PaymentSession::select(const QString &item) {
+    int row = engine->findItem(item);
+    if (row < 0) {
+        PurchaseResult result;
+        result.status = PurchaseResult::UnknownItem;
+        emit completed(item, result);
+        return;
+    }
+
+    clearSelection();
+    itemName = item;
+    price = engine->catalog().price(row);
+    if (total >= price) {
+        tryPurchase();
+    } else {
+        emit creditChanged(total, price);
+    }
+}
+
+int PaymentSession::cartTotal() const {
+    int sum = 0;
+    for (const CartLine &line : lines) {
+        int row = engine->findItem(line.itemName);
+        if (row >= 0) {
+            sum += engine->catalog().price(row) * line.quantity;
+        }
+    }
+    return sum;
+}
+
+QString PaymentSession::describe(const QVector<CartLine> &lines) {
+    QStringList parts;
+    for (const CartLine &line : lines) {
+        parts << (line.quantity == 1 ? line.itemName : QString("%1 x%2").arg(line.itemName).arg(line.quantity));
+    }
+    return parts.join(", ");
+}
+
+void PaymentSession::addToCart(const QString &item, int quantity) {
+    if (engine->findItem(item) < 0) {
+        PurchaseResult result;
+        result.status = PurchaseResult::UnknownItem;
+        result.refusedItem = item;
+        emit completed(item, result);
+        return;
+    }
+
+    int index = 0;
+    while (index < lines.size() && lines.at(index).itemName != item) {
+        ++index;
+    }
+    if (index == lines.size()) {
+        if (quantity <= 0) {
+            return;
+        }
+        lines.append({item, quantity});
+    } else if (lines[index].quantity + quantity > 0) {
+        lines[index].quantity += quantity;
+    } else {
+        lines.remove(index);
+    }
+    emit cartChanged();
+}
+
+void PaymentSession::removeFromCart(int index) {
+    if (index < 0 || index >= lines.size()) {
+        return;
+    }
+    lines.remove(index);
+    emit cartChanged();
+}
+
+void PaymentSession::checkout() {
+    if (lines.isEmpty()) {
+        return;
+    }
+
+    clearSelection();
+    checkingOut = true;
+    itemName = describe(lines);
+    price = cartTotal();
+    if (total >= price) {
+        tryPurchase();
+    } else {
+        emit creditChanged(total, price);
+    }
+}
+
+void PaymentSession::cancel() {
+    clearSelection();
+    if (!lines.isEmpty()) {
+        lines.clear();
+        emit cartChanged();
+    }
+    if (total > 0) {
+        CoinCounts returned = coins;
+        coins.clear();
+        total = 0;
+        emit refunded(returned);
+    }
+    emit creditChanged(0, 0);
+}
+
+void PaymentSession::tryPurchase() {
+    QString item = itemName;
+    bool cart = checkingOut;
+    PurchaseResult result = cart ? engine->purchaseCart(lines, coins) : engine->purchase(item, coins);
+    clearSelection();
+
+    // The engine has taken the coins and returned the change
+    if (result.status == PurchaseResult::Ok) {
+        coins.clear();
+        total = 0;
+        if (cart) {
+            lines.clear();
+            emit cartChanged();
+        }
+    }
+    emit completed(item, result);
+    emit creditChanged(total, 0);
+}
+
+void PaymentSession::clearSelection() {
+    itemName.clear();
+    price = 0;
+    checkingOut = false;
+}
@@ -0,0 +1,81 @@
+// paymentsession.h
+#ifndef PAYMENTSESSION_H
+#define PAYMENTSESSION_H
+
+#include <QObject>
+#include <QString>
+#include "vendingengine.h"
+
+// One customer's payment as an event-driven state machine. Coins build up
+// credit one event at a time, before or after an item is selected, as on a
+// real acceptor; the sale runs as soon as the selected item is covered, and
+// credit that was not spent is returned on cancel. Nothing here blocks, so
+// coins can arrive from buttons, a device or a simulator at any rate.
+//
+// Several items can also be gathered in a cart and checked out together:
+// the whole cart is then the selection, paid for once, with one change
+// solve and one commit for all of it.
+class PaymentSession : public QObject {
+    Q_OBJECT
+
+public:
+    enum State {
+        Idle,       // no credit, nothing selected
+        Collecting, // credit inserted, nothing selected
+        Selected    // item or cart selected, credit short of its price
+    };
+
+    explicit PaymentSession(VendingEngine *engine, QObject *parent = nullptr);
+
+    State state() const;
+    int credit() const { return total; }
+    const CoinCounts &inserted() const { return coins; }
+    const QString &selectedItem() const { return itemName; }
+    int selectedPrice() const { return price; }
+
+    const QVector<CartLine> &cart() const { return lines; }
+    int cartTotal() const;
+
+    // "Cola x2, Water", as shown to the customer
+    static QString describe(const QVector<CartLine> &lines);
+
+    // Steady-clock nanoseconds, comparable across processes on one host;
+    // coin sources stamp events with it to measure end-to-end latency
+    static qint64 timestamp();
+
+public slots:
+    // sentAtNsecs is the timestamp() at which the coin was seen, or 0
+    void insertCoin(int denomination, qint64 sentAtNsecs = 0);
+    void select(const QString &itemName);
+    // Merges with a line of the same item; a line brought to zero units
+    // or fewer is removed
+    void addToCart(const QString &itemName, int quantity = 1);
+    void removeFromCart(int index);
+    // Selects the whole cart; it sells once the credit covers its total
+    void checkout();
+    // Returns the credit and empties the cart
+    void cancel();
+
+signals:
+    // price is 0 while nothing is selected
+    void creditChanged(int credit, int price);
+    void coinRejected(int denomination);
+    // Every sale attempted, successful or not; on failure the credit stays
+    void completed(const QString &itemName, const PurchaseResult &result);
+    void refunded(const CoinCounts &coins);
+    void cartChanged();
+
+private:
+    void tryPurchase();
+    void clearSelection();
+
+    VendingEngine *engine;
+    CoinCounts coins;
+    int total = 0;
+    QString itemName;
+    int price = 0;
+    QVector<CartLine> lines;
+    bool checkingOut = false; // the selection is the cart
+};
+
+#endif // PAYMENTSESSION_H
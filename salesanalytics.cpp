@@ -0,0 +1,89 @@
+// salesanalytics.cpp
+#include "salesanalytics.h"
+#include <QDateTime>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QVariant>
+
+qint64 SalesAnalytics::hourBucket(qint64 msecs) {
+    qint64 seconds = msecs / 1000;
+    return seconds - seconds % 3600;
+}
+
+int SalesAnalytics::dayBucket(qint64 msecs) {
+    return dayBucket(QDateTime::fromMSecsSinceEpoch(msecs).date());
+}
+
+int SalesAnalytics::dayBucket(const QDate &date) {
+    return date.year() * 10000 + date.month() * 100 + date.day();
+}
+
+SalesAnalytics::SalesAnalytics(const QSqlDatabase &db) : db(db) {
+}
+
+bool SalesAnalytics::topSellers(int fromDay, int toDay, int limit, QVector<SalesTotal> &totals) {
+    QSqlQuery query(db);
+    query.prepare("SELECT item_name, SUM(units), SUM(revenue) FROM sales_daily_67011755 "
+                  "WHERE day BETWEEN ? AND ? GROUP BY item_name ORDER BY 2 DESC, 3 DESC LIMIT ?");
+    query.addBindValue(fromDay);
+    query.addBindValue(toDay);
+    query.addBindValue(limit);
+    if (!query.exec()) {
+        errorText = query.lastError().text();
+        return false;
+    }
+
+    totals.clear();
+    while (query.next()) {
+        SalesTotal total;
+        total.itemName = query.value(0).toString();
+        total.units = query.value(1).toLongLong();
+        total.revenue = query.value(2).toLongLong();
+        totals.append(total);
+    }
+    return true;
+}
+
+bool SalesAnalytics::revenueByDay(int fromDay, int toDay, QVector<SalesTotal> &totals) {
+    QSqlQuery query(db);
+    query.prepare("SELECT day, SUM(units), SUM(revenue) FROM sales_daily_67011755 "
+                  "WHERE day BETWEEN ? AND ? GROUP BY day ORDER BY day");
+    query.addBindValue(fromDay);
+    query.addBindValue(toDay);
+    if (!query.exec()) {
+        errorText = query.lastError().text();
+        return false;
+    }
+
+    totals.clear();
+    while (query.next()) {
+        SalesTotal total;
+        total.bucket = query.value(0).toLongLong();
+        total.units = query.value(1).toLongLong();
+        total.revenue = query.value(2).toLongLong();
+        totals.append(total);
+    }
+    return true;
+}
+
+bool SalesAnalytics::revenueByHour(qint64 fromMsecs, qint64 toMsecs, QVector<SalesTotal> &totals) {
+    QSqlQuery query(db);
+    query.prepare("SELECT hour, SUM(units), SUM(revenue) FROM sales_hourly_67011755 "
+                  "WHERE hour >= ? AND hour < ? GROUP BY hour ORDER BY hour");
+    query.addBindValue(hourBucket(fromMsecs));
+    query.addBindValue(toMsecs / 1000);
+    if (!query.exec()) {
+        errorText = query.lastError().text();
+        return false;
+    }
+
+    totals.clear();
+    while (query.next()) {
+        SalesTotal total;
+        total.bucket = query.value(0).toLongLong();
+        total.units = query.value(1).toLongLong();
+        total.revenue = query.value(2).toLongLong();
+        totals.append(total);
+    }
+    return true;
+}
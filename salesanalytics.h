@@ -0,0 +1,48 @@
+// salesanalytics.h
+#ifndef SALESANALYTICS_H
+#define SALESANALYTICS_H
+
+#include <QDate>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVector>
+
+// One row of an analytics answer: per item, per day or per hour
+struct SalesTotal {
+    qint64 bucket = 0;    // day or hour key; 0 for per-item totals
+    QString itemName;     // empty for per-period totals
+    qint64 units = 0;
+    qint64 revenue = 0;
+};
+
+// Queries over the hourly and daily sales rollups that SqliteVendingStore
+// maintains with every sale. The per-sale table is never scanned, so the cost
+// depends on the number of buckets and items in range, not on sales volume.
+class SalesAnalytics {
+public:
+    // Hour keys are the epoch second starting the hour; day keys are the
+    // local date as yyyymmdd
+    static qint64 hourBucket(qint64 msecs);
+    static int dayBucket(qint64 msecs);
+    static int dayBucket(const QDate &date);
+
+    // The connection must be used on the thread that opened it
+    explicit SalesAnalytics(const QSqlDatabase &db = QSqlDatabase());
+
+    // Best sellers by units over the days [fromDay, toDay]
+    bool topSellers(int fromDay, int toDay, int limit, QVector<SalesTotal> &totals);
+
+    // Units and revenue per day over [fromDay, toDay]
+    bool revenueByDay(int fromDay, int toDay, QVector<SalesTotal> &totals);
+
+    // Units and revenue per hour over [fromMsecs, toMsecs)
+    bool revenueByHour(qint64 fromMsecs, qint64 toMsecs, QVector<SalesTotal> &totals);
+
+    QString lastError() const { return errorText; }
+
+private:
+    QSqlDatabase db;
+    QString errorText;
+};
+
+#endif // SALESANALYTICS_H
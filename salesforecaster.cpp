@@ -0,0 +1,61 @@
+// salesforecaster.cpp
+#include "salesforecaster.h"
+#include <QDateTime>
+#include <cmath>
+
+SalesForecaster::SalesForecaster(qint64 windowMsecs)
+    : windowMsecs(double(qMax<qint64>(1, windowMsecs))), originMsecs(QDateTime::currentMSecsSinceEpoch()) {
+}
+
+void SalesForecaster::add(Rate &rate, double units, qint64 atMsecs) const {
+    // A sale stamped before the last one (e.g. after a clock step) counts
+    // as simultaneous with it
+    qint64 elapsed = qMax<qint64>(0, atMsecs - rate.atMsecs);
+    rate.value = rate.value * std::exp(-elapsed / windowMsecs) + units / windowMsecs;
+    rate.atMsecs = qMax(rate.atMsecs, atMsecs);
+}
+
+double SalesForecaster::perHour(const Rate &rate, qint64 nowMsecs) const {
+    if (rate.value <= 0) {
+        return 0;
+    }
+    qint64 elapsed = qMax<qint64>(0, nowMsecs - rate.atMsecs);
+    double decayed = rate.value * std::exp(-elapsed / windowMsecs);
+
+    // At least an hour, so the first sales after a start do not project
+    // an absurd rate
+    double observed = qMax<double>(3600 * 1000.0, nowMsecs - originMsecs);
+    return decayed / (1 - std::exp(-observed / windowMsecs)) * 3600 * 1000.0;
+}
+
+void SalesForecaster::recordSale(const QString &itemName, const CoinCounts &payment, qint64 atMsecs,
+                                 int quantity) {
+    originMsecs = qMin(originMsecs, atMsecs);
+    add(items[itemName], quantity, atMsecs);
+    for (auto it = payment.constBegin(); it != payment.constEnd(); ++it) {
+        if (it.value() > 0) {
+            add(coins[it.key()], it.value(), atMsecs);
+        }
+    }
+}
+
+double SalesForecaster::itemRate(const QString &itemName, qint64 nowMsecs) const {
+    auto it = items.constFind(itemName);
+    return it == items.constEnd() ? 0 : perHour(*it, nowMsecs);
+}
+
+double SalesForecaster::coinRate(int denomination, qint64 nowMsecs) const {
+    auto it = coins.constFind(denomination);
+    return it == coins.constEnd() ? 0 : perHour(*it, nowMsecs);
+}
+
+double SalesForecaster::hoursUntil(int remaining, double perHour) {
+    if (remaining <= 0) {
+        return 0;
+    }
+    // Under one unit a year is as good as not selling
+    if (perHour < 1.0 / (365 * 24)) {
+        return -1;
+    }
+    return remaining / perHour;
+}
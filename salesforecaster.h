@@ -0,0 +1,50 @@
+// salesforecaster.h
+#ifndef SALESFORECASTER_H
+#define SALESFORECASTER_H
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include "changesolver.h"
+
+// Streaming estimates of how fast each item sells and each denomination
+// fills the collection box, for restocking before anything runs out. Every
+// sale updates its rates in O(1) and no history is kept or rescanned. Each
+// rate is an exponentially decaying count of events:
+//   r <- r * exp(-dt / window) + units / window
+// so it follows the last window of trade and weights recent sales most.
+// Until a whole window has been observed, rates are scaled up by the share
+// of it seen so far.
+class SalesForecaster {
+public:
+    static const qint64 kDefaultWindowMsecs = 24 * 3600 * 1000LL;
+
+    explicit SalesForecaster(qint64 windowMsecs = kDefaultWindowMsecs);
+
+    void recordSale(const QString &itemName, const CoinCounts &payment, qint64 atMsecs, int quantity = 1);
+    void forgetItem(const QString &itemName) { items.remove(itemName); }
+
+    // Units sold, or coins taken, per hour as of nowMsecs
+    double itemRate(const QString &itemName, qint64 nowMsecs) const;
+    double coinRate(int denomination, qint64 nowMsecs) const;
+
+    // Hours until remaining units are used up at perHour; negative when
+    // nothing is being used
+    static double hoursUntil(int remaining, double perHour);
+
+private:
+    struct Rate {
+        double value = 0;    // events per ms as of atMsecs
+        qint64 atMsecs = 0;
+    };
+
+    void add(Rate &rate, double units, qint64 atMsecs) const;
+    double perHour(const Rate &rate, qint64 nowMsecs) const;
+
+    double windowMsecs;
+    qint64 originMsecs; // earliest time observed
+    QHash<QString, Rate> items;
+    QMap<int, Rate> coins;
+};
+
+#endif // SALESFORECASTER_H
@@ -0,0 +1,578 @@
+// sqlitestore.cpp
+#include "sqlitestore.h"
+#include "salesanalytics.h"
+#include "metrics.h"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QSet>
+#include <QStringList>
+#include <QDebug>
+
+namespace {
+LatencyHistogram *statementLatency() {
+    static LatencyHistogram *const latency =
+        Metrics::histogram("vending_sql_statement_seconds", "Time to execute one SQL statement.");
+    return latency;
+}
+
+Counter *statementFailures() {
+    static Counter *const failures = Metrics::counter("vending_sql_errors", "SQL statements that failed.");
+    return failures;
+}
+}
+
+SqliteVendingStore::SqliteVendingStore(const QSqlDatabase &db) : db(db) {
+    flushTimer.setSingleShot(true);
+    QObject::connect(&flushTimer, &QTimer::timeout, [this]() { flush(); });
+}
+
+SqliteVendingStore::~SqliteVendingStore() {
+    flush();
+}
+
+void SqliteVendingStore::setGroupCommitWindow(int msecs) {
+    // Close any batch opened under the previous window first
+    flush();
+    windowMsecs = qMax(0, msecs);
+}
+
+bool SqliteVendingStore::beginBatch() {
+    if (batchOpen) {
+        return true;
+    }
+    if (!beginTransaction()) {
+        return false;
+    }
+    batchOpen = true;
+    return true;
+}
+
+bool SqliteVendingStore::beginTransaction() {
+    // A deferred transaction that later needs the write lock can fail with
+    // SQLITE_BUSY whatever the busy timeout, as waiting could deadlock
+    if (multiTerminal) {
+        return execStatement("BEGIN IMMEDIATE");
+    }
+    if (!db.transaction()) {
+        errorText = db.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SqliteVendingStore::flush() {
+    flushTimer.stop();
+    if (!batchOpen) {
+        return true;
+    }
+
+    batchOpen = false;
+    if (!commitTransaction()) {
+        errorText = db.lastError().text();
+        qWarning() << "Group commit failed:" << errorText;
+        db.rollback();
+        // Callers were already told the batch's mutations succeeded
+        diverged = true;
+        return false;
+    }
+    return true;
+}
+
+bool SqliteVendingStore::runQuery(QSqlQuery &query) {
+    ScopedTimer timer(statementLatency());
+    if (!query.exec()) {
+        noteFailure(query.lastError());
+        return false;
+    }
+    return true;
+}
+
+bool SqliteVendingStore::runQuery(QSqlQuery &query, const QString &sql) {
+    ScopedTimer timer(statementLatency());
+    if (!query.exec(sql)) {
+        noteFailure(query.lastError());
+        return false;
+    }
+    return true;
+}
+
+void SqliteVendingStore::noteFailure(const QSqlError &error) {
+    statementFailures()->increment();
+
+    // SQLITE_BUSY or SQLITE_LOCKED past the busy timeout: another terminal
+    // held the write lock, so the same work can succeed on a retry
+    QString code = error.nativeErrorCode();
+    if (code == "5" || code == "6") {
+        conflict = true;
+    }
+}
+
+bool SqliteVendingStore::commitTransaction() {
+    static LatencyHistogram *const latency =
+        Metrics::histogram("vending_sql_commit_seconds", "Time to commit a transaction.");
+    ScopedTimer timer(latency);
+    if (!db.commit()) {
+        noteFailure(db.lastError());
+        return false;
+    }
+    return true;
+}
+
+bool SqliteVendingStore::execStatement(const QString &sql) {
+    QSqlQuery query(db);
+    if (!runQuery(query, sql)) {
+        errorText = query.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool SqliteVendingStore::beginUnit(bool repairing) {
+    conflict = false;
+    if (diverged && !repairing) {
+        errorText = QStringLiteral("Earlier writes were lost; waiting for a checkpoint");
+        return false;
+    }
+    unitInBatch = batchOpen || windowMsecs > 0;
+    if (!unitInBatch) {
+        return beginTransaction();
+    }
+
+    // Group commit: open a batch on the first unit, then guard each unit with
+    // a savepoint so a failed one can be undone without losing the batch
+    if (!batchOpen) {
+        if (!beginBatch()) {
+            return false;
+        }
+        flushTimer.start(windowMsecs);
+    }
+    return execStatement("SAVEPOINT unit");
+}
+
+void SqliteVendingStore::setJournalSequence(quint64 sequence) {
+    journalSequence = sequence;
+    sequencePending = true;
+}
+
+bool SqliteVendingStore::endUnit(bool ok) {
+    // The checkpoint sequence commits atomically with the unit it covers
+    if (ok && sequencePending) {
+        QSqlQuery query(db);
+        query.prepare("UPDATE journal_checkpoint_67011755 SET sequence = ? WHERE id = 1");
+        query.addBindValue(journalSequence);
+        if (runQuery(query)) {
+            sequencePending = false;
+        } else {
+            errorText = query.lastError().text();
+            ok = false;
+        }
+    }
+
+    if (!unitInBatch) {
+        if (ok && commitTransaction()) {
+            return true;
+        }
+        if (ok) {
+            errorText = db.lastError().text();
+        }
+        db.rollback();
+        return false;
+    }
+
+    if (ok) {
+        return execStatement("RELEASE unit");
+    }
+
+    // Keep the failing statement's error rather than the rollback's
+    QString failure = errorText;
+    execStatement("ROLLBACK TO unit");
+    execStatement("RELEASE unit");
+    errorText = failure;
+    return false;
+}
+
+bool SqliteVendingStore::lostRace(const QString &message) {
+    conflict = true;
+    errorText = message;
+    return endUnit(false);
+}
+
+bool SqliteVendingStore::load(VendingSnapshot &snapshot) {
+    QSqlQuery stockQuery(db);
+    if (!runQuery(stockQuery, "SELECT item_name, price, stock FROM stock_67011755 ORDER BY item_id")) {
+        errorText = stockQuery.lastError().text();
+        return false;
+    }
+    while (stockQuery.next()) {
+        StockItem item;
+        item.name = stockQuery.value(0).toString();
+        item.price = stockQuery.value(1).toInt();
+        item.stock = stockQuery.value(2).toInt();
+        snapshot.items.append(item);
+    }
+
+    QSqlQuery changeQuery(db);
+    if (!runQuery(changeQuery, "SELECT THB, Count FROM change_box_67011755")) {
+        errorText = changeQuery.lastError().text();
+        return false;
+    }
+    while (changeQuery.next()) {
+        snapshot.changeBox[changeQuery.value(0).toInt()] = changeQuery.value(1).toInt();
+    }
+
+    QSqlQuery collectionQuery(db);
+    if (!runQuery(collectionQuery, "SELECT THB, Count FROM collection_box_67011755")) {
+        errorText = collectionQuery.lastError().text();
+        return false;
+    }
+    while (collectionQuery.next()) {
+        snapshot.collectionBox[collectionQuery.value(0).toInt()] = collectionQuery.value(1).toInt();
+    }
+
+    QSqlQuery checkpointQuery(db);
+    if (!runQuery(checkpointQuery, "SELECT sequence FROM journal_checkpoint_67011755 WHERE id = 1")) {
+        errorText = checkpointQuery.lastError().text();
+        return false;
+    }
+    if (checkpointQuery.next()) {
+        snapshot.journalSequence = checkpointQuery.value(0).toULongLong();
+    }
+
+    // The caller now holds what the tables hold
+    diverged = false;
+    return true;
+}
+
+bool SqliteVendingStore::recordSale(const SaleRecord &sale) {
+    int paymentTotal = 0;
+    int changeTotal = 0;
+    QStringList paymentCoins;
+    QStringList changeCoins;
+    for (auto it = sale.payment.constBegin(); it != sale.payment.constEnd(); ++it) {
+        paymentTotal += it.key() * it.value();
+        paymentCoins << QString("%1x%2").arg(it.key()).arg(it.value());
+    }
+    for (auto it = sale.change.constBegin(); it != sale.change.constEnd(); ++it) {
+        changeTotal += it.key() * it.value();
+        changeCoins << QString("%1x%2").arg(it.key()).arg(it.value());
+    }
+
+    // Append one fact row for the line, whatever its quantity; a cart's coins
+    // go on its first line, so its lines still add up to a single payment
+    QSqlQuery saleQuery(db);
+    saleQuery.prepare("INSERT INTO sales_67011755 (sold_at, item_name, price, quantity, payment_total, "
+                      "change_total, payment_coins, change_coins) VALUES (?, ?, ?, ?, ?, ?, ?, ?)");
+    saleQuery.addBindValue(sale.soldAt);
+    saleQuery.addBindValue(sale.itemName);
+    saleQuery.addBindValue(sale.price);
+    saleQuery.addBindValue(sale.quantity);
+    saleQuery.addBindValue(paymentTotal);
+    saleQuery.addBindValue(changeTotal);
+    saleQuery.addBindValue(paymentCoins.join(','));
+    saleQuery.addBindValue(changeCoins.join(','));
+    if (!runQuery(saleQuery)) {
+        errorText = saleQuery.lastError().text();
+        return false;
+    }
+
+    // Fold it into the hourly and daily totals
+    const struct {
+        const char *table;
+        const char *bucket;
+        qint64 key;
+    } rollups[] = {
+        {"sales_hourly_67011755", "hour", SalesAnalytics::hourBucket(sale.soldAt)},
+        {"sales_daily_67011755", "day", SalesAnalytics::dayBucket(sale.soldAt)}
+    };
+    for (const auto &rollup : rollups) {
+        QSqlQuery rollupQuery(db);
+        rollupQuery.prepare(QString("INSERT INTO %1 (%2, item_name, units, revenue) VALUES (?, ?, ?, ?) "
+                                    "ON CONFLICT(%2, item_name) DO UPDATE SET "
+                                    "units = units + excluded.units, revenue = revenue + excluded.revenue")
+                                .arg(rollup.table, rollup.bucket));
+        rollupQuery.addBindValue(rollup.key);
+        rollupQuery.addBindValue(sale.itemName);
+        rollupQuery.addBindValue(sale.quantity);
+        rollupQuery.addBindValue(sale.price * sale.quantity);
+        if (!runQuery(rollupQuery)) {
+            errorText = rollupQuery.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SqliteVendingStore::commitPurchase(const SaleRecord &sale) {
+    return commitCart(QVector<SaleRecord>{sale});
+}
+
+bool SqliteVendingStore::commitCart(const QVector<SaleRecord> &sales) {
+    if (!beginUnit()) {
+        return false;
+    }
+
+    // Update change box. Decrements are guarded, as another terminal
+    // sharing the database may have paid out these coins already.
+    QSqlQuery changeQuery(db);
+    changeQuery.prepare("UPDATE change_box_67011755 SET Count = Count - ? WHERE THB = ? AND Count >= ?");
+    QSqlQuery collectionQuery(db);
+    collectionQuery.prepare("UPDATE collection_box_67011755 SET Count = Count + ? WHERE THB = ?");
+    for (const SaleRecord &sale : sales) {
+        for (auto it = sale.change.constBegin(); it != sale.change.constEnd(); ++it) {
+            changeQuery.addBindValue(it.value());
+            changeQuery.addBindValue(it.key());
+            changeQuery.addBindValue(it.value());
+            if (!runQuery(changeQuery)) {
+                errorText = changeQuery.lastError().text();
+                return endUnit(false);
+            }
+            if (changeQuery.numRowsAffected() != 1) {
+                return lostRace(QString("Not enough %1 left in the change box").arg(denominationLabel(it.key())));
+            }
+        }
+
+        // Update collection box for each payment denomination
+        for (auto it = sale.payment.constBegin(); it != sale.payment.constEnd(); ++it) {
+            collectionQuery.addBindValue(it.value());
+            collectionQuery.addBindValue(it.key());
+            if (!runQuery(collectionQuery)) {
+                errorText = collectionQuery.lastError().text();
+                return endUnit(false);
+            }
+        }
+    }
+
+    // Update stock, likewise only while enough units are left
+    QSqlQuery stockQuery(db);
+    stockQuery.prepare("UPDATE stock_67011755 SET stock = stock - ? WHERE item_name = ? AND stock >= ?");
+    for (const SaleRecord &sale : sales) {
+        stockQuery.addBindValue(sale.quantity);
+        stockQuery.addBindValue(sale.itemName);
+        stockQuery.addBindValue(sale.quantity);
+        if (!runQuery(stockQuery)) {
+            errorText = stockQuery.lastError().text();
+            return endUnit(false);
+        }
+        if (stockQuery.numRowsAffected() != 1) {
+            return lostRace(sale.itemName + " is sold out");
+        }
+    }
+
+    for (const SaleRecord &sale : sales) {
+        if (!recordSale(sale)) {
+            return endUnit(false);
+        }
+    }
+    return endUnit(true);
+}
+
+bool SqliteVendingStore::addItem(const StockItem &item) {
+    if (!beginUnit()) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO stock_67011755 (item_name, price, stock) VALUES (?, ?, ?)");
+    query.addBindValue(item.name);
+    query.addBindValue(item.price);
+    query.addBindValue(item.stock);
+
+    if (!runQuery(query)) {
+        errorText = query.lastError().text();
+        return endUnit(false);
+    }
+    return endUnit(true);
+}
+
+bool SqliteVendingStore::deleteItem(const QString &itemName) {
+    if (!beginUnit()) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM stock_67011755 WHERE item_name = ?");
+    query.addBindValue(itemName);
+
+    if (!runQuery(query)) {
+        errorText = query.lastError().text();
+        return endUnit(false);
+    }
+    return endUnit(true);
+}
+
+bool SqliteVendingStore::restockItem(const QString &itemName, int amount) {
+    if (!beginUnit()) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("UPDATE stock_67011755 SET stock = stock + ? WHERE item_name = ?");
+    query.addBindValue(amount);
+    query.addBindValue(itemName);
+
+    if (!runQuery(query)) {
+        errorText = query.lastError().text();
+        return endUnit(false);
+    }
+    return endUnit(true);
+}
+
+bool SqliteVendingStore::restockItems(const QMap<QString, int> &amounts) {
+    if (!beginUnit()) {
+        return false;
+    }
+
+    // One prepared statement, run per item inside the unit
+    QSqlQuery query(db);
+    query.prepare("UPDATE stock_67011755 SET stock = stock + ? WHERE item_name = ?");
+    for (auto it = amounts.constBegin(); it != amounts.constEnd(); ++it) {
+        query.addBindValue(it.value());
+        query.addBindValue(it.key());
+        if (!runQuery(query)) {
+            errorText = query.lastError().text();
+            return endUnit(false);
+        }
+    }
+    return endUnit(true);
+}
+
+bool SqliteVendingStore::deleteItems(const QStringList &itemNames) {
+    if (!beginUnit()) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("DELETE FROM stock_67011755 WHERE item_name = ?");
+    for (const QString &itemName : itemNames) {
+        query.addBindValue(itemName);
+        if (!runQuery(query)) {
+            errorText = query.lastError().text();
+            return endUnit(false);
+        }
+    }
+    return endUnit(true);
+}
+
+bool SqliteVendingStore::restockToPar(int level) {
+    if (!beginUnit()) {
+        return false;
+    }
+
+    // Absolute rather than a delta, so it is right whatever other terminals
+    // sold in the meantime
+    QSqlQuery query(db);
+    query.prepare("UPDATE stock_67011755 SET stock = ? WHERE stock < ?");
+    query.addBindValue(level);
+    query.addBindValue(level);
+    if (!runQuery(query)) {
+        errorText = query.lastError().text();
+        return endUnit(false);
+    }
+    return endUnit(true);
+}
+
+bool SqliteVendingStore::refillChange(const CoinCounts &amounts) {
+    if (!beginUnit()) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("UPDATE change_box_67011755 SET Count = Count + ? WHERE THB = ?");
+    for (auto it = amounts.constBegin(); it != amounts.constEnd(); ++it) {
+        query.addBindValue(it.value());
+        query.addBindValue(it.key());
+        if (!runQuery(query)) {
+            errorText = query.lastError().text();
+            return endUnit(false);
+        }
+    }
+    return endUnit(true);
+}
+
+bool SqliteVendingStore::collectMoney() {
+    if (!beginUnit()) {
+        return false;
+    }
+    return endUnit(execStatement("UPDATE collection_box_67011755 SET Count = 0"));
+}
+
+bool SqliteVendingStore::saveCheckpoint(const VendingSnapshot &snapshot) {
+    if (!beginUnit(true)) {
+        return false;
+    }
+
+    // Upsert keeps item_id stable for items that survive
+    QSqlQuery stockQuery(db);
+    stockQuery.prepare("INSERT INTO stock_67011755 (item_name, price, stock) VALUES (?, ?, ?) "
+                       "ON CONFLICT(item_name) DO UPDATE SET price = excluded.price, stock = excluded.stock");
+    QSet<QString> names;
+    for (const StockItem &item : snapshot.items) {
+        stockQuery.addBindValue(item.name);
+        stockQuery.addBindValue(item.price);
+        stockQuery.addBindValue(item.stock);
+        if (!runQuery(stockQuery)) {
+            errorText = stockQuery.lastError().text();
+            return endUnit(false);
+        }
+        names.insert(item.name);
+    }
+
+    // Drop items deleted since the old checkpoint
+    QSqlQuery existingQuery(db);
+    QSqlQuery deleteQuery(db);
+    deleteQuery.prepare("DELETE FROM stock_67011755 WHERE item_name = ?");
+    if (!runQuery(existingQuery, "SELECT item_name FROM stock_67011755")) {
+        errorText = existingQuery.lastError().text();
+        return endUnit(false);
+    }
+    QStringList removed;
+    while (existingQuery.next()) {
+        QString name = existingQuery.value(0).toString();
+        if (!names.contains(name)) {
+            removed << name;
+        }
+    }
+    existingQuery.finish();
+    for (const QString &name : removed) {
+        deleteQuery.addBindValue(name);
+        if (!runQuery(deleteQuery)) {
+            errorText = deleteQuery.lastError().text();
+            return endUnit(false);
+        }
+    }
+
+    const struct {
+        const char *table;
+        const CoinCounts &counts;
+    } boxes[] = {
+        {"change_box_67011755", snapshot.changeBox},
+        {"collection_box_67011755", snapshot.collectionBox}
+    };
+    for (const auto &box : boxes) {
+        QSqlQuery boxQuery(db);
+        boxQuery.prepare(QString("INSERT OR REPLACE INTO %1 (THB, Count) VALUES (?, ?)").arg(box.table));
+        for (auto it = box.counts.constBegin(); it != box.counts.constEnd(); ++it) {
+            boxQuery.addBindValue(it.key());
+            boxQuery.addBindValue(it.value());
+            if (!runQuery(boxQuery)) {
+                errorText = boxQuery.lastError().text();
+                return endUnit(false);
+            }
+        }
+    }
+
+    // Sales replayed from the journal join the history with this checkpoint
+    for (const SaleRecord &sale : snapshot.unrecordedSales) {
+        if (!recordSale(sale)) {
+            return endUnit(false);
+        }
+    }
+
+    setJournalSequence(snapshot.journalSequence);
+    if (!endUnit(true)) {
+        return false;
+    }
+    diverged = false;
+    return true;
+}
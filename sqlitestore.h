@@ -0,0 +1,90 @@
+// sqlitestore.h
+#ifndef SQLITESTORE_H
+#define SQLITESTORE_H
+
+#include "vendingengine.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QTimer>
+
+// VendingStore backed by the stock/change/collection tables created in
+// Database::initialize.
+//
+// Every mutation is committed as one transaction. With a group-commit window
+// set, mutations arriving within the window share a single transaction (each
+// one guarded by a savepoint) and are committed together when the window
+// expires, trading up to that window of durability for one fsync per batch:
+// callers are told a mutation succeeded before its batch commits. If the
+// batch commit then fails, the store reports needsCheckpoint() and refuses
+// further writes until the engine rewrites or reloads the state.
+// A batch can also be opened explicitly with beginBatch() and closed with
+// flush().
+//
+// Sales only decrement stock and coins that are still there, so terminals
+// sharing one database can never oversell or drive a count negative; a sale
+// refused that way reports conflicted(). In multi-terminal mode every
+// transaction also takes the write lock when it begins, so concurrent
+// writers queue on the busy timeout instead of failing part way through.
+class SqliteVendingStore : public VendingStore {
+public:
+    explicit SqliteVendingStore(const QSqlDatabase &db = QSqlDatabase::database());
+    ~SqliteVendingStore() override;
+
+    void setGroupCommitWindow(int msecs);
+    int groupCommitWindow() const { return windowMsecs; }
+    bool beginBatch();
+    bool flush();
+
+    void setMultiTerminal(bool enabled) { multiTerminal = enabled; }
+    bool isMultiTerminal() const override { return multiTerminal; }
+
+    // For bulk work that goes beyond the VendingStore operations
+    QSqlDatabase database() const { return db; }
+
+    bool load(VendingSnapshot &snapshot) override;
+    bool commitPurchase(const SaleRecord &sale) override;
+    bool commitCart(const QVector<SaleRecord> &sales) override;
+    bool addItem(const StockItem &item) override;
+    bool deleteItem(const QString &itemName) override;
+    bool restockItem(const QString &itemName, int amount) override;
+    bool restockItems(const QMap<QString, int> &amounts) override;
+    bool deleteItems(const QStringList &itemNames) override;
+    bool restockToPar(int level) override;
+    bool refillChange(const CoinCounts &amounts) override;
+    bool collectMoney() override;
+    bool saveCheckpoint(const VendingSnapshot &snapshot) override;
+    void setJournalSequence(quint64 sequence) override;
+    bool recordsSales() const override { return true; }
+    bool conflicted() const override { return conflict; }
+    bool needsCheckpoint() const override { return diverged; }
+    void markNeedsCheckpoint() override { diverged = true; }
+
+    QString lastError() const override { return errorText; }
+
+private:
+    bool beginTransaction();
+    bool beginUnit(bool repairing = false);
+    bool endUnit(bool ok);
+    bool lostRace(const QString &message);
+    bool execStatement(const QString &sql);
+    bool runQuery(QSqlQuery &query);
+    bool runQuery(QSqlQuery &query, const QString &sql);
+    void noteFailure(const QSqlError &error);
+    bool commitTransaction();
+    bool recordSale(const SaleRecord &sale);
+
+    QSqlDatabase db;
+    QString errorText;
+    QTimer flushTimer;
+    int windowMsecs = 0;
+    bool batchOpen = false;
+    bool unitInBatch = false;
+    bool multiTerminal = false;
+    bool conflict = false;
+    quint64 journalSequence = 0;
+    bool sequencePending = false;
+    bool diverged = false;
+};
+
+#endif // SQLITESTORE_H
@@ -0,0 +1,127 @@
+// main.cpp
+// Coin acceptor simulator: connects to the machine's --coin-acceptor socket
+// and streams coin (and optionally item selection) events at a fixed rate or
+// as fast as the socket takes them. Each event carries the steady-clock time
+// it was sent, so the machine's "coin" latency metric is end to end.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QLocalSocket>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QThread>
+#include <QtEndian>
+#include <chrono>
+
+namespace {
+// Frame layout, as read by LocalSocketCoinSource
+enum FrameType : quint8 {
+    Coin = 1,
+    Select = 2
+};
+
+qint64 timestamp() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+void put(QByteArray &out, T value) {
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void appendFrame(QByteArray &out, FrameType type, qint32 denomination, const QByteArray &name = QByteArray()) {
+    put<quint8>(out, type);
+    put<qint64>(out, timestamp());
+    put<qint32>(out, denomination);
+    put<quint16>(out, quint16(name.size()));
+    out.append(name);
+}
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("coinsim");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Stream simulated coin acceptor events to a vending machine");
+    parser.addHelpOption();
+    QCommandLineOption serverOption("server", "Socket name given to the machine's --coin-acceptor.", "name",
+                                    "vending_coin_acceptor");
+    QCommandLineOption countOption("coins", "Number of coins to insert.", "n", "10000");
+    QCommandLineOption rateOption("rate", "Coins per second (0 = as fast as possible).", "n", "1000");
+    QCommandLineOption denominationsOption("denominations", "Comma-separated denominations to pick from.",
+                                           "list", "1,5,10,20,100");
+    QCommandLineOption itemOption("item", "Select this item every --select-every coins, so sales go through.",
+                                  "name");
+    QCommandLineOption selectEveryOption("select-every", "Coins between selections.", "n", "5");
+    QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+    parser.addOptions({serverOption, countOption, rateOption, denominationsOption, itemOption,
+                       selectEveryOption, seedOption});
+    parser.process(app);
+
+    QVector<qint32> denominations;
+    for (const QString &value : parser.value(denominationsOption).split(',')) {
+        if (value.toInt() > 0) {
+            denominations.append(value.toInt());
+        }
+    }
+    int coins = qMax(0, parser.value(countOption).toInt());
+    int rate = qMax(0, parser.value(rateOption).toInt());
+    int selectEvery = qMax(1, parser.value(selectEveryOption).toInt());
+    QByteArray item = parser.value(itemOption).toUtf8();
+    QRandomGenerator random(parser.value(seedOption).toUInt());
+
+    QTextStream err(stderr);
+    if (denominations.isEmpty()) {
+        err << "No denominations given\n";
+        return 1;
+    }
+
+    QLocalSocket socket;
+    socket.connectToServer(parser.value(serverOption));
+    if (!socket.waitForConnected(5000)) {
+        err << "Cannot connect to " << parser.value(serverOption) << ": " << socket.errorString() << "\n";
+        return 1;
+    }
+
+    // Unthrottled, coins go out in batches of this many frames per write
+    const int kBatch = 256;
+    QByteArray frames;
+    frames.reserve(kBatch * 32);
+
+    QElapsedTimer clock;
+    clock.start();
+    for (int i = 0; i < coins; ++i) {
+        if (rate > 0) {
+            // Pace against the start time so the average rate holds
+            qint64 due = qint64(i) * 1000000000 / rate;
+            qint64 wait = due - clock.nsecsElapsed();
+            if (wait > 0) {
+                QThread::usleep(quint64(wait / 1000));
+            }
+        }
+
+        appendFrame(frames, Coin, denominations.at(random.bounded(denominations.size())));
+        if (!item.isEmpty() && (i + 1) % selectEvery == 0) {
+            appendFrame(frames, Select, 0, item);
+        }
+
+        if (rate > 0 || frames.size() >= kBatch * 15 || i == coins - 1) {
+            if (socket.write(frames) != frames.size() || !socket.waitForBytesWritten(5000)) {
+                err << "Write failed: " << socket.errorString() << "\n";
+                return 1;
+            }
+            frames.resize(0);
+        }
+    }
+    socket.flush();
+    socket.disconnectFromServer();
+
+    double seconds = clock.nsecsElapsed() / 1e9;
+    QTextStream out(stdout);
+    out << QString("Sent %1 coins in %2 s (%3 coins/s)\n")
+               .arg(coins).arg(seconds, 0, 'f', 3).arg(seconds > 0 ? coins / seconds : 0.0, 0, 'f', 0);
+    return 0;
+}
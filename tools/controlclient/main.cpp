@@ -0,0 +1,165 @@
+// main.cpp
+// Control API client: sends commands to a machine started with
+// --control-socket or --control-port and prints the responses. With
+// --repeat it becomes a load test, keeping up to --pipeline requests in
+// flight and reporting throughput and round-trip latency percentiles.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QLocalSocket>
+#include <QScopedPointer>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+// Frame layout, as read by ControlServer: u32 length, u32 id, payload
+const int kHeaderSize = 4 + 4;
+
+void appendFrame(QByteArray &out, quint32 id, const QByteArray &payload) {
+    uchar header[kHeaderSize];
+    qToLittleEndian<quint32>(quint32(4 + payload.size()), header);
+    qToLittleEndian<quint32>(id, header + 4);
+    out.append(reinterpret_cast<const char *>(header), kHeaderSize);
+    out.append(payload);
+}
+
+double percentileMsecs(const QVector<qint64> &sorted, double fraction) {
+    if (sorted.isEmpty()) {
+        return 0;
+    }
+    int index = qMin(sorted.size() - 1, int(fraction * sorted.size()));
+    return sorted.at(index) / 1e6;
+}
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("controlclient");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Send control API commands to a vending machine");
+    parser.addHelpOption();
+    QCommandLineOption serverOption("server", "Local socket given to the machine's --control-socket.", "name",
+                                    "vending_control");
+    QCommandLineOption portOption("port", "Connect to the machine's --control-port on localhost instead.", "port");
+    QCommandLineOption repeatOption("repeat", "Send the commands this many times over and report statistics.",
+                                    "n", "1");
+    QCommandLineOption pipelineOption("pipeline", "Requests in flight at once (1 = wait for each response).",
+                                      "n", "32");
+    parser.addOptions({serverOption, portOption, repeatOption, pipelineOption});
+    parser.addPositionalArgument("command", "Commands to send, e.g. status \"buy Cola 20\".", "command...");
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QList<QByteArray> commands;
+    for (const QString &command : parser.positionalArguments()) {
+        commands.append(command.toUtf8());
+    }
+    if (commands.isEmpty()) {
+        commands.append("status");
+    }
+    int repeat = qMax(1, parser.value(repeatOption).toInt());
+    int depth = qMax(1, parser.value(pipelineOption).toInt());
+    bool verbose = repeat == 1;
+
+    QScopedPointer<QIODevice> socket;
+    if (parser.isSet(portOption)) {
+        QTcpSocket *tcp = new QTcpSocket;
+        socket.reset(tcp);
+        tcp->connectToHost(QHostAddress::LocalHost, quint16(parser.value(portOption).toUInt()));
+        if (!tcp->waitForConnected(5000)) {
+            err << "Cannot connect to port " << parser.value(portOption) << ": " << tcp->errorString() << "\n";
+            return 1;
+        }
+        tcp->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    } else {
+        QLocalSocket *local = new QLocalSocket;
+        socket.reset(local);
+        local->connectToServer(parser.value(serverOption));
+        if (!local->waitForConnected(5000)) {
+            err << "Cannot connect to " << parser.value(serverOption) << ": " << local->errorString() << "\n";
+            return 1;
+        }
+    }
+
+    int total = commands.size() * repeat;
+    QVector<qint64> sentAt(total);
+    QVector<qint64> latencies;
+    latencies.reserve(total);
+    int sent = 0;
+    int received = 0;
+    int errors = 0;
+    QByteArray frames;
+    QByteArray buffer;
+
+    QElapsedTimer clock;
+    clock.start();
+    while (received < total) {
+        // Top the pipeline up, in one write
+        while (sent < total && sent - received < depth) {
+            appendFrame(frames, quint32(sent), commands.at(sent % commands.size()));
+            sentAt[sent] = clock.nsecsElapsed();
+            sent++;
+        }
+        if (!frames.isEmpty()) {
+            if (socket->write(frames) != frames.size()
+                || (socket->bytesToWrite() > 0 && !socket->waitForBytesWritten(5000))) {
+                err << "Write failed: " << socket->errorString() << "\n";
+                return 1;
+            }
+            frames.resize(0);
+        }
+
+        if (!socket->waitForReadyRead(5000)) {
+            err << "No response: " << socket->errorString() << "\n";
+            return 1;
+        }
+        buffer.append(socket->readAll());
+
+        int offset = 0;
+        while (buffer.size() - offset >= kHeaderSize) {
+            const uchar *frame = reinterpret_cast<const uchar *>(buffer.constData()) + offset;
+            quint32 length = qFromLittleEndian<quint32>(frame);
+            if (quint32(buffer.size() - offset) < 4 + length) {
+                break;
+            }
+            quint32 id = qFromLittleEndian<quint32>(frame + 4);
+            QByteArray text(reinterpret_cast<const char *>(frame + kHeaderSize), int(length) - 4);
+            offset += 4 + int(length);
+
+            // Responses come back in request order
+            if (id != quint32(received)) {
+                err << "Response " << id << " arrived when " << received << " was due\n";
+                return 1;
+            }
+            latencies.append(clock.nsecsElapsed() - sentAt.at(received));
+            received++;
+            if (text.startsWith("ERR")) {
+                errors++;
+            }
+            if (verbose) {
+                out << text << "\n";
+            }
+        }
+        buffer.remove(0, offset);
+    }
+    double seconds = clock.nsecsElapsed() / 1e9;
+
+    if (!verbose) {
+        std::sort(latencies.begin(), latencies.end());
+        out << QString("%1 requests (%2 ERR) in %3 s: %4 requests/s, pipeline %5\n")
+                   .arg(total).arg(errors).arg(seconds, 0, 'f', 3)
+                   .arg(seconds > 0 ? total / seconds : 0.0, 0, 'f', 0).arg(depth);
+        out << QString("round trip ms: p50 %1  p99 %2  p99.9 %3  max %4\n")
+                   .arg(percentileMsecs(latencies, 0.50), 0, 'f', 3)
+                   .arg(percentileMsecs(latencies, 0.99), 0, 'f', 3)
+                   .arg(percentileMsecs(latencies, 0.999), 0, 'f', 3)
+                   .arg(latencies.isEmpty() ? 0.0 : latencies.last() / 1e6, 0, 'f', 3);
+    }
+    return errors > 0 && verbose ? 2 : 0;
+}
@@ -0,0 +1,10 @@
+QT       += core sql
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = fleetreport
+
+SOURCES += \
+    main.cpp
@@ -0,0 +1,245 @@
+// main.cpp
+// Fleet report: scans a directory of machine databases in parallel and
+// prints merged stock, change box and collection box totals.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
+#include <QVariant>
+#include <atomic>
+
+struct ItemTotals {
+    qint64 stock = 0;
+    int machines = 0;
+    int outOfStock = 0;
+};
+
+// Totals for one machine or, once merged, for the whole fleet. Its size
+// depends on the catalog and denominations, never on the number of machines.
+struct FleetTotals {
+    int machines = 0;
+    int failed = 0;
+    QMap<QString, ItemTotals> items;
+    QMap<int, qint64> changeBox;
+    QMap<int, qint64> collectionBox;
+
+    void merge(const FleetTotals &other) {
+        machines += other.machines;
+        failed += other.failed;
+        for (auto it = other.items.constBegin(); it != other.items.constEnd(); ++it) {
+            ItemTotals &totals = items[it.key()];
+            totals.stock += it.value().stock;
+            totals.machines += it.value().machines;
+            totals.outOfStock += it.value().outOfStock;
+        }
+        for (auto it = other.changeBox.constBegin(); it != other.changeBox.constEnd(); ++it) {
+            changeBox[it.key()] += it.value();
+        }
+        for (auto it = other.collectionBox.constBegin(); it != other.collectionBox.constEnd(); ++it) {
+            collectionBox[it.key()] += it.value();
+        }
+    }
+};
+
+// One read-only connection per pool thread, reopened on each file
+class WorkerConnection {
+public:
+    WorkerConnection() {
+        name = QString("fleetreport_%1").arg(quintptr(QThread::currentThreadId()));
+        db = QSqlDatabase::addDatabase("QSQLITE", name);
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+    }
+
+    ~WorkerConnection() {
+        db.close();
+        db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(name);
+    }
+
+    QSqlDatabase &open(const QString &path) {
+        db.close();
+        db.setDatabaseName(path);
+        db.open();
+        return db;
+    }
+
+private:
+    QString name;
+    QSqlDatabase db;
+};
+
+static QThreadStorage<WorkerConnection *> workerConnections;
+
+// Denominations are "20THB" strings before schema v2 and integers after;
+// this expression reads both
+static const char *kDenomination = "CAST(REPLACE(THB, 'THB', '') AS INTEGER)";
+
+static bool scanBox(QSqlDatabase &db, const QString &table, QMap<int, qint64> &totals) {
+    QSqlQuery query(db);
+    if (!query.exec(QString("SELECT %1, SUM(Count) FROM %2 GROUP BY 1").arg(kDenomination, table))) {
+        return false;
+    }
+    while (query.next()) {
+        totals[query.value(0).toInt()] += query.value(1).toLongLong();
+    }
+    return true;
+}
+
+static FleetTotals scanMachine(const QString &path) {
+    if (!workerConnections.hasLocalData()) {
+        workerConnections.setLocalData(new WorkerConnection);
+    }
+
+    FleetTotals totals;
+    QSqlDatabase &db = workerConnections.localData()->open(path);
+    if (!db.isOpen()) {
+        totals.failed = 1;
+        return totals;
+    }
+
+    QSqlQuery stockQuery(db);
+    if (!stockQuery.exec("SELECT item_name, SUM(stock) FROM stock_67011755 GROUP BY item_name")) {
+        totals.failed = 1;
+        return totals;
+    }
+    while (stockQuery.next()) {
+        ItemTotals &item = totals.items[stockQuery.value(0).toString()];
+        qint64 stock = stockQuery.value(1).toLongLong();
+        item.stock += stock;
+        item.machines = 1;
+        item.outOfStock = stock == 0 ? 1 : 0;
+    }
+    stockQuery.finish();
+
+    if (!scanBox(db, "change_box_67011755", totals.changeBox)
+        || !scanBox(db, "collection_box_67011755", totals.collectionBox)) {
+        totals = FleetTotals();
+        totals.failed = 1;
+        return totals;
+    }
+
+    totals.machines = 1;
+    return totals;
+}
+
+class ScanTask : public QRunnable {
+public:
+    ScanTask(const QString &path, FleetTotals &fleet, QMutex &mutex, QSemaphore &queueSlots,
+             std::atomic<int> &done)
+        : path(path), fleet(fleet), mutex(mutex), queueSlots(queueSlots), done(done) {
+    }
+
+    void run() override {
+        FleetTotals machine = scanMachine(path);
+        {
+            QMutexLocker locker(&mutex);
+            fleet.merge(machine);
+        }
+        done++;
+        queueSlots.release();
+    }
+
+private:
+    QString path;
+    FleetTotals &fleet;
+    QMutex &mutex;
+    QSemaphore &queueSlots;
+    std::atomic<int> &done;
+};
+
+static void printReport(QTextStream &out, const FleetTotals &fleet, qint64 elapsedMs) {
+    out << QString("Machines scanned: %1 (failed: %2) in %3 ms\n")
+               .arg(fleet.machines).arg(fleet.failed).arg(elapsedMs);
+
+    out << "\nStock\n";
+    out << QString("  %1 %2 %3 %4\n").arg("Item", -24).arg("Units", 12).arg("Machines", 10).arg("Empty", 10);
+    for (auto it = fleet.items.constBegin(); it != fleet.items.constEnd(); ++it) {
+        out << QString("  %1 %2 %3 %4\n")
+                   .arg(it.key(), -24)
+                   .arg(it.value().stock, 12)
+                   .arg(it.value().machines, 10)
+                   .arg(it.value().outOfStock, 10);
+    }
+
+    qint64 changeValue = 0;
+    out << "\nChange Box\n";
+    for (auto it = fleet.changeBox.constBegin(); it != fleet.changeBox.constEnd(); ++it) {
+        out << QString("  %1 %2\n").arg(QString("%1THB").arg(it.key()), -24).arg(it.value(), 12);
+        changeValue += it.key() * it.value();
+    }
+    out << QString("  %1 %2\n").arg("Total (THB)", -24).arg(changeValue, 12);
+
+    qint64 collectionValue = 0;
+    out << "\nCollection Box\n";
+    for (auto it = fleet.collectionBox.constBegin(); it != fleet.collectionBox.constEnd(); ++it) {
+        out << QString("  %1 %2\n").arg(QString("%1THB").arg(it.key()), -24).arg(it.value(), 12);
+        collectionValue += it.key() * it.value();
+    }
+    out << QString("  %1 %2\n").arg("Total (THB)", -24).arg(collectionValue, 12);
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("fleetreport");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Merge stock and cash totals across machine databases");
+    parser.addHelpOption();
+    parser.addPositionalArgument("directory", "Directory holding machine .db files (searched recursively).");
+    QCommandLineOption threadsOption("threads", "Worker threads (default: one per core).", "n",
+                                     QString::number(QThread::idealThreadCount()));
+    QCommandLineOption patternOption("pattern", "File name pattern.", "glob", "*.db");
+    QCommandLineOption progressOption("progress", "Report progress to stderr every <n> machines.", "n", "0");
+    parser.addOptions({threadsOption, patternOption, progressOption});
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) {
+        parser.showHelp(1);
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, parser.value(threadsOption).toInt()));
+
+    // Bound the number of queued files so memory stays flat however large
+    // the fleet is; the directory is walked lazily as slots free up
+    QSemaphore queueSlots(pool.maxThreadCount() * 4);
+    FleetTotals fleet;
+    QMutex mutex;
+    std::atomic<int> done(0);
+    int progressEvery = parser.value(progressOption).toInt();
+    QTextStream err(stderr);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QDirIterator files(parser.positionalArguments().first(), {parser.value(patternOption)},
+                       QDir::Files, QDirIterator::Subdirectories);
+    int submitted = 0;
+    while (files.hasNext()) {
+        queueSlots.acquire();
+        pool.start(new ScanTask(files.next(), fleet, mutex, queueSlots, done));
+        submitted++;
+
+        if (progressEvery > 0 && submitted % progressEvery == 0) {
+            err << QString("submitted %1, scanned %2\n").arg(submitted).arg(done.load());
+            err.flush();
+        }
+    }
+    pool.waitForDone();
+
+    QTextStream out(stdout);
+    printReport(out, fleet, timer.elapsed());
+    return fleet.failed > 0 ? 2 : 0;
+}
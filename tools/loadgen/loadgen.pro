@@ -0,0 +1,12 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = loadgen
+
+include(../../vending_engine.pri)
+
+SOURCES += \
+    main.cpp
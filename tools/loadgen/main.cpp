@@ -0,0 +1,363 @@
+// main.cpp
+// Fleet load generator: simulates a number of machines serving customers
+// through VendingEngine and reports throughput and latency percentiles per
+// operation and storage backend.
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "database.h"
+#include "sqlitestore.h"
+#include "vendingengine.h"
+
+struct LoadConfig {
+    int machines = 4;
+    int customers = 100000;
+    int items = 50;
+    int initialStock = 20;
+    int changeFill = 50;
+    QString popularity = "zipf";
+    double zipfExponent = 1.0;
+    QString coinMix = "mixed";
+    quint32 seed = 1;
+};
+
+struct Machine {
+    QString connection;
+    std::unique_ptr<VendingStore> store;
+    std::unique_ptr<VendingEngine> engine;
+};
+
+// Per-operation latency samples in nanoseconds
+class LatencyRecorder {
+public:
+    void record(const QString &operation, qint64 nanoseconds) {
+        samples[operation].append(nanoseconds);
+    }
+
+    void report(QTextStream &out, const QString &backend, qint64 wallNanoseconds) {
+        double wallSeconds = wallNanoseconds / 1e9;
+        qint64 total = 0;
+        for (auto it = samples.begin(); it != samples.end(); ++it) {
+            QVector<qint64> &values = it.value();
+            std::sort(values.begin(), values.end());
+            total += values.size();
+
+            out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+                       .arg(backend, -8)
+                       .arg(it.key(), -10)
+                       .arg(values.size(), 10)
+                       .arg(values.size() / wallSeconds, 12, 'f', 0)
+                       .arg(percentile(values, 0.50) / 1000.0, 10, 'f', 2)
+                       .arg(percentile(values, 0.99) / 1000.0, 10, 'f', 2)
+                       .arg(percentile(values, 0.999) / 1000.0, 10, 'f', 2);
+        }
+        out << QString("%1 %2 %3 %4\n")
+                   .arg(backend, -8)
+                   .arg("total", -10)
+                   .arg(total, 10)
+                   .arg(total / wallSeconds, 12, 'f', 0);
+    }
+
+private:
+    static qint64 percentile(const QVector<qint64> &sorted, double q) {
+        if (sorted.isEmpty()) {
+            return 0;
+        }
+        int rank = int(std::ceil(q * sorted.size())) - 1;
+        return sorted.at(qBound(0, rank, sorted.size() - 1));
+    }
+
+    QMap<QString, QVector<qint64>> samples;
+};
+
+// Item index sampler following the configured popularity distribution
+class PopularitySampler {
+public:
+    PopularitySampler(const LoadConfig &config) {
+        cdf.resize(config.items);
+        double sum = 0;
+        for (int i = 0; i < config.items; ++i) {
+            double weight = config.popularity == "zipf" ? 1.0 / std::pow(i + 1, config.zipfExponent) : 1.0;
+            sum += weight;
+            cdf[i] = sum;
+        }
+        for (double &value : cdf) {
+            value /= sum;
+        }
+    }
+
+    int sample(QRandomGenerator &random) const {
+        double point = random.generateDouble();
+        auto it = std::lower_bound(cdf.begin(), cdf.end(), point);
+        return qMin(int(it - cdf.begin()), cdf.size() - 1);
+    }
+
+private:
+    QVector<double> cdf;
+};
+
+static QString itemName(int i) {
+    return QString("item%1").arg(i);
+}
+
+static VendingSnapshot seedSnapshot(const LoadConfig &config) {
+    VendingSnapshot snapshot;
+    for (int i = 0; i < config.items; ++i) {
+        StockItem item;
+        item.name = itemName(i);
+        item.price = 5 + (i * 7) % 91;
+        item.stock = config.initialStock;
+        snapshot.items.append(item);
+    }
+    for (int denom : VendingEngine::changeDenominations()) {
+        snapshot.changeBox[denom] = config.changeFill;
+    }
+    for (int denom : VendingEngine::acceptedDenominations()) {
+        snapshot.collectionBox[denom] = 0;
+    }
+    return snapshot;
+}
+
+static bool seedDatabase(QSqlDatabase db, const VendingSnapshot &snapshot) {
+    if (!Database::prepare(db) || !db.transaction()) {
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT INTO stock_67011755 (item_name, price, stock) VALUES (?, ?, ?)");
+    for (const StockItem &item : snapshot.items) {
+        query.addBindValue(item.name);
+        query.addBindValue(item.price);
+        query.addBindValue(item.stock);
+        query.exec();
+    }
+
+    query.prepare("INSERT INTO change_box_67011755 (THB, Count) VALUES (?, ?)");
+    for (auto it = snapshot.changeBox.constBegin(); it != snapshot.changeBox.constEnd(); ++it) {
+        query.addBindValue(it.key());
+        query.addBindValue(it.value());
+        query.exec();
+    }
+
+    query.prepare("INSERT INTO collection_box_67011755 (THB, Count) VALUES (?, ?)");
+    for (auto it = snapshot.collectionBox.constBegin(); it != snapshot.collectionBox.constEnd(); ++it) {
+        query.addBindValue(it.key());
+        query.addBindValue(it.value());
+        query.exec();
+    }
+    query.finish();
+
+    return db.commit();
+}
+
+// Coins a customer inserts for the given price
+static CoinCounts payFor(int price, QString mix, QRandomGenerator &random) {
+    if (mix == "mixed") {
+        static const QStringList mixes = {"exact", "large", "random"};
+        mix = mixes.at(random.bounded(mixes.size()));
+    }
+
+    CoinCounts payment;
+    if (mix == "large") {
+        const int largest = Currency::Accepted::largest();
+        payment[largest] = (price + largest - 1) / largest;
+    } else if (mix == "exact") {
+        int remaining = price;
+        for (int denom : VendingEngine::acceptedDenominations()) {
+            if (remaining >= denom) {
+                payment[denom] = remaining / denom;
+                remaining %= denom;
+            }
+        }
+    } else {
+        // Random coins until the price is covered, like a real customer
+        const QVector<int> &accepted = VendingEngine::acceptedDenominations();
+        int total = 0;
+        while (total < price) {
+            int denom = accepted.at(random.bounded(accepted.size()));
+            payment[denom]++;
+            total += denom;
+        }
+    }
+    return payment;
+}
+
+static bool createMachines(const QString &backend, const LoadConfig &config, const QString &dir,
+                           std::vector<Machine> &machines) {
+    VendingSnapshot snapshot = seedSnapshot(config);
+
+    for (int i = 0; i < config.machines; ++i) {
+        Machine machine;
+        if (backend == "sqlite") {
+            QString path = QDir(dir).filePath(QString("machine_%1.db").arg(i));
+            QFile::remove(path);
+            QFile::remove(path + "-wal");
+            QFile::remove(path + "-shm");
+
+            machine.connection = QString("loadgen_machine_%1").arg(i);
+            QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", machine.connection);
+            db.setDatabaseName(path);
+            if (!db.open() || !seedDatabase(db, snapshot)) {
+                qWarning() << "Failed to create machine database" << path << db.lastError();
+                return false;
+            }
+            machine.store.reset(new SqliteVendingStore(db));
+        } else {
+            machine.store.reset(new MemoryVendingStore(snapshot));
+        }
+
+        machine.engine.reset(new VendingEngine(machine.store.get()));
+        if (!machine.engine->load()) {
+            qWarning() << "Failed to load machine" << i << machine.engine->lastError();
+            return false;
+        }
+        machines.push_back(std::move(machine));
+    }
+    return true;
+}
+
+static void releaseMachines(std::vector<Machine> &machines) {
+    QStringList connections;
+    for (const Machine &machine : machines) {
+        if (!machine.connection.isEmpty()) {
+            connections << machine.connection;
+        }
+    }
+    machines.clear();
+
+    for (const QString &name : connections) {
+        QSqlDatabase::database(name).close();
+        QSqlDatabase::removeDatabase(name);
+    }
+}
+
+static bool runBackend(const QString &backend, const LoadConfig &config, const QString &dir,
+                       QTextStream &out) {
+    std::vector<Machine> machines;
+    if (!createMachines(backend, config, dir, machines)) {
+        releaseMachines(machines);
+        return false;
+    }
+
+    QRandomGenerator random(config.seed);
+    PopularitySampler sampler(config);
+    LatencyRecorder recorder;
+    CoinCounts refill;
+    for (int denom : VendingEngine::changeDenominations()) {
+        refill[denom] = config.changeFill;
+    }
+
+    QElapsedTimer wall;
+    QElapsedTimer timer;
+    wall.start();
+
+    for (int customer = 0; customer < config.customers; ++customer) {
+        VendingEngine &engine = *machines[random.bounded(int(machines.size()))].engine;
+        int row = sampler.sample(random);
+        QString name = engine.catalog().name(row);
+
+        // Service visit: an empty slot gets restocked before the sale
+        if (engine.catalog().stock(row) <= 0) {
+            timer.start();
+            engine.restockItem(name, config.initialStock);
+            recorder.record("restock", timer.nsecsElapsed());
+        }
+
+        CoinCounts payment = payFor(engine.catalog().price(row), config.coinMix, random);
+        timer.start();
+        PurchaseResult result = engine.purchase(name, payment);
+        recorder.record("purchase", timer.nsecsElapsed());
+
+        if (result.status == PurchaseResult::InsufficientChange) {
+            timer.start();
+            engine.refillChange(refill);
+            recorder.record("refill", timer.nsecsElapsed());
+        } else if (result.status != PurchaseResult::Ok) {
+            recorder.record("failed", 0);
+        }
+
+        const OperatingStatus &status = engine.operatingStatus();
+        if (status.collectionBoxFull()) {
+            timer.start();
+            engine.collectMoney();
+            recorder.record("collect", timer.nsecsElapsed());
+        }
+        if (status.insufficientChange()) {
+            timer.start();
+            engine.refillChange(refill);
+            recorder.record("refill", timer.nsecsElapsed());
+        }
+    }
+
+    recorder.report(out, backend, wall.nsecsElapsed());
+    out.flush();
+    releaseMachines(machines);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("loadgen");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Vending machine fleet load generator");
+    parser.addHelpOption();
+    QCommandLineOption machinesOption("machines", "Number of simulated machines.", "n", "4");
+    QCommandLineOption customersOption("customers", "Number of customers (purchase attempts).", "n", "100000");
+    QCommandLineOption itemsOption("items", "Catalog size per machine.", "n", "50");
+    QCommandLineOption stockOption("stock", "Initial and restock level per item.", "n", "20");
+    QCommandLineOption changeOption("change", "Initial and refill count per change denomination.", "n", "50");
+    QCommandLineOption popularityOption("popularity", "Item popularity: uniform or zipf.", "dist", "zipf");
+    QCommandLineOption zipfOption("zipf-s", "Zipf exponent.", "s", "1.0");
+    QCommandLineOption coinsOption("coins", "Coin mix: exact, large, random or mixed.", "mix", "mixed");
+    QCommandLineOption backendOption("backend", "Storage backend: memory, sqlite or all.", "name", "all");
+    QCommandLineOption dirOption("dir", "Directory for SQLite machine files (default: temporary).", "path");
+    QCommandLineOption seedOption("seed", "Random seed.", "n", "1");
+    parser.addOptions({machinesOption, customersOption, itemsOption, stockOption, changeOption,
+                       popularityOption, zipfOption, coinsOption, backendOption, dirOption, seedOption});
+    parser.process(app);
+
+    LoadConfig config;
+    config.machines = qMax(1, parser.value(machinesOption).toInt());
+    config.customers = qMax(0, parser.value(customersOption).toInt());
+    config.items = qMax(1, parser.value(itemsOption).toInt());
+    config.initialStock = qMax(1, parser.value(stockOption).toInt());
+    config.changeFill = qMax(0, parser.value(changeOption).toInt());
+    config.popularity = parser.value(popularityOption);
+    config.zipfExponent = parser.value(zipfOption).toDouble();
+    config.coinMix = parser.value(coinsOption);
+    config.seed = parser.value(seedOption).toUInt();
+
+    QTemporaryDir tempDir;
+    QString dir = parser.isSet(dirOption) ? parser.value(dirOption) : tempDir.path();
+    QDir().mkpath(dir);
+
+    QStringList backends = {"memory", "sqlite"};
+    if (parser.value(backendOption) != "all") {
+        backends = QStringList{parser.value(backendOption)};
+    }
+
+    QTextStream out(stdout);
+    out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+               .arg("backend", -8).arg("operation", -10).arg("count", 10).arg("ops/s", 12)
+               .arg("p50(us)", 10).arg("p99(us)", 10).arg("p999(us)", 10);
+
+    for (const QString &backend : backends) {
+        if (!runBackend(backend, config, dir, out)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,8 @@
+# Console tools built on the headless engine (vending_engine.pri)
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    coinsim \
+    controlclient \
+    fleetreport \
+    loadgen
@@ -0,0 +1,379 @@
+// transactionjournal.cpp
+#include "transactionjournal.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+// Record: u32 payload length, then the payload:
+//   u64 sequence, i64 timestamp, u8 type, u16 name length, name (UTF-8),
+//   i32 price, i32 amount, payment coins, change coins
+// where coins are a u8 count of (i32 denomination, i32 count) pairs. Cart,
+// RestockItems and DeleteItems records then list their lines: u16 count of
+// (u16 name length, name, i32 price, i32 quantity).
+const int kLengthSize = sizeof(quint32);
+const int kHeaderSize = sizeof(quint64) + sizeof(qint64) + sizeof(quint8);
+const QIODevice::OpenMode kOpenMode = QIODevice::ReadWrite | QIODevice::Append | QIODevice::Unbuffered;
+
+// Walk the record lengths to find the end of the last complete record,
+// noting the first and last sequences on the way
+qint64 scanRecords(const uchar *data, qint64 size, quint64 &first, quint64 &last) {
+    qint64 validEnd = 0;
+    while (size - validEnd >= kLengthSize + kHeaderSize) {
+        quint32 length = qFromLittleEndian<quint32>(data + validEnd);
+        if (length < quint32(kHeaderSize) || size - validEnd - kLengthSize < qint64(length)) {
+            break;
+        }
+        last = qFromLittleEndian<quint64>(data + validEnd + kLengthSize);
+        if (validEnd == 0) {
+            first = last;
+        }
+        validEnd += kLengthSize + length;
+    }
+    return validEnd;
+}
+
+template <typename T>
+void put(QByteArray &out, T value) {
+    value = qToLittleEndian(value);
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+void putCoins(QByteArray &out, const CoinCounts &coins) {
+    put<quint8>(out, quint8(coins.size()));
+    for (auto it = coins.constBegin(); it != coins.constEnd(); ++it) {
+        put<qint32>(out, it.key());
+        put<qint32>(out, it.value());
+    }
+}
+
+template <typename T>
+bool take(const uchar *&data, const uchar *end, T &value) {
+    if (end - data < qptrdiff(sizeof(T))) {
+        return false;
+    }
+    value = qFromLittleEndian<T>(data);
+    data += sizeof(T);
+    return true;
+}
+
+bool takeCoins(const uchar *&data, const uchar *end, CoinCounts &coins) {
+    coins.clear();
+    quint8 count;
+    if (!take(data, end, count)) {
+        return false;
+    }
+    for (int i = 0; i < count; ++i) {
+        qint32 denomination, value;
+        if (!take(data, end, denomination) || !take(data, end, value)) {
+            return false;
+        }
+        coins.insert(denomination, value);
+    }
+    return true;
+}
+}
+
+TransactionJournal::TransactionJournal() {
+    // Reserved capacity survives resize(0), so appends reuse one buffer
+    record.reserve(256);
+}
+
+TransactionJournal::~TransactionJournal() {
+    close();
+}
+
+bool TransactionJournal::open(const QString &path) {
+    close();
+    file.setFileName(path);
+    rotatedPath = path + ".1";
+    firstSequence = 0;
+    sequence = 0;
+    if (!file.open(kOpenMode)) {
+        errorText = file.errorString();
+        return false;
+    }
+
+    qint64 size = file.size();
+    qint64 validEnd = 0;
+    if (size > 0) {
+        uchar *data = file.map(0, size);
+        if (!data) {
+            errorText = file.errorString();
+            file.close();
+            return false;
+        }
+        validEnd = scanRecords(data, size, firstSequence, sequence);
+        file.unmap(data);
+    }
+
+    // Just after a compaction, numbering goes on from the rotated file
+    if (validEnd == 0) {
+        QFile rotated(rotatedPath);
+        if (rotated.open(QIODevice::ReadOnly) && rotated.size() > 0) {
+            uchar *data = rotated.map(0, rotated.size());
+            if (data) {
+                quint64 rotatedFirst = 0;
+                scanRecords(data, rotated.size(), rotatedFirst, sequence);
+                rotated.unmap(data);
+            }
+        }
+    }
+
+    if (validEnd < size) {
+        qWarning() << "Journal" << path << "has a torn tail of" << (size - validEnd) << "bytes; truncating";
+        if (!file.resize(validEnd)) {
+            errorText = file.errorString();
+            file.close();
+            return false;
+        }
+    }
+    end = validEnd;
+    return true;
+}
+
+void TransactionJournal::close() {
+    if (file.isOpen()) {
+        file.close();
+    }
+    names.clear();
+}
+
+void TransactionJournal::ensureSequenceAtLeast(quint64 minimum) {
+    sequence = qMax(sequence, minimum);
+}
+
+bool TransactionJournal::compact(quint64 checkpointSequence) {
+    if (!file.isOpen() || end == 0 || checkpointSequence < sequence) {
+        return true;
+    }
+
+    // The rename is atomic: a crash leaves either generation in place, and
+    // open() carries the numbering over an empty current file
+    QString path = file.fileName();
+    file.close();
+    QFile::remove(rotatedPath);
+    bool rotated = QFile::rename(path, rotatedPath);
+    if (!rotated) {
+        errorText = QString("Failed to rotate %1 to %2").arg(path, rotatedPath);
+    }
+    if (!file.open(kOpenMode)) {
+        errorText = file.errorString();
+        return false;
+    }
+    if (rotated) {
+        end = 0;
+        firstSequence = 0;
+    }
+    return rotated;
+}
+
+bool TransactionJournal::append(JournalEvent &event) {
+    static LatencyHistogram *const latency = Metrics::latency("journal_append");
+    ScopedTimer timer(latency);
+
+    if (!file.isOpen()) {
+        errorText = "Journal is not open";
+        return false;
+    }
+
+    // Lengths and counts are framed as u16; a larger one would write a
+    // wrong prefix ahead of the full field and break every later record
+    if (event.lines.size() > 0xFFFF) {
+        errorText = QString("Too many items in one event (%1)").arg(event.lines.size());
+        return false;
+    }
+    QByteArray name = event.itemName.toUtf8();
+    if (name.size() > 0xFFFF) {
+        errorText = QString("Item name too long (%1 bytes)").arg(name.size());
+        return false;
+    }
+
+    event.sequence = sequence + 1;
+    event.timestamp = QDateTime::currentMSecsSinceEpoch();
+
+    record.resize(0);
+    put<quint32>(record, 0); // patched below
+    put<quint64>(record, event.sequence);
+    put<qint64>(record, event.timestamp);
+    put<quint8>(record, event.type);
+    put<quint16>(record, quint16(name.size()));
+    record.append(name);
+    put<qint32>(record, event.price);
+    put<qint32>(record, event.amount);
+    putCoins(record, event.payment);
+    putCoins(record, event.change);
+    if (JournalEvent::hasLines(event.type)) {
+        put<quint16>(record, quint16(event.lines.size()));
+        for (const JournalEvent::Line &line : event.lines) {
+            QByteArray lineName = line.itemName.toUtf8();
+            if (lineName.size() > 0xFFFF) {
+                errorText = QString("Item name too long (%1 bytes)").arg(lineName.size());
+                return false;
+            }
+            put<quint16>(record, quint16(lineName.size()));
+            record.append(lineName);
+            put<qint32>(record, line.price);
+            put<qint32>(record, line.quantity);
+        }
+    }
+    qToLittleEndian<quint32>(quint32(record.size() - kLengthSize), record.data());
+
+    // One sequential write per event. A failed or short one is cut back off,
+    // so the next append does not land behind a torn record.
+    if (file.write(record) != record.size()) {
+        errorText = file.errorString();
+        file.resize(end);
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    if (syncOnAppend && ::fdatasync(file.handle()) != 0) {
+        errorText = "fdatasync failed";
+        file.resize(end);
+        return false;
+    }
+#endif
+
+    end += record.size();
+    if (firstSequence == 0) {
+        firstSequence = event.sequence;
+    }
+    sequence = event.sequence;
+    return true;
+}
+
+// Fails unless the fields fill the record exactly, so a misframed record is
+// reported rather than read as something else
+bool TransactionJournal::decode(const uchar *data, quint32 length, JournalEvent &event) {
+    const uchar *end = data + length;
+    quint8 type;
+    quint16 nameLength;
+    qint32 price, amount;
+
+    if (!take(data, end, event.sequence) || !take(data, end, event.timestamp)
+        || !take(data, end, type) || !take(data, end, nameLength)
+        || end - data < nameLength) {
+        return false;
+    }
+    event.type = JournalEvent::Type(type);
+
+    event.itemName = internName(data, nameLength);
+    data += nameLength;
+
+    if (!take(data, end, price) || !take(data, end, amount)) {
+        return false;
+    }
+    event.price = price;
+    event.amount = amount;
+    if (!takeCoins(data, end, event.payment) || !takeCoins(data, end, event.change)) {
+        return false;
+    }
+
+    event.lines.clear();
+    if (!JournalEvent::hasLines(event.type)) {
+        return data == end;
+    }
+    quint16 lineCount;
+    if (!take(data, end, lineCount)) {
+        return false;
+    }
+    for (int i = 0; i < lineCount; ++i) {
+        JournalEvent::Line line;
+        qint32 linePrice, quantity;
+        if (!take(data, end, nameLength) || end - data < nameLength) {
+            return false;
+        }
+        line.itemName = internName(data, nameLength);
+        data += nameLength;
+        if (!take(data, end, linePrice) || !take(data, end, quantity)) {
+            return false;
+        }
+        line.price = linePrice;
+        line.quantity = quantity;
+        event.lines.append(line);
+    }
+    return data == end;
+}
+
+// Intern names so replaying many sales of one item decodes it once
+QString TransactionJournal::internName(const uchar *data, int length) {
+    QByteArray rawName = QByteArray::fromRawData(reinterpret_cast<const char *>(data), length);
+    auto name = names.constFind(rawName);
+    if (name == names.constEnd()) {
+        name = names.insert(QByteArray(rawName.constData(), rawName.size()), QString::fromUtf8(rawName));
+    }
+    return name.value();
+}
+
+qint64 TransactionJournal::replay(quint64 afterSequence,
+                                  const std::function<void(const JournalEvent &)> &handler) {
+    // A checkpoint older than this file also needs the rotated generation
+    qint64 replayed = 0;
+    quint64 oldest = firstSequence > 0 ? firstSequence : sequence + 1;
+    if (afterSequence + 1 < oldest && QFile::exists(rotatedPath)) {
+        QFile rotated(rotatedPath);
+        if (!rotated.open(QIODevice::ReadOnly)) {
+            errorText = rotated.errorString();
+            return -1;
+        }
+        replayed = replayFile(rotated, afterSequence, handler);
+        if (replayed < 0) {
+            return -1;
+        }
+    }
+
+    qint64 current = replayFile(file, afterSequence, handler);
+    return current < 0 ? -1 : replayed + current;
+}
+
+qint64 TransactionJournal::replayFile(QFile &source, quint64 afterSequence,
+                                      const std::function<void(const JournalEvent &)> &handler) {
+    qint64 size = source.size();
+    if (size == 0) {
+        return 0;
+    }
+
+    uchar *data = source.map(0, size);
+    if (!data) {
+        errorText = source.errorString();
+        return -1;
+    }
+
+    JournalEvent event;
+    qint64 replayed = 0;
+    qint64 offset = 0;
+    while (offset < size) {
+        // A torn tail, or a length running past the end of the file, ends
+        // the journal; nothing after it can be framed
+        if (size - offset < kLengthSize + kHeaderSize) {
+            break;
+        }
+        quint32 length = qFromLittleEndian<quint32>(data + offset);
+        if (length < quint32(kHeaderSize) || size - offset - kLengthSize < qint64(length)) {
+            break;
+        }
+        const uchar *payload = data + offset + kLengthSize;
+        offset += kLengthSize + length;
+
+        // Skip what the checkpoint already holds without decoding it
+        if (qFromLittleEndian<quint64>(payload) <= afterSequence) {
+            continue;
+        }
+
+        if (!decode(payload, length, event)) {
+            errorText = QString("Corrupt journal record at offset %1").arg(offset - kLengthSize - length);
+            source.unmap(data);
+            return -1;
+        }
+        handler(event);
+        replayed++;
+    }
+
+    source.unmap(data);
+    return replayed;
+}
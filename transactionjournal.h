@@ -0,0 +1,108 @@
+// transactionjournal.h
+#ifndef TRANSACTIONJOURNAL_H
+#define TRANSACTIONJOURNAL_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include "changesolver.h"
+
+struct JournalEvent {
+    enum Type : quint8 {
+        Purchase = 1,
+        Restock,
+        Refill,
+        Collect,
+        AddItem,
+        DeleteItem,
+        Cart,
+        RestockItems,
+        DeleteItems,
+        RestockToPar
+    };
+
+    // Cart: one item bought, quantity units at price each;
+    // RestockItems: quantity units added; DeleteItems: the name only
+    struct Line {
+        QString itemName;
+        int price = 0;
+        int quantity = 0;
+    };
+
+    quint64 sequence = 0;
+    qint64 timestamp = 0; // ms since epoch
+    Type type = Purchase;
+    QString itemName;
+    int price = 0;        // AddItem: price, Purchase/Cart: price charged
+    int amount = 0;       // Restock: units added, AddItem: initial stock, Cart: units,
+                          // RestockToPar: the par level
+    CoinCounts payment;   // Purchase/Cart: coins inserted, Refill: coins added
+    CoinCounts change;    // Purchase/Cart: coins returned
+    QVector<Line> lines;  // Cart, RestockItems, DeleteItems: one line per item
+
+    // Whether records of this type list lines
+    static bool hasLines(Type type) { return type == Cart || type == RestockItems || type == DeleteItems; }
+};
+
+// Append-only log of every state-changing event. It is the source of truth
+// for the machine: the SQLite tables are a checkpoint of it, and anything
+// appended after the checkpoint is replayed into the engine at startup.
+//
+// Records are length-prefixed little-endian binary, each written with a
+// single unbuffered write. Reads go through a memory map of the file.
+class TransactionJournal {
+public:
+    TransactionJournal();
+    ~TransactionJournal();
+
+    // Opens (creating if needed) and validates the journal; a record torn
+    // by a crash mid-append is cut off
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    // Assigns the next sequence number and timestamp, then appends
+    bool append(JournalEvent &event);
+
+    // Calls handler for every event with a sequence above afterSequence;
+    // returns the number of events replayed, or -1 on error
+    qint64 replay(quint64 afterSequence, const std::function<void(const JournalEvent &)> &handler);
+
+    quint64 lastSequence() const { return sequence; }
+
+    // Continue numbering from here if a checkpoint is ahead of the journal
+    void ensureSequenceAtLeast(quint64 minimum);
+
+    // Once the tables hold every event up to checkpointSequence, rotate the
+    // file out to <path>.1 so the next start walks only newer records. The
+    // rotated generation is still replayed for an older checkpoint, e.g. a
+    // restored backup.
+    bool compact(quint64 checkpointSequence);
+
+    // fdatasync after each append; off by default, as the OS page cache
+    // already survives an application crash
+    void setSyncOnAppend(bool enabled) { syncOnAppend = enabled; }
+
+    QString lastError() const { return errorText; }
+
+private:
+    qint64 replayFile(QFile &source, quint64 afterSequence,
+                      const std::function<void(const JournalEvent &)> &handler);
+    bool decode(const uchar *data, quint32 length, JournalEvent &event);
+    QString internName(const uchar *data, int length);
+
+    QFile file;
+    QString rotatedPath;
+    qint64 end = 0;              // bytes of complete records
+    quint64 firstSequence = 0;   // 0 while the file is empty
+    quint64 sequence = 0;
+    bool syncOnAppend = false;
+    QByteArray record;
+    QHash<QByteArray, QString> names; // interned item names for replay
+    QString errorText;
+};
+
+#endif // TRANSACTIONJOURNAL_H
@@ -0,0 +1,38 @@
+# Headless purchase engine shared by the GUI and any console tools.
+# Depends only on QtCore and QtSql, never on QtWidgets.
+QT += core sql
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/asyncstore.cpp \
+    $$PWD/catalog.cpp \
+    $$PWD/catalogio.cpp \
+    $$PWD/changesolver.cpp \
+    $$PWD/databasebackup.cpp \
+    $$PWD/headlesscontroller.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/paymentsession.cpp \
+    $$PWD/salesanalytics.cpp \
+    $$PWD/salesforecaster.cpp \
+    $$PWD/sqlitestore.cpp \
+    $$PWD/transactionjournal.cpp \
+    $$PWD/vendingengine.cpp
+
+HEADERS += \
+    $$PWD/asyncstore.h \
+    $$PWD/catalog.h \
+    $$PWD/catalogio.h \
+    $$PWD/changesolver.h \
+    $$PWD/currency.h \
+    $$PWD/database.h \
+    $$PWD/databasebackup.h \
+    $$PWD/headlesscontroller.h \
+    $$PWD/metrics.h \
+    $$PWD/operatingstatus.h \
+    $$PWD/paymentsession.h \
+    $$PWD/salesanalytics.h \
+    $$PWD/salesforecaster.h \
+    $$PWD/sqlitestore.h \
+    $$PWD/transactionjournal.h \
+    $$PWD/vendingengine.h
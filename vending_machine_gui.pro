@@ -1,4 +1,4 @@
-QT       += core gui sql
+QT       += core gui sql network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -8,13 +8,20 @@ CONFIG += c++17
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+include(vending_engine.pri)
+
 SOURCES += \
+    coinsource.cpp \
+    controlserver.cpp \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    vendingmodels.cpp
 
 HEADERS += \
-    database.h \
-    mainwindow.h
+    coinsource.h \
+    controlserver.h \
+    mainwindow.h \
+    vendingmodels.h
 
 FORMS += \
     mainwindow.ui
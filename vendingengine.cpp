@@ -0,0 +1,817 @@
+// vendingengine.cpp
+#include "vendingengine.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <QDebug>
+#include <limits>
+
+namespace {
+// Whether amount may be added to a stock or coin count of current: it must
+// add something, and the sum must still fit the int every count is kept in
+bool canAdd(int current, int amount) {
+    return amount > 0 && qint64(current) + amount <= std::numeric_limits<int>::max();
+}
+}
+
+MemoryVendingStore::MemoryVendingStore(const VendingSnapshot &initial)
+    : initial(initial) {
+}
+
+bool MemoryVendingStore::load(VendingSnapshot &snapshot) {
+    snapshot = initial;
+    return true;
+}
+
+bool MemoryVendingStore::saveCheckpoint(const VendingSnapshot &snapshot) {
+    initial = snapshot;
+    return true;
+}
+
+VendingEngine::VendingEngine(VendingStore *store, QObject *parent)
+    : QObject(parent), store(store),
+      changeSolver(changeDenominations(), Currency::Accepted::largest()) {
+}
+
+bool VendingEngine::setJournal(TransactionJournal *journal) {
+    if (journal && store->isMultiTerminal()) {
+        errorText = "A journal cannot be kept over tables shared with other terminals";
+        return false;
+    }
+    this->journal = journal;
+    return true;
+}
+
+const QVector<int> &VendingEngine::acceptedDenominations() {
+    static const QVector<int> denominations = Currency::Accepted::toVector();
+    return denominations;
+}
+
+const QVector<int> &VendingEngine::changeDenominations() {
+    static const QVector<int> denominations = Currency::Dispensable::toVector();
+    return denominations;
+}
+
+bool VendingEngine::load() {
+    static LatencyHistogram *const latency = Metrics::latency("load");
+    ScopedTimer timer(latency);
+
+    VendingSnapshot checkpoint;
+    if (!store->load(checkpoint)) {
+        errorText = store->lastError();
+        return false;
+    }
+
+    itemCatalog.assign(checkpoint.items);
+    changeCounts = checkpoint.changeBox;
+    collectionCounts = checkpoint.collectionBox;
+
+    if (journal) {
+        // Roll the checkpoint forward with everything logged after it
+        bool keepSales = store->recordsSales();
+        QVector<SaleRecord> replayedSales;
+        qint64 replayed = journal->replay(checkpoint.journalSequence, [&](const JournalEvent &event) {
+            applyEvent(event);
+            if (keepSales && event.type == JournalEvent::Purchase) {
+                replayedSales.append({event.itemName, event.price, 1, event.payment, event.change, event.timestamp});
+            } else if (keepSales && event.type == JournalEvent::Cart) {
+                for (int i = 0; i < event.lines.size(); ++i) {
+                    const JournalEvent::Line &line = event.lines.at(i);
+                    replayedSales.append({line.itemName, line.price, line.quantity,
+                                          i == 0 ? event.payment : CoinCounts(),
+                                          i == 0 ? event.change : CoinCounts(), event.timestamp});
+                }
+            }
+        });
+        if (replayed < 0) {
+            errorText = journal->lastError();
+            return false;
+        }
+        journal->ensureSequenceAtLeast(checkpoint.journalSequence);
+
+        // Fold the replayed tail into a fresh checkpoint so the next start
+        // has nothing to replay
+        VendingSnapshot current = snapshot();
+        current.unrecordedSales = replayedSales;
+        if (replayed > 0 && !store->saveCheckpoint(current)) {
+            qWarning() << "Failed to checkpoint replayed journal:" << store->lastError();
+        }
+
+        // Tables that already held every event let the journal start afresh
+        if (replayed == 0 && !journal->compact(checkpoint.journalSequence)) {
+            qWarning() << "Failed to compact journal:" << journal->lastError();
+        }
+    }
+
+    // Seed the status counters once; every later mutation keeps them current
+    status.clear();
+    for (int row = 0; row < itemCatalog.size(); ++row) {
+        status.itemAdded(itemCatalog.stock(row));
+    }
+    for (int count : changeCounts) {
+        status.changeCountChanged(-1, count);
+    }
+    for (int count : collectionCounts) {
+        status.collectionCountChanged(0, count);
+    }
+
+    emit reset();
+    updateOperational();
+    return true;
+}
+
+VendingSnapshot VendingEngine::snapshot() const {
+    VendingSnapshot current;
+    current.items = itemCatalog.toItems();
+    current.changeBox = changeCounts;
+    current.collectionBox = collectionCounts;
+    current.journalSequence = journal ? journal->lastSequence() : 0;
+    return current;
+}
+
+// Apply a logged event to the raw state only; load() seeds the status
+// counters and notifies views once replay is complete
+void VendingEngine::applyEvent(const JournalEvent &event) {
+    int row = findItem(event.itemName);
+
+    switch (event.type) {
+    case JournalEvent::Purchase:
+        for (auto it = event.change.constBegin(); it != event.change.constEnd(); ++it) {
+            changeCounts[it.key()] -= it.value();
+        }
+        for (auto it = event.payment.constBegin(); it != event.payment.constEnd(); ++it) {
+            collectionCounts[it.key()] += it.value();
+        }
+        if (row >= 0) {
+            itemCatalog.addStock(row, -1);
+        }
+        forecaster.recordSale(event.itemName, event.payment, event.timestamp);
+        break;
+    case JournalEvent::Cart:
+        for (auto it = event.change.constBegin(); it != event.change.constEnd(); ++it) {
+            changeCounts[it.key()] -= it.value();
+        }
+        for (auto it = event.payment.constBegin(); it != event.payment.constEnd(); ++it) {
+            collectionCounts[it.key()] += it.value();
+        }
+        for (int i = 0; i < event.lines.size(); ++i) {
+            const JournalEvent::Line &line = event.lines.at(i);
+            int lineRow = findItem(line.itemName);
+            if (lineRow >= 0) {
+                itemCatalog.addStock(lineRow, -line.quantity);
+            }
+            forecaster.recordSale(line.itemName, i == 0 ? event.payment : CoinCounts(), event.timestamp,
+                                  line.quantity);
+        }
+        break;
+    case JournalEvent::Restock:
+        if (row >= 0) {
+            itemCatalog.addStock(row, event.amount);
+        }
+        break;
+    case JournalEvent::Refill:
+        for (auto it = event.payment.constBegin(); it != event.payment.constEnd(); ++it) {
+            changeCounts[it.key()] += it.value();
+        }
+        break;
+    case JournalEvent::Collect:
+        for (auto it = collectionCounts.begin(); it != collectionCounts.end(); ++it) {
+            it.value() = 0;
+        }
+        break;
+    case JournalEvent::AddItem:
+        if (row < 0) {
+            itemCatalog.append(event.itemName, event.price, event.amount);
+        }
+        break;
+    case JournalEvent::DeleteItem:
+        if (row >= 0) {
+            itemCatalog.remove(row);
+        }
+        forecaster.forgetItem(event.itemName);
+        break;
+    case JournalEvent::RestockItems:
+        for (const JournalEvent::Line &line : event.lines) {
+            int lineRow = findItem(line.itemName);
+            if (lineRow >= 0) {
+                itemCatalog.addStock(lineRow, line.quantity);
+            }
+        }
+        break;
+    case JournalEvent::DeleteItems:
+        for (const JournalEvent::Line &line : event.lines) {
+            int lineRow = findItem(line.itemName);
+            if (lineRow >= 0) {
+                itemCatalog.remove(lineRow);
+            }
+            forecaster.forgetItem(line.itemName);
+        }
+        break;
+    case JournalEvent::RestockToPar:
+        for (int i = 0; i < itemCatalog.size(); ++i) {
+            if (itemCatalog.stock(i) < event.amount) {
+                itemCatalog.addStock(i, event.amount - itemCatalog.stock(i));
+            }
+        }
+        break;
+    }
+}
+
+bool VendingEngine::record(JournalEvent &event) {
+    if (!journal) {
+        return true;
+    }
+    if (!journal->append(event)) {
+        errorText = journal->lastError();
+        return false;
+    }
+    store->setJournalSequence(event.sequence);
+    return true;
+}
+
+// With a journal the event is already durable and the tables are only its
+// checkpoint. A failed table write holds the store's sequence back until the
+// next mutation rewrites the tables from memory, so until then replay at
+// start covers it. A lost race is not such a failure: the tables are right
+// and this engine's state is stale, so it is always reported.
+bool VendingEngine::checkpointed(bool stored) {
+    if (stored) {
+        return true;
+    }
+    errorText = store->lastError();
+    if (journal && !store->conflicted()) {
+        qWarning() << "Checkpoint write failed, rewriting it before the next change:" << errorText;
+        store->markNeedsCheckpoint();
+        return true;
+    }
+    return false;
+}
+
+// The store lost a write this engine kept, in a failed group commit or a
+// failed checkpoint write. With a journal memory holds every logged event,
+// so the tables are rewritten from it; without one, or when other terminals
+// share the tables, they are all there is, so memory is reloaded from them.
+void VendingEngine::repairStore() {
+    static Counter *const repairs =
+        Metrics::counter("vending_store_repairs", "Times the tables were rewritten or reloaded after losing a write.");
+
+    if (!store->needsCheckpoint()) {
+        return;
+    }
+    repairs->increment();
+    if (!journal || store->isMultiTerminal()) {
+        qWarning() << "Store lost writes, reloading its state";
+        if (!load()) {
+            qWarning() << "Reload failed:" << errorText;
+        }
+        return;
+    }
+    if (!store->saveCheckpoint(snapshot())) {
+        qWarning() << "Checkpoint repair failed:" << store->lastError();
+    }
+}
+
+int VendingEngine::findItem(const QString &itemName) const {
+    return itemCatalog.find(itemName);
+}
+
+bool VendingEngine::computeChange(int changeAmount, CoinCounts &change) {
+    // Solver tables cover every amount up to the largest accepted note and
+    // are cached per change box state
+    return changeSolver.solve(changeCounts, changeAmount, change);
+}
+
+PurchaseResult VendingEngine::purchase(const QString &itemName, const CoinCounts &payment) {
+    static LatencyHistogram *const latency = Metrics::latency("purchase");
+    ScopedTimer timer(latency);
+    repairStore();
+    return retried([&]() { return attemptPurchase(itemName, payment); });
+}
+
+PurchaseResult VendingEngine::purchaseCart(const QVector<CartLine> &lines, const CoinCounts &payment) {
+    static LatencyHistogram *const latency = Metrics::latency("purchase_cart");
+    ScopedTimer timer(latency);
+    repairStore();
+    return retried([&]() { return attemptCart(lines, payment); });
+}
+
+PurchaseResult VendingEngine::retried(const std::function<PurchaseResult()> &attempt) {
+    static Counter *const conflicts =
+        Metrics::counter("vending_purchase_conflicts", "Sales retried after losing a race with another terminal.");
+
+    // Another terminal sharing the store may have sold the last unit or
+    // taken the change since this engine loaded; the store refuses such a
+    // sale, so reload and decide again on what is really there
+    for (int attemptNumber = 1;; ++attemptNumber) {
+        PurchaseResult result = attempt();
+        if (result.status != PurchaseResult::StorageError || !store->conflicted()
+            || attemptNumber == kMaxPurchaseAttempts) {
+            return result;
+        }
+        conflicts->increment();
+        if (!load()) {
+            return result;
+        }
+    }
+}
+
+PurchaseResult VendingEngine::attemptPurchase(const QString &itemName, const CoinCounts &payment) {
+    PurchaseResult result;
+
+    int row = findItem(itemName);
+    if (row < 0) {
+        result.status = PurchaseResult::UnknownItem;
+        return result;
+    }
+
+    // The catalog's copy of the name is shared by the journal event and the
+    // sale record instead of the caller's
+    const QString &name = itemCatalog.name(row);
+    const int price = itemCatalog.price(row);
+    const int stock = itemCatalog.stock(row);
+    result.price = price;
+    if (stock <= 0) {
+        result.status = PurchaseResult::OutOfStock;
+        return result;
+    }
+
+    if (!takePayment(payment, result)) {
+        return result;
+    }
+
+    // Persist first so memory never runs ahead of the journal or store
+    JournalEvent event;
+    event.type = JournalEvent::Purchase;
+    event.itemName = name;
+    event.price = price;
+    event.payment = payment;
+    event.change = result.change;
+    if (!record(event)) {
+        result.status = PurchaseResult::StorageError;
+        return result;
+    }
+
+    SaleRecord sale;
+    sale.itemName = name;
+    sale.price = price;
+    sale.payment = payment;
+    sale.change = result.change;
+    sale.soldAt = journal ? event.timestamp : QDateTime::currentMSecsSinceEpoch();
+    if (!checkpointed(store->commitPurchase(sale))) {
+        result.status = PurchaseResult::StorageError;
+        return result;
+    }
+
+    for (auto it = result.change.constBegin(); it != result.change.constEnd(); ++it) {
+        adjustChangeBox(it.key(), -it.value());
+    }
+    for (auto it = payment.constBegin(); it != payment.constEnd(); ++it) {
+        if (it.value() > 0) {
+            adjustCollectionBox(it.key(), it.value());
+        }
+    }
+    forecaster.recordSale(name, payment, sale.soldAt);
+    status.stockChanged(stock, stock - 1);
+    itemCatalog.addStock(row, -1);
+    emit itemChanged(row);
+    updateOperational();
+
+    return result;
+}
+
+// Totals the payment and solves the change for result.price; false with
+// result.status set when the payment cannot be taken
+bool VendingEngine::takePayment(const CoinCounts &payment, PurchaseResult &result) {
+    qint64 total = 0;
+    for (auto it = payment.constBegin(); it != payment.constEnd(); ++it) {
+        if (!isAcceptedDenomination(it.key()) || it.value() < 0) {
+            result.status = PurchaseResult::InvalidDenomination;
+            return false;
+        }
+        total += qint64(it.key()) * it.value();
+        if (total > kMaxPayment) {
+            result.status = PurchaseResult::PaymentTooLarge;
+            return false;
+        }
+    }
+    result.totalPayment = int(total);
+
+    if (result.totalPayment < result.price) {
+        result.status = PurchaseResult::InsufficientPayment;
+        return false;
+    }
+
+    if (!computeChange(result.totalPayment - result.price, result.change)) {
+        result.status = PurchaseResult::InsufficientChange;
+        result.change.clear();
+        return false;
+    }
+    return true;
+}
+
+PurchaseResult VendingEngine::attemptCart(const QVector<CartLine> &lines, const CoinCounts &payment) {
+    PurchaseResult result;
+
+    // Merge repeated items so each is checked against its stock once. Units
+    // are bounded before they are summed, so no quantity or total can wrap.
+    QVector<int> rows;
+    QVector<int> quantities;
+    int units = 0;
+    for (const CartLine &line : lines) {
+        if (line.quantity <= 0 || line.quantity > kMaxCartUnits - units) {
+            result.status = PurchaseResult::InvalidQuantity;
+            result.refusedItem = line.itemName;
+            return result;
+        }
+        units += line.quantity;
+        int row = findItem(line.itemName);
+        if (row < 0) {
+            result.status = PurchaseResult::UnknownItem;
+            result.refusedItem = line.itemName;
+            return result;
+        }
+        int index = rows.indexOf(row);
+        if (index < 0) {
+            rows.append(row);
+            quantities.append(line.quantity);
+        } else {
+            quantities[index] += line.quantity;
+        }
+    }
+    if (rows.isEmpty()) {
+        result.status = PurchaseResult::UnknownItem;
+        return result;
+    }
+
+    qint64 total = 0;
+    for (int i = 0; i < rows.size(); ++i) {
+        if (itemCatalog.stock(rows.at(i)) < quantities.at(i)) {
+            result.status = PurchaseResult::OutOfStock;
+            result.refusedItem = itemCatalog.name(rows.at(i));
+            return result;
+        }
+        total += qint64(itemCatalog.price(rows.at(i))) * quantities.at(i);
+    }
+    // Nothing could pay for more, and the total must fit the int amounts
+    // the solver and the journal use
+    if (total > kMaxPayment) {
+        result.status = PurchaseResult::PaymentTooLarge;
+        return result;
+    }
+    result.price = int(total);
+
+    // One change solve for the whole cart
+    if (!takePayment(payment, result)) {
+        return result;
+    }
+
+    JournalEvent event;
+    event.type = JournalEvent::Cart;
+    event.price = result.price;
+    event.amount = units;
+    event.payment = payment;
+    event.change = result.change;
+    for (int i = 0; i < rows.size(); ++i) {
+        event.lines.append({itemCatalog.name(rows.at(i)), itemCatalog.price(rows.at(i)), quantities.at(i)});
+    }
+    if (!record(event)) {
+        result.status = PurchaseResult::StorageError;
+        return result;
+    }
+
+    // The cart's coins go on its first record, so the history adds up to
+    // one payment
+    qint64 soldAt = journal ? event.timestamp : QDateTime::currentMSecsSinceEpoch();
+    QVector<SaleRecord> sales;
+    sales.reserve(rows.size());
+    for (const JournalEvent::Line &line : event.lines) {
+        SaleRecord sale;
+        sale.itemName = line.itemName;
+        sale.price = line.price;
+        sale.quantity = line.quantity;
+        sale.soldAt = soldAt;
+        sales.append(sale);
+    }
+    sales.first().payment = payment;
+    sales.first().change = result.change;
+    if (!checkpointed(store->commitCart(sales))) {
+        result.status = PurchaseResult::StorageError;
+        return result;
+    }
+
+    for (auto it = result.change.constBegin(); it != result.change.constEnd(); ++it) {
+        adjustChangeBox(it.key(), -it.value());
+    }
+    for (auto it = payment.constBegin(); it != payment.constEnd(); ++it) {
+        if (it.value() > 0) {
+            adjustCollectionBox(it.key(), it.value());
+        }
+    }
+    for (int i = 0; i < rows.size(); ++i) {
+        int row = rows.at(i);
+        int stock = itemCatalog.stock(row);
+        forecaster.recordSale(sales.at(i).itemName, sales.at(i).payment, soldAt, quantities.at(i));
+        status.stockChanged(stock, stock - quantities.at(i));
+        itemCatalog.addStock(row, -quantities.at(i));
+        emit itemChanged(row);
+    }
+    updateOperational();
+
+    return result;
+}
+
+bool VendingEngine::addItem(const QString &itemName, int price, int stock) {
+    static LatencyHistogram *const latency = Metrics::latency("add_item");
+    ScopedTimer timer(latency);
+    repairStore();
+
+    if (findItem(itemName) >= 0) {
+        errorText = "Item already exists";
+        return false;
+    }
+
+    StockItem item;
+    item.name = itemName;
+    item.price = price;
+    item.stock = stock;
+
+    JournalEvent event;
+    event.type = JournalEvent::AddItem;
+    event.itemName = itemName;
+    event.price = price;
+    event.amount = stock;
+    if (!record(event) || !checkpointed(store->addItem(item))) {
+        return false;
+    }
+
+    int row = itemCatalog.append(itemName, price, stock);
+    status.itemAdded(stock);
+    emit itemAdded(row);
+    updateOperational();
+    return true;
+}
+
+bool VendingEngine::deleteItem(const QString &itemName) {
+    static LatencyHistogram *const latency = Metrics::latency("delete_item");
+    ScopedTimer timer(latency);
+    repairStore();
+
+    int row = findItem(itemName);
+    if (row < 0) {
+        errorText = "Unknown item";
+        return false;
+    }
+
+    JournalEvent event;
+    event.type = JournalEvent::DeleteItem;
+    event.itemName = itemName;
+    if (!record(event) || !checkpointed(store->deleteItem(itemName))) {
+        return false;
+    }
+
+    emit itemAboutToBeRemoved(row);
+    status.itemRemoved(itemCatalog.stock(row));
+    itemCatalog.remove(row);
+    forecaster.forgetItem(itemName);
+    emit itemRemoved(row);
+    updateOperational();
+    return true;
+}
+
+bool VendingEngine::restockItem(const QString &itemName, int amount) {
+    static LatencyHistogram *const latency = Metrics::latency("restock_item");
+    ScopedTimer timer(latency);
+    repairStore();
+
+    int row = findItem(itemName);
+    if (row < 0) {
+        errorText = "Unknown item";
+        return false;
+    }
+    if (!canAdd(itemCatalog.stock(row), amount)) {
+        errorText = QString("Cannot restock %1 by %2").arg(itemName).arg(amount);
+        return false;
+    }
+
+    JournalEvent event;
+    event.type = JournalEvent::Restock;
+    event.itemName = itemName;
+    event.amount = amount;
+    if (!record(event) || !checkpointed(store->restockItem(itemName, amount))) {
+        return false;
+    }
+
+    status.stockChanged(itemCatalog.stock(row), itemCatalog.stock(row) + amount);
+    itemCatalog.addStock(row, amount);
+    emit itemChanged(row);
+    updateOperational();
+    return true;
+}
+
+// Rows of every name, or false naming the first one unknown
+bool VendingEngine::findItems(const QStringList &itemNames, QVector<int> &rows) {
+    rows.clear();
+    rows.reserve(itemNames.size());
+    for (const QString &itemName : itemNames) {
+        int row = findItem(itemName);
+        if (row < 0) {
+            errorText = "Unknown item: " + itemName;
+            return false;
+        }
+        rows.append(row);
+    }
+    return true;
+}
+
+bool VendingEngine::restockItems(const QMap<QString, int> &amounts) {
+    static LatencyHistogram *const latency = Metrics::latency("restock_items");
+    ScopedTimer timer(latency);
+    repairStore();
+
+    QVector<int> rows;
+    if (!findItems(amounts.keys(), rows)) {
+        return false;
+    }
+    int i = 0;
+    for (auto it = amounts.constBegin(); it != amounts.constEnd(); ++it, ++i) {
+        if (!canAdd(itemCatalog.stock(rows.at(i)), it.value())) {
+            errorText = QString("Cannot restock %1 by %2").arg(it.key()).arg(it.value());
+            return false;
+        }
+    }
+
+    JournalEvent event;
+    event.type = JournalEvent::RestockItems;
+    for (auto it = amounts.constBegin(); it != amounts.constEnd(); ++it) {
+        event.lines.append({it.key(), 0, it.value()});
+    }
+    if (!record(event) || !checkpointed(store->restockItems(amounts))) {
+        return false;
+    }
+
+    i = 0;
+    for (auto it = amounts.constBegin(); it != amounts.constEnd(); ++it, ++i) {
+        int row = rows.at(i);
+        status.stockChanged(itemCatalog.stock(row), itemCatalog.stock(row) + it.value());
+        itemCatalog.addStock(row, it.value());
+        emit itemChanged(row);
+    }
+    updateOperational();
+    return true;
+}
+
+bool VendingEngine::deleteItems(const QStringList &itemNames) {
+    static LatencyHistogram *const latency = Metrics::latency("delete_items");
+    ScopedTimer timer(latency);
+    repairStore();
+
+    QVector<int> rows;
+    if (!findItems(itemNames, rows)) {
+        return false;
+    }
+
+    JournalEvent event;
+    event.type = JournalEvent::DeleteItems;
+    for (const QString &itemName : itemNames) {
+        event.lines.append({itemName, 0, 0});
+    }
+    if (!record(event) || !checkpointed(store->deleteItems(itemNames))) {
+        return false;
+    }
+
+    // Rows shift as items go, so each is looked up again
+    for (const QString &itemName : itemNames) {
+        int row = findItem(itemName);
+        if (row < 0) {
+            continue; // named twice
+        }
+        emit itemAboutToBeRemoved(row);
+        status.itemRemoved(itemCatalog.stock(row));
+        itemCatalog.remove(row);
+        forecaster.forgetItem(itemName);
+        emit itemRemoved(row);
+    }
+    updateOperational();
+    return true;
+}
+
+int VendingEngine::itemsBelowPar(int level) const {
+    int count = 0;
+    for (int row = 0; row < itemCatalog.size(); ++row) {
+        if (itemCatalog.stock(row) < level) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool VendingEngine::restockToPar(int level) {
+    static LatencyHistogram *const latency = Metrics::latency("restock_to_par");
+    ScopedTimer timer(latency);
+    repairStore();
+
+    if (level < 0) {
+        errorText = "Par level cannot be negative";
+        return false;
+    }
+    if (itemsBelowPar(level) == 0) {
+        return true;
+    }
+
+    JournalEvent event;
+    event.type = JournalEvent::RestockToPar;
+    event.amount = level;
+    if (!record(event) || !checkpointed(store->restockToPar(level))) {
+        return false;
+    }
+
+    for (int row = 0; row < itemCatalog.size(); ++row) {
+        int stock = itemCatalog.stock(row);
+        if (stock < level) {
+            status.stockChanged(stock, level);
+            itemCatalog.addStock(row, level - stock);
+            emit itemChanged(row);
+        }
+    }
+    updateOperational();
+    return true;
+}
+
+bool VendingEngine::refillChange(const CoinCounts &amounts) {
+    static LatencyHistogram *const latency = Metrics::latency("refill_change");
+    ScopedTimer timer(latency);
+    repairStore();
+
+    for (auto it = amounts.constBegin(); it != amounts.constEnd(); ++it) {
+        if (!Currency::Dispensable::contains(it.key())) {
+            errorText = denominationLabel(it.key()) + " is not a change denomination";
+            return false;
+        }
+        if (!canAdd(changeCounts.value(it.key()), it.value())) {
+            errorText = QString("Cannot refill %1 by %2").arg(denominationLabel(it.key())).arg(it.value());
+            return false;
+        }
+    }
+
+    JournalEvent event;
+    event.type = JournalEvent::Refill;
+    event.payment = amounts;
+    if (!record(event) || !checkpointed(store->refillChange(amounts))) {
+        return false;
+    }
+
+    for (auto it = amounts.constBegin(); it != amounts.constEnd(); ++it) {
+        adjustChangeBox(it.key(), it.value());
+    }
+    updateOperational();
+    return true;
+}
+
+bool VendingEngine::collectMoney() {
+    static LatencyHistogram *const latency = Metrics::latency("collect_money");
+    ScopedTimer timer(latency);
+    repairStore();
+
+    JournalEvent event;
+    event.type = JournalEvent::Collect;
+    if (!record(event) || !checkpointed(store->collectMoney())) {
+        return false;
+    }
+
+    status.collectionEmptied();
+    for (auto it = collectionCounts.begin(); it != collectionCounts.end(); ++it) {
+        it.value() = 0;
+        emit collectionBoxChanged(it.key());
+    }
+    updateOperational();
+    return true;
+}
+
+void VendingEngine::adjustChangeBox(int denomination, int delta) {
+    auto it = changeCounts.find(denomination);
+    if (it == changeCounts.end()) {
+        // A denomination the box has not held before starts out empty
+        it = changeCounts.insert(denomination, 0);
+        status.changeCountChanged(-1, 0);
+    }
+
+    int oldCount = it.value();
+    it.value() += delta;
+    status.changeCountChanged(oldCount, it.value());
+    emit changeBoxChanged(denomination);
+}
+
+void VendingEngine::adjustCollectionBox(int denomination, int delta) {
+    int &count = collectionCounts[denomination];
+    int oldCount = count;
+    count += delta;
+    status.collectionCountChanged(oldCount, count);
+    emit collectionBoxChanged(denomination);
+}
+
+void VendingEngine::updateOperational() {
+    bool now = status.isOperational();
+    if (now != operational) {
+        operational = now;
+        emit operationalChanged(now);
+    }
+}
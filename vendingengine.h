@@ -0,0 +1,257 @@
+// vendingengine.h
+#ifndef VENDINGENGINE_H
+#define VENDINGENGINE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QVector>
+#include <QHash>
+#include <functional>
+#include "catalog.h"
+#include "changesolver.h"
+#include "currency.h"
+#include "operatingstatus.h"
+#include "salesforecaster.h"
+#include "transactionjournal.h"
+
+// One completed purchase, as kept in the sales history: quantity units of
+// one item at price each. A cart is one record per item, with the cart's
+// coins on the first record only.
+struct SaleRecord {
+    QString itemName;
+    int price = 0;
+    int quantity = 1;
+    CoinCounts payment;
+    CoinCounts change;
+    qint64 soldAt = 0; // ms since epoch
+};
+
+// Full machine state as loaded from (or seeded into) a store
+struct VendingSnapshot {
+    QVector<StockItem> items;
+    CoinCounts changeBox;
+    CoinCounts collectionBox;
+    quint64 journalSequence = 0; // last journal event reflected above
+
+    // Sales replayed from the journal that the store's history is missing;
+    // only filled for stores that keep a history
+    QVector<SaleRecord> unrecordedSales;
+};
+
+// One entry of a cart: quantity units of an item
+struct CartLine {
+    QString itemName;
+    int quantity = 1;
+};
+
+struct PurchaseResult {
+    enum Status {
+        Ok,
+        UnknownItem,
+        OutOfStock,
+        InvalidDenomination,
+        InsufficientPayment,
+        InsufficientChange,
+        PaymentTooLarge,
+        InvalidQuantity,
+        StorageError
+    };
+
+    Status status = Ok;
+    int price = 0;        // a cart's total
+    int totalPayment = 0;
+    CoinCounts change;
+    QString refusedItem;  // the cart item behind UnknownItem, OutOfStock or InvalidQuantity
+};
+
+// Persistence backend for the engine. The engine keeps the authoritative
+// state in memory and only calls the store to make a mutation durable, so
+// no store method is ever needed to answer a read on the purchase path.
+class VendingStore {
+public:
+    virtual ~VendingStore() = default;
+
+    virtual bool load(VendingSnapshot &snapshot) = 0;
+    virtual bool commitPurchase(const SaleRecord &sale) = 0;
+    // All of a cart's stock and coin updates as one unit
+    virtual bool commitCart(const QVector<SaleRecord> &sales) = 0;
+    virtual bool addItem(const StockItem &item) = 0;
+    virtual bool deleteItem(const QString &itemName) = 0;
+    virtual bool restockItem(const QString &itemName, int amount) = 0;
+    // Bulk admin work, each as one unit
+    virtual bool restockItems(const QMap<QString, int> &amounts) = 0;
+    virtual bool deleteItems(const QStringList &itemNames) = 0;
+    virtual bool restockToPar(int level) = 0;
+    virtual bool refillChange(const CoinCounts &amounts) = 0;
+    virtual bool collectMoney() = 0;
+
+    // Replace the stored state wholesale, e.g. after a journal replay
+    virtual bool saveCheckpoint(const VendingSnapshot &snapshot) = 0;
+
+    // Journal sequence to record with the next committed mutation
+    virtual void setJournalSequence(quint64 sequence) { Q_UNUSED(sequence); }
+
+    // Whether committed sales are kept as history
+    virtual bool recordsSales() const { return false; }
+
+    // Whether the last failed mutation lost a race with another terminal
+    // sharing the store, so that retrying on fresh state may succeed
+    virtual bool conflicted() const { return false; }
+
+    // Whether other terminals write the same tables, which are then the only
+    // record of the machine
+    virtual bool isMultiTerminal() const { return false; }
+
+    // Whether the tables lost a write the engine kept, e.g. in a failed group
+    // commit or a failed write the journal covers. Until the next
+    // saveCheckpoint() or load() the store refuses other writes, so its
+    // journal sequence never moves past the lost one.
+    virtual bool needsCheckpoint() const { return false; }
+    virtual void markNeedsCheckpoint() {}
+
+    virtual QString lastError() const = 0;
+};
+
+// Store that keeps nothing beyond an initial snapshot; used for simulation
+// and tests where durability does not matter.
+class MemoryVendingStore : public VendingStore {
+public:
+    explicit MemoryVendingStore(const VendingSnapshot &initial = VendingSnapshot());
+
+    bool load(VendingSnapshot &snapshot) override;
+    bool commitPurchase(const SaleRecord &) override { return true; }
+    bool commitCart(const QVector<SaleRecord> &) override { return true; }
+    bool addItem(const StockItem &) override { return true; }
+    bool deleteItem(const QString &) override { return true; }
+    bool restockItem(const QString &, int) override { return true; }
+    bool restockItems(const QMap<QString, int> &) override { return true; }
+    bool deleteItems(const QStringList &) override { return true; }
+    bool restockToPar(int) override { return true; }
+    bool refillChange(const CoinCounts &) override { return true; }
+    bool collectMoney() override { return true; }
+    bool saveCheckpoint(const VendingSnapshot &snapshot) override;
+
+    QString lastError() const override { return QString(); }
+
+private:
+    VendingSnapshot initial;
+};
+
+// Signals report exactly which item row or box denomination a mutation
+// touched, so views can update in O(changed rows).
+class VendingEngine : public QObject {
+    Q_OBJECT
+
+public:
+    explicit VendingEngine(VendingStore *store, QObject *parent = nullptr);
+
+    // A sale that loses a race with another terminal is retried this many
+    // times in all, each on state reloaded from the store
+    static const int kMaxPurchaseAttempts = 3;
+
+    // Payments totalling more than this are refused, which keeps every
+    // amount the solver and the boxes see well inside int
+    static const int kMaxPayment = 1000000;
+
+    // A cart line of no units, or a cart of more units than this in all, is
+    // refused as InvalidQuantity
+    static const int kMaxCartUnits = 10000;
+
+    // Log every mutation to the journal before the store; load() then
+    // replays whatever the store's checkpoint is missing. Refused over a
+    // multi-terminal store, whose other writers no local journal sees.
+    bool setJournal(TransactionJournal *journal);
+
+    // Denominations accepted from customers and dispensed as change, largest
+    // first, as given by the build's Currency
+    static const QVector<int> &acceptedDenominations();
+    static const QVector<int> &changeDenominations();
+    static constexpr bool isAcceptedDenomination(int value) { return Currency::Accepted::contains(value); }
+
+    bool load();
+    VendingSnapshot snapshot() const;
+
+    // Authoritative item table for the UI and purchase path
+    const Catalog &catalog() const { return itemCatalog; }
+    const CoinCounts &changeBox() const { return changeCounts; }
+    const CoinCounts &collectionBox() const { return collectionCounts; }
+    int findItem(const QString &itemName) const;
+
+    PurchaseResult purchase(const QString &itemName, const CoinCounts &payment);
+
+    // Buys every line of a cart for one payment: change is solved once for
+    // the total and all stock and coin updates commit as one unit, so the
+    // cart sells whole or not at all. Lines naming the same item are merged;
+    // lines of no units are skipped.
+    PurchaseResult purchaseCart(const QVector<CartLine> &lines, const CoinCounts &payment);
+    bool addItem(const QString &itemName, int price, int stock);
+    bool deleteItem(const QString &itemName);
+    bool restockItem(const QString &itemName, int amount);
+
+    // Admin work on many items at once: every name is checked first, then
+    // the whole change is journaled as one event and committed as one unit
+    bool restockItems(const QMap<QString, int> &amounts);
+    bool deleteItems(const QStringList &itemNames);
+    // Brings every item below level up to it; the store does it in one
+    // statement. Returns false on error; itemsBelowPar() tells what it
+    // will touch.
+    bool restockToPar(int level);
+    int itemsBelowPar(int level) const;
+
+    bool refillChange(const CoinCounts &amounts);
+    bool collectMoney();
+
+    // O(1): backed by counters maintained on every mutation
+    bool isOperational() const { return operational; }
+    const OperatingStatus &operatingStatus() const { return status; }
+
+    // Sales rates behind the time-to-empty and time-to-full projections,
+    // fed by every sale, including those replayed from the journal
+    const SalesForecaster &forecast() const { return forecaster; }
+
+    void setChangePolicy(ChangeSolver::Policy policy) { changeSolver.setPolicy(policy); }
+    ChangeSolver::Policy changePolicy() const { return changeSolver.policy(); }
+    bool canMakeChange(int amount) { return changeSolver.canMake(changeCounts, amount); }
+
+    QString lastError() const { return errorText; }
+
+signals:
+    void reset();
+    void itemAdded(int row);
+    void itemAboutToBeRemoved(int row);
+    void itemRemoved(int row);
+    void itemChanged(int row);
+    void changeBoxChanged(int denomination);
+    void collectionBoxChanged(int denomination);
+    void operationalChanged(bool operational);
+
+private:
+    PurchaseResult retried(const std::function<PurchaseResult()> &attempt);
+    PurchaseResult attemptPurchase(const QString &itemName, const CoinCounts &payment);
+    PurchaseResult attemptCart(const QVector<CartLine> &lines, const CoinCounts &payment);
+    bool takePayment(const CoinCounts &payment, PurchaseResult &result);
+    bool computeChange(int changeAmount, CoinCounts &change);
+    void applyEvent(const JournalEvent &event);
+    bool record(JournalEvent &event);
+    bool checkpointed(bool stored);
+    void repairStore();
+    bool findItems(const QStringList &itemNames, QVector<int> &rows);
+    void adjustChangeBox(int denomination, int delta);
+    void adjustCollectionBox(int denomination, int delta);
+    void updateOperational();
+
+    VendingStore *store;
+    TransactionJournal *journal = nullptr;
+    Catalog itemCatalog;
+    CoinCounts changeCounts;
+    CoinCounts collectionCounts;
+    ChangeSolver changeSolver;
+    OperatingStatus status;
+    SalesForecaster forecaster;
+    bool operational = false;
+    QString errorText;
+};
+
+#endif // VENDINGENGINE_H
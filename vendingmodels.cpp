@@ -0,0 +1,252 @@
+// vendingmodels.cpp
+#include "vendingmodels.h"
+#include "metrics.h"
+#include <QDateTime>
+#include <algorithm>
+
+namespace {
+// Projected time until empty or full, as the admin page shows it
+QString formatHours(double hours) {
+    if (hours < 0) {
+        return QStringLiteral("-");
+    }
+    if (hours == 0) {
+        return QStringLiteral("now");
+    }
+    if (hours < 1) {
+        return QString("%1 min").arg(qMax(1, qRound(hours * 60)));
+    }
+    if (hours < 48) {
+        return QString("%1 h").arg(hours, 0, 'f', 1);
+    }
+    return QString("%1 d").arg(hours / 24, 0, 'f', 1);
+}
+}
+
+StockTableModel::StockTableModel(VendingEngine *engine, bool availableOnly, QObject *parent)
+    : QAbstractTableModel(parent), engine(engine), availableOnly(availableOnly) {
+    connect(engine, &VendingEngine::reset, this, &StockTableModel::resetRows);
+    connect(engine, &VendingEngine::itemAdded, this, &StockTableModel::addItem);
+    connect(engine, &VendingEngine::itemAboutToBeRemoved, this, &StockTableModel::removeItem);
+    connect(engine, &VendingEngine::itemRemoved, this, &StockTableModel::shiftRows);
+    connect(engine, &VendingEngine::itemChanged, this, &StockTableModel::updateItem);
+    resetRows();
+}
+
+int StockTableModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : rows.size();
+}
+
+int StockTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : (availableOnly ? 3 : 4);
+}
+
+QVariant StockTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    const Catalog &catalog = engine->catalog();
+    int itemRow = rows.at(index.row());
+    switch (index.column()) {
+    case 0: return catalog.name(itemRow);
+    case 1: return catalog.price(itemRow);
+    case 2: return catalog.stock(itemRow);
+    case 3:
+        return formatHours(SalesForecaster::hoursUntil(
+            catalog.stock(itemRow),
+            engine->forecast().itemRate(catalog.name(itemRow), QDateTime::currentMSecsSinceEpoch())));
+    }
+    return QVariant();
+}
+
+QVariant StockTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    static const QString priceHeader = QString("Price (%1)").arg(Currency::code);
+    switch (section) {
+    case 0: return QStringLiteral("Item Name");
+    case 1: return priceHeader;
+    case 2: return QStringLiteral("Stock");
+    case 3: return QStringLiteral("Empty In");
+    }
+    return QVariant();
+}
+
+bool StockTableModel::isShown(int itemRow) const {
+    return !availableOnly || engine->catalog().stock(itemRow) > 0;
+}
+
+int StockTableModel::findRow(int itemRow) const {
+    auto it = std::lower_bound(rows.constBegin(), rows.constEnd(), itemRow);
+    if (it == rows.constEnd() || *it != itemRow) {
+        return -1;
+    }
+    return int(it - rows.constBegin());
+}
+
+void StockTableModel::resetRows() {
+    static LatencyHistogram *const latency = Metrics::latency("stock_model_reset");
+    ScopedTimer timer(latency);
+
+    beginResetModel();
+    rows.clear();
+    const int itemCount = engine->catalog().size();
+    rows.reserve(itemCount);
+    for (int i = 0; i < itemCount; ++i) {
+        if (isShown(i)) {
+            rows.append(i);
+        }
+    }
+    endResetModel();
+}
+
+void StockTableModel::addItem(int itemRow) {
+    if (!isShown(itemRow)) {
+        return;
+    }
+
+    // New items are always appended by the engine, so rows stay sorted
+    beginInsertRows(QModelIndex(), rows.size(), rows.size());
+    rows.append(itemRow);
+    endInsertRows();
+}
+
+void StockTableModel::removeItem(int itemRow) {
+    int row = findRow(itemRow);
+    if (row < 0) {
+        return;
+    }
+
+    beginRemoveRows(QModelIndex(), row, row);
+    rows.remove(row);
+    endRemoveRows();
+}
+
+void StockTableModel::shiftRows(int itemRow) {
+    // The engine compacted its list; later items moved up by one
+    for (int &row : rows) {
+        if (row > itemRow) {
+            row--;
+        }
+    }
+}
+
+void StockTableModel::updateItem(int itemRow) {
+    static LatencyHistogram *const latency = Metrics::latency("stock_model_update");
+    ScopedTimer timer(latency);
+
+    int row = findRow(itemRow);
+    bool shown = isShown(itemRow);
+
+    if (row >= 0 && shown) {
+        emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+    } else if (row >= 0) {
+        beginRemoveRows(QModelIndex(), row, row);
+        rows.remove(row);
+        endRemoveRows();
+    } else if (shown) {
+        auto it = std::lower_bound(rows.begin(), rows.end(), itemRow);
+        int insertAt = int(it - rows.begin());
+        beginInsertRows(QModelIndex(), insertAt, insertAt);
+        rows.insert(insertAt, itemRow);
+        endInsertRows();
+    }
+}
+
+void StockTableModel::refreshForecast() {
+    if (columnCount() > 3 && !rows.isEmpty()) {
+        emit dataChanged(index(0, 3), index(rows.size() - 1, 3));
+    }
+}
+
+BoxTableModel::BoxTableModel(VendingEngine *engine, Box box, QObject *parent)
+    : QAbstractTableModel(parent), engine(engine), box(box) {
+    connect(engine, &VendingEngine::reset, this, &BoxTableModel::resetRows);
+    if (box == ChangeBox) {
+        connect(engine, &VendingEngine::changeBoxChanged, this, &BoxTableModel::updateDenomination);
+    } else {
+        connect(engine, &VendingEngine::collectionBoxChanged, this, &BoxTableModel::updateDenomination);
+    }
+    resetRows();
+}
+
+const CoinCounts &BoxTableModel::counts() const {
+    return box == ChangeBox ? engine->changeBox() : engine->collectionBox();
+}
+
+int BoxTableModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : denominations.size();
+}
+
+int BoxTableModel::columnCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : (box == CollectionBox ? 3 : 2);
+}
+
+QVariant BoxTableModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    int denomination = denominations.at(index.row());
+    switch (index.column()) {
+    case 0: return labels.at(index.row());
+    case 1: return counts().value(denomination);
+    case 2:
+        return formatHours(SalesForecaster::hoursUntil(
+            OperatingStatus::kCollectionCapacity - counts().value(denomination),
+            engine->forecast().coinRate(denomination, QDateTime::currentMSecsSinceEpoch())));
+    }
+    return QVariant();
+}
+
+QVariant BoxTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+    switch (section) {
+    case 0: return QStringLiteral("Denomination");
+    case 1: return QStringLiteral("Count");
+    case 2: return QStringLiteral("Full In");
+    }
+    return QVariant();
+}
+
+void BoxTableModel::resetRows() {
+    static LatencyHistogram *const latency = Metrics::latency("box_model_reset");
+    ScopedTimer timer(latency);
+
+    beginResetModel();
+    denominations.clear();
+    labels.clear();
+
+    // Largest denomination first, as the boxes are seeded
+    const CoinCounts &boxCounts = counts();
+    for (auto it = boxCounts.constEnd(); it != boxCounts.constBegin();) {
+        --it;
+        denominations.append(it.key());
+        labels.append(denominationLabel(it.key()));
+    }
+    endResetModel();
+}
+
+void BoxTableModel::updateDenomination(int denomination) {
+    static LatencyHistogram *const latency = Metrics::latency("box_model_update");
+    ScopedTimer timer(latency);
+
+    int row = denominations.indexOf(denomination);
+    if (row < 0) {
+        // A denomination the box has not held before
+        resetRows();
+        return;
+    }
+    emit dataChanged(index(row, 1), index(row, columnCount() - 1));
+}
+
+void BoxTableModel::refreshForecast() {
+    if (columnCount() > 2 && !denominations.isEmpty()) {
+        emit dataChanged(index(0, 2), index(denominations.size() - 1, 2));
+    }
+}
@@ -0,0 +1,80 @@
+// vendingmodels.h
+#ifndef VENDINGMODELS_H
+#define VENDINGMODELS_H
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include "vendingengine.h"
+
+// Table model over the engine's stock list. Rows track engine signals, so a
+// purchase or restock only emits dataChanged for the touched row instead of
+// rebuilding the table. With availableOnly set, out-of-stock items are
+// hidden and rows are inserted/removed as stock crosses zero. Otherwise a
+// fourth column projects when each item runs out at its current sales rate.
+class StockTableModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    StockTableModel(VendingEngine *engine, bool availableOnly, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+    // Engine item row displayed at the given view row
+    int itemRow(int row) const { return rows.at(row); }
+
+    // Projections age as time passes without sales; one signal covers the
+    // column, so this is cheap enough for a periodic timer
+    void refreshForecast();
+
+private slots:
+    void resetRows();
+    void addItem(int itemRow);
+    void removeItem(int itemRow);
+    void shiftRows(int itemRow);
+    void updateItem(int itemRow);
+
+private:
+    bool isShown(int itemRow) const;
+    int findRow(int itemRow) const;
+
+    VendingEngine *engine;
+    bool availableOnly;
+    QVector<int> rows; // sorted engine item rows currently shown
+};
+
+// Table model over the change box or collection box counts. The collection
+// box adds a column projecting when each denomination reaches capacity.
+class BoxTableModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    enum Box { ChangeBox, CollectionBox };
+
+    BoxTableModel(VendingEngine *engine, Box box, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation,
+                        int role = Qt::DisplayRole) const override;
+
+    void refreshForecast();
+
+private slots:
+    void resetRows();
+    void updateDenomination(int denomination);
+
+private:
+    const CoinCounts &counts() const;
+
+    VendingEngine *engine;
+    Box box;
+    QVector<int> denominations;
+    QVector<QString> labels; // "20THB" etc., built once per reset
+};
+
+#endif // VENDINGMODELS_H